@@ -0,0 +1,93 @@
+#include "bookdetail.h"
+#include "readsnapshot.h"
+#include "sqldialect.h"
+#include "queryprofiler.h"
+#include "stringpool.h"
+#include "saleshistogram.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+BookDetail::BookDetail()
+    : price( 0.0 )
+    , quantity( 0 )
+    , year( 0 )
+    , sold( 0 )
+    , requested( 0 )
+    , requestClerkID( 0 )
+    , requestVersion( 0 )
+{
+}
+
+bool BookDetail::load(const QString &isbn, const uint lookbackDays, BookDetail &detail, QSqlDatabase db)
+{
+    ReadSnapshot snapshot( db );
+    if (!snapshot.isValid())
+        return false;
+
+    detail = BookDetail();
+    detail.isbn = isbn;
+
+    QSqlQuery searchBook( db );
+    searchBook.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                searchBook.prepare( "SELECT title, price, quantity, year, publisher.name "
+                                    "FROM book JOIN publisher ON publisher.publisher_id = book.publisher_id "
+                                    "WHERE isbn = :isbn" );
+    searchBook.bindValue( ":isbn", isbn );
+    qDebug() << "Exec: " << QueryProfiler::exec( searchBook, db.connectionName() );
+    if (!searchBook.next())
+    {
+        qDebug() << "Book not found: " << isbn << searchBook.lastError();
+        return false;
+    }
+    detail.title         = searchBook.value( 0 ).toString();
+    detail.price         = searchBook.value( 1 ).toDouble();
+    detail.quantity      = searchBook.value( 2 ).toUInt();
+    detail.year          = searchBook.value( 3 ).toUInt();
+    detail.publisherName = StringPool::intern( searchBook.value( 4 ).toString() );
+
+    QSqlQuery searchAuthors( db );
+    searchAuthors.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                searchAuthors.prepare( "SELECT name "
+                                       "FROM book_s_author JOIN author "
+                                                          "ON author.author_id = book_s_author.author_id "
+                                       "WHERE book_s_author.isbn = :isbn" );
+    searchAuthors.bindValue( ":isbn", isbn );
+    qDebug() << "Exec: " << QueryProfiler::exec( searchAuthors, db.connectionName() );
+    while (searchAuthors.next())
+        detail.authors << StringPool::intern( searchAuthors.value( 0 ).toString() );
+
+    QSqlQuery searchSales( db );
+    searchSales.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                searchSales.prepare( SqlDialect::forDriver( db.driverName() ).bookSalesQuery() );
+    searchSales.bindValue( ":isbn", isbn );
+    searchSales.bindValue( ":days", SalesHistogram::daysBefore( lookbackDays ) );
+    searchSales.bindValue( ":summaryIsbn", isbn );
+    searchSales.bindValue( ":summaryDays", SalesHistogram::daysBefore( lookbackDays ) );
+    qDebug() << "Exec: " << QueryProfiler::exec( searchSales, db.connectionName() );
+    if (searchSales.next())
+        detail.sold = searchSales.value( 0 ).toUInt();
+
+    QSqlQuery searchRequest( db );
+    searchRequest.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                searchRequest.prepare( "SELECT quantity, clerk_id, version FROM request WHERE isbn = :isbn" );
+    searchRequest.bindValue( ":isbn", isbn );
+    qDebug() << "Exec: " << QueryProfiler::exec( searchRequest, db.connectionName() );
+    if (searchRequest.next())
+    {
+        detail.requested      = searchRequest.value( 0 ).toUInt();
+        detail.requestClerkID = searchRequest.value( 1 ).toUInt();
+        detail.requestVersion = searchRequest.value( 2 ).toUInt();
+    }
+
+    qDebug() << "Title: " << detail.title << "Quantity: " << detail.quantity << "Price: " << detail.price
+             << "Year: " << detail.year << "Publisher Name: " << detail.publisherName
+             << "Authors: " << detail.authors << "Sold: " << detail.sold
+             << "Requested: " << detail.requested << "ClerkID: " << detail.requestClerkID
+             << "Version: " << detail.requestVersion;
+    return true;
+}
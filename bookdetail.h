@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QSqlDatabase>
+
+/**
+ * @brief The BookDetail struct everything current book panel shows about one book. All values are read
+ * together, keyed by ISBN, within one read snapshot.
+ */
+struct BookDetail
+{
+    QString isbn;
+    QString title;
+    qreal price;
+    uint quantity;
+    uint year;
+    QString publisherName;
+    QStringList authors;
+    /**
+     * @brief sold how many copies were sold during lookback window
+     */
+    uint sold;
+    /**
+     * @brief requested requested quantity (0 if there is no request)
+     */
+    uint requested;
+    /**
+     * @brief requestClerkID clerk that has filled request (0 if there is no request)
+     */
+    uint requestClerkID;
+    /**
+     * @brief requestVersion version of request that was read (modification or removal of request
+     * succeeds only if it is still the same)
+     */
+    uint requestVersion;
+
+    BookDetail();
+
+    /**
+     * @brief load reads details of book over given connection (must be opened)
+     * @param lookbackDays window for sold
+     * @return false if snapshot can't be started or book is not found
+     */
+    static bool load( const QString& isbn, const uint lookbackDays, BookDetail& detail
+                    , QSqlDatabase db = QSqlDatabase::database() );
+};
@@ -0,0 +1,261 @@
+#include "bundlebrowsermodel.h"
+#include "bundlepricing.h"
+#include <QDebug>
+
+const int BundleBrowserModel::PageSize;
+
+BundleBrowserModel::BundleBrowserModel(DataService * const dataService, QObject * const parent)
+    : QAbstractItemModel( parent )
+    , m_dataService( dataService )
+    , m_pageWatcher( new QFutureWatcher< QVector< DataService::BundleSummary > >( this ))
+    , m_booksWatcher( new QFutureWatcher< QVector< DataService::BundleBook > >( this ))
+    , m_hasMore( false )
+    , m_lookbackDays( 7 )
+    , m_generation( 0 )
+    , m_pageGeneration( 0 )
+    , m_booksGeneration( 0 )
+    , m_booksBundleID( 0 )
+{
+    connect( m_pageWatcher, SIGNAL(finished()), this, SLOT(pageFetched()) );
+    connect( m_booksWatcher, SIGNAL(finished()), this, SLOT(booksFetched()) );
+}
+
+void BundleBrowserModel::reload(const uint lookbackDays)
+{
+    beginResetModel();
+    m_bundles.clear();
+    m_pendingBooks.clear();
+    ++m_generation;
+    m_hasMore = true;
+    m_lookbackDays = lookbackDays;
+    endResetModel();
+}
+
+void BundleBrowserModel::clear()
+{
+    beginResetModel();
+    m_bundles.clear();
+    m_pendingBooks.clear();
+    ++m_generation;
+    m_hasMore = false;
+    endResetModel();
+}
+
+uint BundleBrowserModel::bundleID(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return 0;
+
+    const int row = (0 == index.internalId()) ? index.row() : static_cast< int >( index.internalId() ) - 1;
+    return m_bundles.at( row ).summary.id;
+}
+
+QModelIndex BundleBrowserModel::index(const int row, const int column, const QModelIndex &parent) const
+{
+    if (0 > row || 0 > column || ColumnCount <= column)
+        return QModelIndex();
+
+    if (!parent.isValid())
+        return (m_bundles.size() > row) ? createIndex( row, column, quintptr( 0 ) ) : QModelIndex();
+
+    // books: internal id is row of their bundle + 1
+    if (0 != parent.internalId() || m_bundles.at( parent.row() ).books.size() <= row)
+        return QModelIndex();
+
+    return createIndex( row, column, quintptr( parent.row() + 1 ) );
+}
+
+QModelIndex BundleBrowserModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid() || 0 == child.internalId())
+        return QModelIndex();
+
+    return createIndex( static_cast< int >( child.internalId() ) - 1, 0, quintptr( 0 ) );
+}
+
+int BundleBrowserModel::rowCount(const QModelIndex &parent) const
+{
+    if (!parent.isValid())
+        return m_bundles.size();
+
+    if (0 != parent.internalId() || NameColumn != parent.column())
+        return 0;
+
+    return m_bundles.at( parent.row() ).books.size();
+}
+
+int BundleBrowserModel::columnCount(const QModelIndex &) const
+{
+    return ColumnCount;
+}
+
+bool BundleBrowserModel::hasChildren(const QModelIndex &parent) const
+{
+    if (!parent.isValid())
+        return !m_bundles.isEmpty();
+
+    return 0 == parent.internalId() && NameColumn == parent.column() && 0 != m_bundles.at( parent.row() ).summary.items;
+}
+
+QVariant BundleBrowserModel::data(const QModelIndex &index, const int role) const
+{
+    if (!index.isValid() || (Qt::DisplayRole != role && Qt::TextAlignmentRole != role))
+        return QVariant();
+
+    if (Qt::TextAlignmentRole == role)
+        return (NameColumn == index.column()) ? QVariant() : QVariant( int( Qt::AlignRight | Qt::AlignVCenter ) );
+
+    if (0 == index.internalId())
+    {
+        const DataService::BundleSummary& bundle = m_bundles.at( index.row() ).summary;
+        switch (index.column())
+        {
+        case NameColumn:
+            return bundle.name;
+        case ItemsColumn:
+            return bundle.items;
+        case ListPriceColumn:
+            return QString::number( bundle.listPrice, 'f', 2 );
+        case DiscountedColumn:
+            return BundlePricing::format( bundle.netCents );
+        case SellThroughColumn:
+            return QString( "%1%" ).arg( 100.0 * bundle.sellThrough, 0, 'f', 1 );
+        default:
+            return QVariant();
+        }
+    }
+
+    const DataService::BundleBook& book = m_bundles.at( static_cast< int >( index.internalId() ) - 1 )
+                                          .books.at( index.row() );
+    switch (index.column())
+    {
+    case NameColumn:
+        return tr("%1 (%2)").arg( book.title ).arg( book.isbn );
+    case ListPriceColumn:
+        return QString::number( book.price, 'f', 2 );
+    case DiscountedColumn:
+        return BundlePricing::format( book.netCents );
+    default:
+        return QVariant();
+    }
+}
+
+QVariant BundleBrowserModel::headerData(const int section, const Qt::Orientation orientation, const int role) const
+{
+    if (Qt::Horizontal != orientation || Qt::DisplayRole != role)
+        return QAbstractItemModel::headerData( section, orientation, role );
+
+    switch (section)
+    {
+    case NameColumn:
+        return tr("Bundle");
+    case ItemsColumn:
+        return tr("Books");
+    case ListPriceColumn:
+        return tr("List price");
+    case DiscountedColumn:
+        return tr("With discount");
+    case SellThroughColumn:
+        return tr("Sell-through");
+    default:
+        return QVariant();
+    }
+}
+
+bool BundleBrowserModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (!parent.isValid())
+        return m_hasMore;
+
+    if (0 != parent.internalId())
+        return false;
+
+    const Bundle& bundle = m_bundles.at( parent.row() );
+    return !bundle.booksLoaded && 0 != bundle.summary.items;
+}
+
+void BundleBrowserModel::fetchMore(const QModelIndex &parent)
+{
+    if (!parent.isValid())
+        fetchPage();
+    else if (0 == parent.internalId())
+        fetchBooks( parent.row() );
+}
+
+void BundleBrowserModel::fetchPage()
+{
+    // page that is being read is followed by the next one once it arrives
+    if (m_pageWatcher->isRunning())
+        return;
+
+    m_hasMore = false;
+    m_pageGeneration = m_generation;
+    m_pageWatcher->setFuture( m_dataService->fetchBundlePage( m_bundles.isEmpty() ? 0 : m_bundles.last().summary.id
+                                                            , PageSize, m_lookbackDays ) );
+}
+
+void BundleBrowserModel::pageFetched()
+{
+    // bundles have been dropped while page was read: page of reloaded bundles is read again
+    if (m_pageGeneration != m_generation)
+    {
+        qDebug() << "Page is outdated";
+        if (m_hasMore)
+            fetchPage();
+        return;
+    }
+
+    const QVector< DataService::BundleSummary > page = m_pageWatcher->result();
+    if (page.isEmpty())
+        return;
+
+    beginInsertRows( QModelIndex(), m_bundles.size(), m_bundles.size() + page.size() - 1 );
+    for (int i( 0 ); page.size() != i; ++i)
+    {
+        Bundle bundle;
+        bundle.summary     = page.at( i );
+        bundle.booksLoaded = false;
+        m_bundles << bundle;
+    }
+    endInsertRows();
+
+    m_hasMore = PageSize == page.size();
+}
+
+void BundleBrowserModel::fetchBooks(const int row)
+{
+    Bundle& bundle = m_bundles[ row ];
+    bundle.booksLoaded = true;
+
+    m_pendingBooks << bundle.summary.id;
+    fetchNextBooks();
+}
+
+void BundleBrowserModel::fetchNextBooks()
+{
+    if (m_booksWatcher->isRunning() || m_pendingBooks.isEmpty())
+        return;
+
+    m_booksBundleID   = m_pendingBooks.takeFirst();
+    m_booksGeneration = m_generation;
+    m_booksWatcher->setFuture( m_dataService->fetchBundleBooks( m_booksBundleID ) );
+}
+
+void BundleBrowserModel::booksFetched()
+{
+    const QVector< DataService::BundleBook > books = m_booksWatcher->result();
+
+    int row = -1;
+    for (int i( 0 ); m_bundles.size() != i && -1 == row; ++i)
+        if (m_bundles.at( i ).summary.id == m_booksBundleID)
+            row = i;
+
+    if (m_booksGeneration == m_generation && -1 != row && !books.isEmpty())
+    {
+        beginInsertRows( index( row, NameColumn ), 0, books.size() - 1 );
+        m_bundles[ row ].books = books;
+        endInsertRows();
+    }
+
+    fetchNextBooks();
+}
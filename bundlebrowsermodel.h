@@ -0,0 +1,108 @@
+#pragma once
+
+#include <QAbstractItemModel>
+#include <QVector>
+#include <QList>
+#include <QString>
+#include <QFutureWatcher>
+
+#include "dataservice.h"
+
+/**
+ * @brief The BundleBrowserModel class shows existing bundles page by page. Every page is read with one
+ * aggregate query (number of books, list price, discounted price and sell-through of bundle);
+ * books of bundle are read only when bundle is expanded. Pages and books are read by DataService,
+ * rows are inserted when they arrive.
+ */
+class BundleBrowserModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    enum Column
+    {
+        NameColumn = 0,
+        ItemsColumn,
+        ListPriceColumn,
+        DiscountedColumn,
+        SellThroughColumn,
+        ColumnCount
+    };
+
+    explicit BundleBrowserModel(DataService * const dataService, QObject * const parent = NULL);
+
+    /**
+     * @brief reload drops all loaded bundles; first page will be fetched by view
+     * @param lookbackDays window (in days) for which sell-through is computed
+     */
+    void reload( const uint lookbackDays );
+    void clear();
+
+    /**
+     * @brief bundleID id of bundle at index (or of bundle that contains book at index)
+     */
+    uint bundleID( const QModelIndex& index ) const;
+
+    QModelIndex index( const int row, const int column, const QModelIndex& parent = QModelIndex() ) const;
+    QModelIndex parent( const QModelIndex& child ) const;
+    int rowCount( const QModelIndex& parent = QModelIndex() ) const;
+    int columnCount( const QModelIndex& parent = QModelIndex() ) const;
+    bool hasChildren( const QModelIndex& parent = QModelIndex() ) const;
+    QVariant data( const QModelIndex& index, const int role = Qt::DisplayRole ) const;
+    QVariant headerData( const int section, const Qt::Orientation orientation, const int role = Qt::DisplayRole ) const;
+
+    bool canFetchMore( const QModelIndex& parent ) const;
+    void fetchMore( const QModelIndex& parent );
+
+private slots:
+    void pageFetched();
+    void booksFetched();
+
+private:
+    struct Bundle
+    {
+        DataService::BundleSummary summary;
+        bool booksLoaded;
+        QVector< DataService::BundleBook > books;
+    };
+
+    void fetchPage();
+    void fetchBooks( const int row );
+    /**
+     * @brief fetchNextBooks starts reading books of the next expanded bundle (one bundle at a time)
+     */
+    void fetchNextBooks();
+
+    /**
+     * @brief PageSize number of bundles read by one query
+     */
+    static const int PageSize = 100;
+
+    DataService * const m_dataService;
+    QFutureWatcher< QVector< DataService::BundleSummary > > *m_pageWatcher;
+    QFutureWatcher< QVector< DataService::BundleBook > > *m_booksWatcher;
+
+    QVector< Bundle > m_bundles;
+    /**
+     * @brief m_hasMore whether last fetched page was full (so there may be more bundles)
+     */
+    bool m_hasMore;
+    uint m_lookbackDays;
+    /**
+     * @brief m_generation bumped whenever bundles are dropped: pages and books read before are dropped too
+     */
+    uint m_generation;
+    /**
+     * @brief m_pageGeneration, m_booksGeneration generation page (books) being read belongs to
+     */
+    uint m_pageGeneration;
+    uint m_booksGeneration;
+    /**
+     * @brief m_booksBundleID bundle whose books are being read
+     */
+    uint m_booksBundleID;
+    /**
+     * @brief m_pendingBooks expanded bundles whose books are yet to be read
+     */
+    QList< uint > m_pendingBooks;
+};
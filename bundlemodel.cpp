@@ -0,0 +1,183 @@
+#include "bundlemodel.h"
+#include <QDebug>
+
+BundleModel::BundleModel(QObject * const parent)
+    : QAbstractListModel( parent )
+{
+}
+
+int BundleModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_items.size();
+}
+
+QVariant BundleModel::data(const QModelIndex &index, const int role) const
+{
+    if (!index.isValid() || m_items.size() <= index.row())
+        return QVariant();
+
+    const Item& bundleItem = m_items.at( index.row() );
+    switch (role)
+    {
+    case Qt::DisplayRole:
+        return tr("%0 by %1; %2 (%3)")
+                .arg( bundleItem.title )
+                .arg( bundleItem.authors )
+                .arg( bundleItem.publisher )
+                .arg( bundleItem.year );
+    case Qt::ToolTipRole:
+        return bundleItem.isbn;
+    default:
+        return QVariant();
+    }
+}
+
+int BundleModel::appendItems(const QVector<Item> &items)
+{
+    QVector< Item > newItems;
+    newItems.reserve( items.size() );
+    for (int i( 0 ); items.size() != i; ++i)
+    {
+        const Item& newItem = items.at( i );
+        if (contains( newItem.isbn ))
+            continue;
+
+        m_rows.insert( newItem.isbn, m_items.size() + newItems.size() );
+        newItems << newItem;
+    }
+
+    if (newItems.isEmpty())
+        return 0;
+
+    beginInsertRows( QModelIndex(), m_items.size(), m_items.size() + newItems.size() - 1 );
+    m_items += newItems;
+    endInsertRows();
+
+    qDebug() << "Appended " << newItems.size() << " book(s) to bundle";
+    return newItems.size();
+}
+
+void BundleModel::removeItems(const QList<int> &rows)
+{
+    if (rows.isEmpty())
+        return;
+
+    QVector< bool > removed( m_items.size(), false );
+    for (int i( 0 ); rows.size() != i; ++i)
+        if (0 <= rows.at( i ) && m_items.size() > rows.at( i ))
+            removed[ rows.at( i ) ] = true;
+
+    beginResetModel();
+
+    int kept = 0;
+    for (int i( 0 ); m_items.size() != i; ++i)
+        if (!removed.at( i ))
+        {
+            if (kept != i)
+                m_items[ kept ] = m_items.at( i );
+            ++kept;
+        }
+    m_items.resize( kept );
+    rebuildIndex();
+
+    endResetModel();
+}
+
+void BundleModel::clear()
+{
+    beginResetModel();
+    m_items.clear();
+    m_rows.clear();
+    m_loaded.clear();
+    endResetModel();
+}
+
+void BundleModel::setNetCents(const int row, const qint64 netCents)
+{
+    m_items[ row ].netCents = netCents;
+}
+
+void BundleModel::setNetCents(const QList<qint64> &netCents)
+{
+    Q_ASSERT( netCents.size() == m_items.size() );
+
+    for (int i( 0 ); m_items.size() != i; ++i)
+        m_items[ i ].netCents = netCents.at( i );
+
+    if (!m_items.isEmpty())
+        emit dataChanged( index( 0 ), index( m_items.size() - 1 ) );
+}
+
+void BundleModel::markLoaded()
+{
+    m_loaded.clear();
+    m_loaded.reserve( m_items.size() );
+    for (int i( 0 ); m_items.size() != i; ++i)
+        m_loaded.insert( m_items.at( i ).isbn, m_items.at( i ).netCents );
+}
+
+BundleModel::ChangeSet BundleModel::changes() const
+{
+    ChangeSet changeSet;
+    for (int i( 0 ); m_items.size() != i; ++i)
+    {
+        const Item& bundleItem = m_items.at( i );
+        const QHash< QString, qint64 >::const_iterator it = m_loaded.constFind( bundleItem.isbn );
+        if (m_loaded.constEnd() == it)
+        {
+            changeSet.addedISBNs     << bundleItem.isbn;
+            changeSet.addedNetCents  << bundleItem.netCents;
+            changeSet.addedDiscounts << bundleItem.discount();
+        }
+        else if (it.value() != bundleItem.netCents)
+        {
+            changeSet.rediscountedISBNs     << bundleItem.isbn;
+            changeSet.rediscountedNetCents  << bundleItem.netCents;
+            changeSet.rediscountedDiscounts << bundleItem.discount();
+        }
+    }
+
+    for (QHash< QString, qint64 >::const_iterator it = m_loaded.constBegin(); m_loaded.constEnd() != it; ++it)
+        if (!contains( it.key() ))
+            changeSet.removedISBNs << it.key();
+
+    return changeSet;
+}
+
+QStringList BundleModel::isbns() const
+{
+    QStringList result;
+    result.reserve( m_items.size() );
+    for (int i( 0 ); m_items.size() != i; ++i)
+        result << m_items.at( i ).isbn;
+
+    return result;
+}
+
+QList<qint64> BundleModel::netCents() const
+{
+    QList< qint64 > result;
+    result.reserve( m_items.size() );
+    for (int i( 0 ); m_items.size() != i; ++i)
+        result << m_items.at( i ).netCents;
+
+    return result;
+}
+
+QList<qreal> BundleModel::discounts() const
+{
+    QList< qreal > result;
+    result.reserve( m_items.size() );
+    for (int i( 0 ); m_items.size() != i; ++i)
+        result << m_items.at( i ).discount();
+
+    return result;
+}
+
+void BundleModel::rebuildIndex()
+{
+    m_rows.clear();
+    m_rows.reserve( m_items.size() );
+    for (int i( 0 ); m_items.size() != i; ++i)
+        m_rows.insert( m_items.at( i ).isbn, i );
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QVector>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+/**
+ * @brief The BundleModel class holds books of bundle under construction (modification) as compact records.
+ * Display text is formatted only when view asks for it, i.e. only for visible rows.
+ */
+class BundleModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief The Item struct one book in bundle
+     */
+    struct Item
+    {
+        QString isbn;
+        QString title;
+        QString authors;
+        QString publisher;
+        uint    year;
+        qreal   price;
+        /**
+         * @brief netCents discounted price in cents (exact, as it is stored in database)
+         */
+        qint64  netCents;
+
+        /**
+         * @brief discount fraction of price (0.0 -- 1.0) that net price amounts to
+         */
+        qreal discount() const
+        {
+            return (0.0 < price) ? 1.0 - static_cast< qreal >( netCents ) / (100.0 * price) : 0.0;
+        }
+    };
+
+    /**
+     * @brief The ChangeSet struct difference between loaded bundle and its current state
+     */
+    struct ChangeSet
+    {
+        QStringList     addedISBNs;
+        QList< qint64 > addedNetCents;
+        QList< qreal >  addedDiscounts;
+        QStringList     removedISBNs;
+        QStringList     rediscountedISBNs;
+        QList< qint64 > rediscountedNetCents;
+        QList< qreal >  rediscountedDiscounts;
+
+        bool isEmpty() const
+        {
+            return addedISBNs.isEmpty() && removedISBNs.isEmpty() && rediscountedISBNs.isEmpty();
+        }
+    };
+
+    explicit BundleModel(QObject * const parent = NULL);
+
+    int rowCount( const QModelIndex& parent = QModelIndex() ) const;
+    QVariant data( const QModelIndex& index, const int role = Qt::DisplayRole ) const;
+
+    const Item& item( const int row ) const { return m_items.at( row ); }
+    bool contains( const QString& isbn ) const { return m_rows.contains( isbn ); }
+    bool isEmpty() const { return m_items.isEmpty(); }
+
+    /**
+     * @brief appendItems appends books to the end of bundle (with single insertion notification).
+     * Books that are already in bundle are skipped.
+     * @return number of appended books
+     */
+    int appendItems( const QVector< Item >& items );
+    /**
+     * @brief removeItems removes books in given rows with single model reset
+     */
+    void removeItems( const QList< int >& rows );
+    void clear();
+
+    void setNetCents( const int row, const qint64 netCents );
+    /**
+     * @brief setNetCents replaces net prices of all books (in order of rows) with single change notification
+     */
+    void setNetCents( const QList< qint64 >& netCents );
+
+    /**
+     * @brief markLoaded remembers current books and their net prices as state that is stored in database
+     */
+    void markLoaded();
+    /**
+     * @brief changes books that were added, removed or re-discounted since markLoaded()
+     */
+    ChangeSet changes() const;
+
+    QStringList isbns() const;
+    QList< qint64 > netCents() const;
+    /**
+     * @brief discounts discounts that net prices amount to (see Item::discount)
+     */
+    QList< qreal > discounts() const;
+
+private:
+    void rebuildIndex();
+
+    QVector< Item > m_items;
+    /**
+     * @brief m_rows row of every ISBN in m_items
+     */
+    QHash< QString, int > m_rows;
+    /**
+     * @brief m_loaded net prices of books as they are stored in database
+     */
+    QHash< QString, qint64 > m_loaded;
+};
@@ -0,0 +1,199 @@
+#include "bundlepricing.h"
+#include <QSettings>
+#include <QStringList>
+#include <QDebug>
+#include <algorithm>
+
+namespace
+{
+/**
+ * @brief The RemainderGreater struct orders rows by remainder (descending), then by row
+ */
+struct RemainderGreater
+{
+    const QVector< qint64 >& remainders;
+
+    explicit RemainderGreater( const QVector< qint64 >& iRemainders )
+        : remainders( iRemainders )
+    {
+    }
+
+    bool operator()( const int lhs, const int rhs ) const
+    {
+        return (remainders.at( lhs ) == remainders.at( rhs )) ? lhs < rhs
+                                                              : remainders.at( lhs ) > remainders.at( rhs );
+    }
+};
+
+bool olderTierFirst( const BundlePricing::AgeTier& lhs, const BundlePricing::AgeTier& rhs )
+{
+    return lhs.minAge > rhs.minAge;
+}
+}
+
+BundlePricing::BundlePricing(const BundleModel &model)
+{
+    const int size = model.rowCount();
+    m_listCents.reserve( size );
+    m_netCents.reserve( size );
+    m_years.reserve( size );
+
+    for (int i( 0 ); size != i; ++i)
+    {
+        const BundleModel::Item& item = model.item( i );
+        m_listCents << toCents( item.price );
+        m_netCents  << item.netCents;
+        m_years     << item.year;
+    }
+}
+
+qint64 BundlePricing::toCents(const qreal value)
+{
+    return qRound64( 100.0 * value );
+}
+
+QString BundlePricing::format(const qint64 cents)
+{
+    const qint64 absolute = qAbs( cents );
+    return QString( "%1%2.%3" ).arg( (0 > cents) ? "-" : "" )
+                               .arg( absolute / 100 )
+                               .arg( absolute % 100, 2, 10, QChar( '0' ) );
+}
+
+qint64 BundlePricing::netCents(const qint64 listCents, const uint percent)
+{
+    return (listCents * (100 - qMin( percent, 100u )) + 50) / 100;
+}
+
+uint BundlePricing::percent(const qint64 listCents, const qint64 netCents)
+{
+    if (0 >= listCents || listCents <= netCents)
+        return 0;
+
+    return static_cast< uint >( (100 * (listCents - qMax( netCents, Q_INT64_C( 0 ) )) + listCents / 2) / listCents );
+}
+
+QList< BundlePricing::AgeTier > BundlePricing::ageTiersFromSettings()
+{
+    const QSettings settings( "settings.ini", QSettings::IniFormat );
+    const QStringList pairs = settings.value( "pricing/ageTiers", "10:30,5:20,2:10" ).toString()
+                                      .split( ",", Qt::SkipEmptyParts );
+
+    QList< AgeTier > tiers;
+    for (int i( 0 ); pairs.size() != i; ++i)
+    {
+        const QStringList pair = pairs.at( i ).split( ":" );
+        bool ageOk = false;
+        bool percentOk = false;
+        AgeTier tier;
+        tier.minAge  = pair.value( 0 ).trimmed().toUInt( &ageOk );
+        tier.percent = pair.value( 1 ).trimmed().toUInt( &percentOk );
+        if (2 == pair.size() && ageOk && percentOk && 100 >= tier.percent)
+            tiers << tier;
+        else
+            qDebug() << "Malformed age tier: " << pairs.at( i );
+    }
+
+    // oldest tier first, so the first matching tier is the most specific one
+    std::sort( tiers.begin(), tiers.end(), olderTierFirst );
+
+    return tiers;
+}
+
+void BundlePricing::applyPercent(const uint percent)
+{
+    const qint64 factor = 100 - qMin( percent, 100u );
+    const int size = m_listCents.size();
+    const qint64 * const list = m_listCents.constData();
+    qint64 * const net = m_netCents.data();
+
+    for (int i( 0 ); size != i; ++i)
+        net[ i ] = (list[ i ] * factor + 50) / 100;
+}
+
+bool BundlePricing::applyTargetTotal(const qint64 targetCents)
+{
+    const qint64 listTotal = totals().listCents;
+    if (0 > targetCents || listTotal < targetCents)
+        return false;
+    if (0 == listTotal)
+        return true;
+
+    const int size = m_listCents.size();
+    const qint64 * const list = m_listCents.constData();
+    qint64 * const net = m_netCents.data();
+    QVector< qint64 > remainders( size );
+
+    qint64 assigned = 0;
+    for (int i( 0 ); size != i; ++i)
+    {
+        const qint64 share = list[ i ] * targetCents;
+        net[ i ]        = share / listTotal;
+        remainders[ i ] = share % listTotal;
+        assigned       += net[ i ];
+    }
+
+    // fewer than size cents are left
+    const int leftover = static_cast< int >( targetCents - assigned );
+    if (0 != leftover)
+    {
+        QVector< int > rows( size );
+        for (int i( 0 ); size != i; ++i)
+            rows[ i ] = i;
+        std::partial_sort( rows.begin(), rows.begin() + leftover, rows.end(), RemainderGreater( remainders ) );
+        for (int i( 0 ); leftover != i; ++i)
+            ++net[ rows.at( i ) ];
+    }
+
+    return true;
+}
+
+void BundlePricing::applyAgeTiers(const QList<AgeTier> &tiers, const uint currentYear)
+{
+    const int size = m_listCents.size();
+    QVector< qint64 > factors( size, 100 );
+    for (int i( 0 ); size != i; ++i)
+    {
+        // year of book may be unknown (0): no tier applies then
+        if (0 == m_years.at( i ))
+            continue;
+
+        const uint age = (currentYear > m_years.at( i )) ? currentYear - m_years.at( i ) : 0;
+        for (int j( 0 ); tiers.size() != j; ++j)
+            if (tiers.at( j ).minAge <= age)
+            {
+                factors[ i ] = 100 - tiers.at( j ).percent;
+                break;
+            }
+    }
+
+    const qint64 * const list = m_listCents.constData();
+    const qint64 * const factor = factors.constData();
+    qint64 * const net = m_netCents.data();
+    for (int i( 0 ); size != i; ++i)
+        net[ i ] = (list[ i ] * factor[ i ] + 50) / 100;
+}
+
+BundlePricing::Totals BundlePricing::totals() const
+{
+    Totals result;
+    result.listCents = 0;
+    result.netCents  = 0;
+    for (int i( 0 ); m_listCents.size() != i; ++i)
+    {
+        result.listCents += m_listCents.at( i );
+        result.netCents  += m_netCents.at( i );
+    }
+
+    return result;
+}
+
+QList< qint64 > BundlePricing::netCents() const
+{
+    QList< qint64 > result;
+    result.reserve( m_netCents.size() );
+    for (int i( 0 ); m_netCents.size() != i; ++i)
+        result << m_netCents.at( i );
+
+    return result;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QVector>
+#include <QList>
+#include <QString>
+
+#include "bundlemodel.h"
+
+/**
+ * @brief The BundlePricing class computes prices of bundled books in fixed-point cents.
+ * List and net prices are kept in separate contiguous arrays, so every bulk operation is a single
+ * pass over them and totals are exact (no rounding drift).
+ */
+class BundlePricing
+{
+public:
+    struct Totals
+    {
+        qint64 listCents;
+        qint64 netCents;
+
+        qint64 savingsCents() const { return listCents - netCents; }
+    };
+
+    /**
+     * @brief The AgeTier struct discount for books that are at least minAge years old
+     */
+    struct AgeTier
+    {
+        uint minAge;
+        uint percent;
+    };
+
+    /**
+     * @brief BundlePricing takes prices and discounts of all books in bundle
+     */
+    explicit BundlePricing( const BundleModel& model );
+
+    static qint64 toCents( const qreal value );
+    static QString format( const qint64 cents );
+    /**
+     * @brief netCents price after discount of given percent (rounded half up)
+     */
+    static qint64 netCents( const qint64 listCents, const uint percent );
+    /**
+     * @brief percent discount of net price from list price in whole percent (rounded)
+     */
+    static uint percent( const qint64 listCents, const qint64 netCents );
+
+    /**
+     * @brief ageTiersFromSettings reads tiers from "pricing/ageTiers" setting ("minAge:percent" pairs
+     * separated by commas), oldest tier first
+     */
+    static QList< AgeTier > ageTiersFromSettings();
+
+    /**
+     * @brief applyPercent gives the same discount to every book
+     */
+    void applyPercent( const uint percent );
+    /**
+     * @brief applyTargetTotal scales net prices proportionally to list prices, so their sum is exactly
+     * targetCents. Cents that are left after rounding down go to books with largest remainders.
+     * @return false if target is negative or higher than list total
+     */
+    bool applyTargetTotal( const qint64 targetCents );
+    /**
+     * @brief applyAgeTiers gives every book discount of the first tier it is old enough for
+     * (or no discount). Books of unknown year (0) get no discount
+     */
+    void applyAgeTiers( const QList< AgeTier >& tiers, const uint currentYear );
+
+    Totals totals() const;
+    /**
+     * @brief netCents resulting net prices, in order of model rows
+     */
+    QList< qint64 > netCents() const;
+
+private:
+    QVector< qint64 > m_listCents;
+    QVector< qint64 > m_netCents;
+    QVector< uint > m_years;
+};
@@ -0,0 +1,36 @@
+#include "connectionsettings.h"
+#include <QSettings>
+#include <QSqlDatabase>
+
+ConnectionSettings::ConnectionSettings()
+    : port( 0 )
+{
+}
+
+ConnectionSettings ConnectionSettings::read(QSettings &settings, const QString &group)
+{
+    ConnectionSettings result;
+
+    settings.beginGroup( group );
+    result.driver       = settings.value( "driver",   "QOCI"      ).toString();
+    result.hostName     = settings.value( "hostname", "localhost" ).toString();
+    result.databaseName = settings.value( "database", "bookstore" ).toString();
+    result.userName     = settings.value( "user",     QString()   ).toString();
+    result.password     = settings.value( "password", QString()   ).toString();
+    result.port         = settings.value( "port", "1521").toUInt();
+    settings.endGroup();
+
+    return result;
+}
+
+QSqlDatabase ConnectionSettings::addDatabase(const QString &connectionName) const
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase( driver, connectionName );
+    db.setHostName(     hostName );
+    db.setDatabaseName( databaseName );
+    db.setUserName(     userName );
+    db.setPassword(     password );
+    db.setPort( port );
+
+    return db;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QString>
+
+class QSettings;
+class QSqlDatabase;
+
+/**
+ * @brief The ConnectionSettings struct holds everything that is needed to open database connection.
+ * Unlike QSqlDatabase it may be freely copied between threads.
+ */
+struct ConnectionSettings
+{
+    QString driver;
+    QString hostName;
+    QString databaseName;
+    QString userName;
+    QString password;
+    uint port;
+
+    ConnectionSettings();
+
+    /**
+     * @brief read reads connection settings from given group of settings file
+     */
+    static ConnectionSettings read( QSettings& settings, const QString& group );
+
+    /**
+     * @brief addDatabase adds connection with given name to list of connections of the calling thread
+     */
+    QSqlDatabase addDatabase( const QString& connectionName ) const;
+};
@@ -0,0 +1,1074 @@
+#include "dataservice.h"
+#include "connectionsettings.h"
+#include "sqldialect.h"
+#include "queryprofiler.h"
+#include "fetchtuning.h"
+#include "resultcache.h"
+#include "passwordhasher.h"
+#include "sessiontoken.h"
+#include "stringpool.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSettings>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QVariantList>
+#include <QDateTime>
+#include <QtConcurrentRun>
+#include <QDebug>
+
+namespace
+{
+/**
+ * @brief insertBundledBooks inserts books into bundle: uses array binds when backend supports them
+ * or multi-row inserts otherwise
+ * @return true on success
+ */
+bool insertBundledBooks( QSqlDatabase& db, const uint bundleID, const QStringList& isbns, const QList< qint64 >& netCents
+                       , const QList< qreal >& discounts )
+{
+    const SqlDialect& dialect = SqlDialect::forDriver( db.driverName() );
+    const int chunkSize = dialect.multiRowInsertLimit();
+
+    if (1 == chunkSize)
+    {
+        QVariantList isbnList;
+        QVariantList bundleIdList;
+        QVariantList netCentsList;
+        QVariantList discountList;
+        for (int i( 0 ); isbns.size() != i; ++i)
+        {
+            isbnList     << isbns.at( i );
+            bundleIdList << bundleID;
+            netCentsList << netCents.at( i );
+            discountList << discounts.at( i );
+        }
+
+        QSqlQuery addBooksQuery( db );
+        qDebug() << "Prepare: " <<
+                    addBooksQuery.prepare( dialect.insertBundledBooksStatement( 1 ) );
+        addBooksQuery.bindValue( ":isbn0", isbnList );
+        addBooksQuery.bindValue( ":bundle_id0", bundleIdList );
+        addBooksQuery.bindValue( ":net_cents0", netCentsList );
+        addBooksQuery.bindValue( ":discount0", discountList );
+
+        const bool execResult = addBooksQuery.execBatch();
+        qDebug() << "ExecBatch: " << execResult;
+        return execResult;
+    }
+
+    for (int offset( 0 ); isbns.size() > offset; offset += chunkSize)
+    {
+        const int rows = qMin( chunkSize, isbns.size() - offset );
+
+        QSqlQuery addBooksQuery( db );
+        qDebug() << "Prepare: " <<
+                    addBooksQuery.prepare( dialect.insertBundledBooksStatement( rows ) );
+        for (int i( 0 ); rows != i; ++i)
+        {
+            addBooksQuery.bindValue( QString( ":isbn%1" ).arg( i ), isbns.at( offset + i ) );
+            addBooksQuery.bindValue( QString( ":bundle_id%1" ).arg( i ), bundleID );
+            addBooksQuery.bindValue( QString( ":net_cents%1" ).arg( i ), netCents.at( offset + i ) );
+            addBooksQuery.bindValue( QString( ":discount%1" ).arg( i ), discounts.at( offset + i ) );
+        }
+
+        const bool execResult = QueryProfiler::exec( addBooksQuery, db.connectionName() );
+        qDebug() << "Exec: " << execResult;
+        if (!execResult)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief insertBundleHeader creates new (empty) bundle
+ * @param bundleID id of created bundle
+ * @return true on success
+ */
+bool insertBundleHeader( QSqlDatabase& db, const QString& name, const QString& comment, uint& bundleID )
+{
+    const SqlDialect& dialect = SqlDialect::forDriver( db.driverName() );
+
+    QSqlQuery addBundleQuery( db );
+    addBundleQuery.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                addBundleQuery.prepare( dialect.insertBundleStatement() );
+    addBundleQuery.bindValue( ":name", name );
+    addBundleQuery.bindValue( ":commnt", comment );
+
+    const bool addBundleResult = addBundleQuery.exec();
+    qDebug() << "Exec: " << addBundleResult;
+    if (!addBundleResult)
+        return false;
+
+    bundleID = 0;
+    if (dialect.insertBundleReturnsId())
+    {
+        qDebug() << "First: " << addBundleQuery.first();
+        bundleID = addBundleQuery.value( 0 ).toUInt();
+    }
+    else
+    {
+        QSqlQuery getBundleIdQuery( db );
+        getBundleIdQuery.setForwardOnly( true );
+        qDebug() << "Prepare: " <<
+                    getBundleIdQuery.prepare( dialect.lastBundleIdQuery() );
+        qDebug() << "Exec: " << getBundleIdQuery.exec() << getBundleIdQuery.first();
+
+        bundleID = getBundleIdQuery.value( 0 ).toUInt();
+    }
+    qDebug() << "BundleID: " << bundleID;
+
+    return 0 != bundleID;
+}
+
+/**
+ * @brief execBundleBatch executes statement once for every given book of bundle with array binds
+ * (used where backend has them, see SqlDialect::multiRowInsertLimit).
+ * Statement binds :isbn, :bundle_id and, if net prices are given, :net_cents and :discount
+ * @return true on success
+ */
+bool execBundleBatch( QSqlDatabase& db, const QString& statement, const uint bundleID, const QStringList& isbns
+                    , const QList< qint64 >& netCents = QList< qint64 >()
+                    , const QList< qreal >& discounts = QList< qreal >() )
+{
+    if (isbns.isEmpty())
+        return true;
+
+    QVariantList isbnList;
+    QVariantList bundleIdList;
+    QVariantList netCentsList;
+    QVariantList discountList;
+    for (int i( 0 ); isbns.size() != i; ++i)
+    {
+        isbnList     << isbns.at( i );
+        bundleIdList << bundleID;
+        if (!netCents.isEmpty())
+        {
+            netCentsList << netCents.at( i );
+            discountList << discounts.at( i );
+        }
+    }
+
+    QSqlQuery batchQuery( db );
+    qDebug() << "Prepare: " << batchQuery.prepare( statement );
+    batchQuery.bindValue( ":isbn", isbnList );
+    batchQuery.bindValue( ":bundle_id", bundleIdList );
+    if (!netCents.isEmpty())
+    {
+        batchQuery.bindValue( ":net_cents", netCentsList );
+        batchQuery.bindValue( ":discount", discountList );
+    }
+
+    const bool execResult = batchQuery.execBatch();
+    qDebug() << "ExecBatch: " << execResult << isbns.size();
+    if (!execResult)
+        qDebug() << batchQuery.lastError();
+    return execResult;
+}
+
+/**
+ * @brief removeBundledBooks marks books of bundle as deleted: uses array binds when backend supports them
+ * or chunks of IN lists otherwise
+ * @return true on success
+ */
+bool removeBundledBooks( QSqlDatabase& db, const uint bundleID, const QStringList& isbns )
+{
+    const SqlDialect& dialect = SqlDialect::forDriver( db.driverName() );
+    const int chunkSize = dialect.multiRowInsertLimit();
+    if (1 == chunkSize)
+        return execBundleBatch( db, "UPDATE bundledbook SET deleted = 1 WHERE bundle_id = :bundle_id AND isbn = :isbn"
+                              , bundleID, isbns );
+
+    for (int offset( 0 ); isbns.size() > offset; offset += chunkSize)
+    {
+        const int rows = qMin( chunkSize, isbns.size() - offset );
+
+        QSqlQuery removeBooksQuery( db );
+        qDebug() << "Prepare: " <<
+                    removeBooksQuery.prepare( dialect.removeBundledBooksStatement( rows ) );
+        removeBooksQuery.bindValue( ":bundle_id", bundleID );
+        for (int i( 0 ); rows != i; ++i)
+            removeBooksQuery.bindValue( QString( ":isbn%1" ).arg( i ), isbns.at( offset + i ) );
+
+        const bool execResult = QueryProfiler::exec( removeBooksQuery, db.connectionName() );
+        qDebug() << "Exec: " << execResult << rows;
+        if (!execResult)
+        {
+            qDebug() << removeBooksQuery.lastError();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief upsertBundledBooks adds books to bundle (reviving soft-deleted ones) or changes net prices
+ * of books that are there: uses array binds when backend supports them or multi-row upserts otherwise
+ * @return true on success
+ */
+bool upsertBundledBooks( QSqlDatabase& db, const uint bundleID, const QStringList& isbns, const QList< qint64 >& netCents
+                       , const QList< qreal >& discounts )
+{
+    const SqlDialect& dialect = SqlDialect::forDriver( db.driverName() );
+    const int chunkSize = dialect.multiRowInsertLimit();
+    if (1 == chunkSize)
+        return execBundleBatch( db, dialect.upsertBundledBookStatement(), bundleID, isbns, netCents, discounts );
+
+    for (int offset( 0 ); isbns.size() > offset; offset += chunkSize)
+    {
+        const int rows = qMin( chunkSize, isbns.size() - offset );
+
+        QSqlQuery upsertBooksQuery( db );
+        qDebug() << "Prepare: " <<
+                    upsertBooksQuery.prepare( dialect.upsertBundledBooksStatement( rows ) );
+        for (int i( 0 ); rows != i; ++i)
+        {
+            upsertBooksQuery.bindValue( QString( ":isbn%1" ).arg( i ), isbns.at( offset + i ) );
+            upsertBooksQuery.bindValue( QString( ":bundle_id%1" ).arg( i ), bundleID );
+            upsertBooksQuery.bindValue( QString( ":net_cents%1" ).arg( i ), netCents.at( offset + i ) );
+            upsertBooksQuery.bindValue( QString( ":discount%1" ).arg( i ), discounts.at( offset + i ) );
+        }
+
+        const bool execResult = QueryProfiler::exec( upsertBooksQuery, db.connectionName() );
+        qDebug() << "Exec: " << execResult << rows;
+        if (!execResult)
+        {
+            qDebug() << upsertBooksQuery.lastError();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief updateBundleHeader changes name and comment of existing bundle
+ * @return true on success
+ */
+bool updateBundleHeader( QSqlDatabase& db, const uint bundleID, const QString& name, const QString& comment )
+{
+    QSqlQuery updateBundleQuery( db );
+    qDebug() << "Prepare: " <<
+                updateBundleQuery.prepare( "UPDATE bundle "
+                                           "SET name = :name, commnt = :commnt "
+                                           "WHERE bundle_id = :bundleID" );
+    updateBundleQuery.bindValue( ":name", name );
+    updateBundleQuery.bindValue( ":commnt", comment );
+    updateBundleQuery.bindValue( ":bundleID", bundleID );
+
+    const bool updateResult = updateBundleQuery.exec();
+    qDebug() << "Exec: " << updateResult;
+    return updateResult;
+}
+
+/**
+ * @brief findPasswordHash finds stored password hash of clerk
+ * @param found false if there is no such clerk
+ * @return false if query has failed
+ */
+bool findPasswordHash( QSqlDatabase& db, const QString& clerkID, QString& passwordHash, bool& found )
+{
+    QSqlQuery searchPasswordHash( db );
+    searchPasswordHash.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                searchPasswordHash.prepare( "SELECT password_hash "
+                                            "FROM clerk "
+                                            "WHERE clerk_id = :clerkID" );
+    searchPasswordHash.bindValue( ":clerkID", clerkID );
+
+    const bool execResult = searchPasswordHash.exec();
+    qDebug() << "Exec: " << execResult;
+    found = execResult && searchPasswordHash.next();
+    qDebug() << "Found: " << found;
+
+    passwordHash = searchPasswordHash.value( 0 ).toString();
+    return execResult;
+}
+
+/**
+ * @brief storePasswordHash replaces password hash of clerk (used to upgrade legacy or weak hashes)
+ */
+bool storePasswordHash( QSqlDatabase& db, const QString& clerkID, const QString& passwordHash )
+{
+    QSqlQuery updateQuery( db );
+    qDebug() << "Prepare: " <<
+                updateQuery.prepare( "UPDATE clerk "
+                                     "SET password_hash = :passwordHash "
+                                     "WHERE clerk_id = :clerkID" );
+    updateQuery.bindValue( ":clerkID", clerkID );
+    updateQuery.bindValue( ":passwordHash", passwordHash );
+
+    const bool queryResult = updateQuery.exec();
+    qDebug() << "Exec: " << queryResult;
+    return queryResult;
+}
+
+/**
+ * @brief findRequest reads current state of request for book (quantity, clerk and version are 0
+ * if there is no request)
+ * @return false if query has failed
+ */
+bool findRequest( QSqlDatabase& db, DataService::Request& request )
+{
+    QSqlQuery findQuery( db );
+    findQuery.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                findQuery.prepare( "SELECT quantity, clerk_id, version FROM request WHERE isbn = :isbn" );
+    findQuery.bindValue( ":isbn", request.isbn );
+
+    const bool execResult = QueryProfiler::exec( findQuery, db.connectionName() );
+    qDebug() << "Exec: " << execResult;
+    if (!execResult)
+    {
+        qDebug() << findQuery.lastError();
+        return false;
+    }
+
+    const bool found = findQuery.first();
+    request.quantity = found ? findQuery.value( 0 ).toUInt() : 0;
+    request.clerkID  = found ? findQuery.value( 1 ).toUInt() : 0;
+    request.version  = found ? findQuery.value( 2 ).toUInt() : 0;
+
+    qDebug() << "ClerkID: " << request.clerkID << "Requested: " << request.quantity << "Version: " << request.version;
+    return true;
+}
+
+/**
+ * @brief upsertRequestRow creates request for book or changes quantity of request that has been filled
+ * by the same clerk, in one statement
+ * @param request [in] requested quantity and requesting clerk; [out] resulting request
+ * @return true on success
+ */
+bool upsertRequestRow( QSqlDatabase& db, DataService::Request& request )
+{
+    const SqlDialect& dialect = SqlDialect::forDriver( db.driverName() );
+
+    QSqlQuery upsertQuery( db );
+    upsertQuery.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                upsertQuery.prepare( dialect.upsertRequestStatement() );
+    upsertQuery.bindValue( ":isbn", request.isbn );
+    upsertQuery.bindValue( ":quantity", request.quantity );
+    upsertQuery.bindValue( ":clerkID", request.clerkID );
+
+    const bool execResult = QueryProfiler::exec( upsertQuery, db.connectionName() );
+    qDebug() << "Exec: " << execResult;
+    if (!execResult)
+    {
+        qDebug() << upsertQuery.lastError();
+        return false;
+    }
+
+    if (dialect.upsertRequestReturnsRow() && upsertQuery.first())
+    {
+        request.quantity = upsertQuery.value( 0 ).toUInt();
+        request.clerkID  = upsertQuery.value( 1 ).toUInt();
+        request.version  = upsertQuery.value( 2 ).toUInt();
+        return true;
+    }
+
+    // request of another clerk was left untouched (or backend can't return row)
+    return findRequest( db, request );
+}
+
+/**
+ * @brief writeRequestRow changes quantity of request (deletes it, if quantity is 0), guarded by version
+ * it has been read with
+ * @param affected written rows: 0 means that request has been changed or removed since it was read
+ * @return true on success
+ */
+bool writeRequestRow( QSqlDatabase& db, const DataService::Request& read, const uint quantity, int& affected )
+{
+    QSqlQuery writeQuery( db );
+    qDebug() << "Prepare: " <<
+                writeQuery.prepare( (0 == quantity)
+                                    ? "DELETE "
+                                      "FROM request "
+                                      "WHERE isbn = :isbn AND clerk_id = :clerkID AND version = :version"
+                                    : "UPDATE request "
+                                      "SET quantity = :quantity, version = version + 1 "
+                                      "WHERE isbn = :isbn AND clerk_id = :clerkID AND version = :version" );
+    if (0 != quantity)
+        writeQuery.bindValue( ":quantity", quantity );
+    writeQuery.bindValue( ":isbn", read.isbn );
+    writeQuery.bindValue( ":clerkID", read.clerkID );
+    writeQuery.bindValue( ":version", read.version );
+
+    const bool execResult = QueryProfiler::exec( writeQuery, db.connectionName() );
+    qDebug() << "Exec: " << execResult;
+    if (!execResult)
+    {
+        qDebug() << writeQuery.lastError();
+        return false;
+    }
+
+    affected = writeQuery.numRowsAffected();
+    qDebug() << "Affected: " << affected;
+    return true;
+}
+
+/**
+ * @brief upsertRequestRows creates (or changes) requests for many books: with one array-bound statement
+ * when backend has array binds, with multi-row upserts otherwise
+ * @return true on success
+ */
+bool upsertRequestRows( QSqlDatabase& db, const QHash< QString, uint >& requests, const uint clerkID )
+{
+    QVariantList isbnList;
+    QVariantList quantityList;
+    QVariantList clerkIdList;
+    for (QHash< QString, uint >::const_iterator it = requests.constBegin(); requests.constEnd() != it; ++it)
+    {
+        isbnList     << it.key();
+        quantityList << it.value();
+        clerkIdList  << clerkID;
+    }
+
+    const SqlDialect& dialect = SqlDialect::forDriver( db.driverName() );
+    const int chunkSize = dialect.multiRowInsertLimit();
+    if (1 == chunkSize)
+    {
+        QSqlQuery upsertQuery( db );
+        qDebug() << "Prepare: " <<
+                    upsertQuery.prepare( dialect.upsertRequestStatement() );
+        upsertQuery.bindValue( ":isbn", isbnList );
+        upsertQuery.bindValue( ":quantity", quantityList );
+        upsertQuery.bindValue( ":clerkID", clerkIdList );
+
+        const bool execResult = upsertQuery.execBatch();
+        qDebug() << "ExecBatch: " << execResult << requests.size();
+        if (!execResult)
+            qDebug() << upsertQuery.lastError();
+        return execResult;
+    }
+
+    for (int offset( 0 ); isbnList.size() > offset; offset += chunkSize)
+    {
+        const int rows = qMin( chunkSize, isbnList.size() - offset );
+
+        QSqlQuery upsertQuery( db );
+        qDebug() << "Prepare: " <<
+                    upsertQuery.prepare( dialect.upsertRequestsStatement( rows ) );
+        for (int i( 0 ); rows != i; ++i)
+        {
+            upsertQuery.bindValue( QString( ":isbn%1" ).arg( i ), isbnList.at( offset + i ) );
+            upsertQuery.bindValue( QString( ":quantity%1" ).arg( i ), quantityList.at( offset + i ) );
+            upsertQuery.bindValue( QString( ":clerkID%1" ).arg( i ), clerkIdList.at( offset + i ) );
+        }
+
+        const bool execResult = QueryProfiler::exec( upsertQuery, db.connectionName() );
+        qDebug() << "Exec: " << execResult << rows;
+        if (!execResult)
+        {
+            qDebug() << upsertQuery.lastError();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief readBundle reads bundle and all its (not deleted) books with their authors.
+ * Number of queries doesn't depend on size of bundle.
+ * @return false if there is no such bundle
+ */
+bool readBundle( QSqlDatabase& db, DataService::BundleContent& bundle )
+{
+    QSqlQuery bundleQuery( db );
+    bundleQuery.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                bundleQuery.prepare( "SELECT name, commnt "
+                                     "FROM bundle "
+                                     "WHERE bundle_id = :bundleID AND deleted = 0" );
+    bundleQuery.bindValue( ":bundleID", bundle.bundleID );
+    qDebug() << "Exec: " << QueryProfiler::exec( bundleQuery, db.connectionName() );
+    if (!bundleQuery.first())
+        return false;
+
+    bundle.name    = bundleQuery.value( 0 ).toString();
+    bundle.comment = bundleQuery.value( 1 ).toString();
+
+    QSqlQuery authorsQuery( db );
+    authorsQuery.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                authorsQuery.prepare( "SELECT bb.isbn, author.name "
+                                      "FROM bundledbook bb JOIN book_s_author "
+                                                          "ON book_s_author.isbn = bb.isbn "
+                                                          "JOIN author "
+                                                          "ON author.author_id = book_s_author.author_id "
+                                      "WHERE bb.bundle_id = :bundleID AND bb.deleted = 0" );
+    authorsQuery.bindValue( ":bundleID", bundle.bundleID );
+    qDebug() << "Exec: " << QueryProfiler::exec( authorsQuery, db.connectionName() );
+
+    QHash< QString, QStringList > authors;
+    while (authorsQuery.next())
+        authors[ authorsQuery.value( 0 ).toString() ] << StringPool::intern( authorsQuery.value( 1 ).toString() );
+
+    QSqlQuery booksQuery( db );
+    booksQuery.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                booksQuery.prepare( "SELECT bb.isbn, book.title, publisher.name, book.year, book.price, bb.net_cents "
+                                    "FROM bundledbook bb JOIN book ON book.isbn = bb.isbn "
+                                                        "JOIN publisher ON publisher.publisher_id = book.publisher_id "
+                                    "WHERE bb.bundle_id = :bundleID AND bb.deleted = 0 "
+                                    "ORDER BY book.title" );
+    booksQuery.bindValue( ":bundleID", bundle.bundleID );
+
+    const bool execResult = QueryProfiler::exec( booksQuery, db.connectionName() );
+    qDebug() << "Exec: " << execResult;
+    if (!execResult)
+        return false;
+
+    while (booksQuery.next())
+    {
+        BundleModel::Item item;
+        item.isbn      = booksQuery.value( 0 ).toString();
+        item.title     = booksQuery.value( 1 ).toString();
+        item.authors   = authors.value( item.isbn ).join( ", " );
+        item.publisher = StringPool::intern( booksQuery.value( 2 ).toString() );
+        item.year      = booksQuery.value( 3 ).toUInt();
+        item.price     = booksQuery.value( 4 ).toDouble();
+        item.netCents  = booksQuery.value( 5 ).toLongLong();
+        bundle.items << item;
+    }
+    qDebug() << "Books: " << bundle.items.size();
+
+    return true;
+}
+}
+
+DataService::Connection::~Connection()
+{
+    // runs on thread that owns connection, when that thread ends
+    {
+        QSqlDatabase db = QSqlDatabase::database( m_name, false );
+        db.close();
+    }
+    QSqlDatabase::removeDatabase( m_name );
+    qDebug() << "Removed: " << m_name;
+}
+
+DataService::DataService(QObject * const parent)
+    : QObject( parent )
+{
+    const QSettings settings( "settings.ini", QSettings::IniFormat );
+    m_pool.setMaxThreadCount( qMax( 1, settings.value( "dataservice/threads", 2 ).toInt() ) );
+    m_filterPool.setMaxThreadCount( 1 );
+    // threads (and their connections) live until closeConnections() or as long as service does
+    m_pool.setExpiryTimeout( -1 );
+    m_filterPool.setExpiryTimeout( -1 );
+}
+
+DataService::~DataService()
+{
+    // threads end here, every one removes its connection (pools wait for their threads)
+    m_filterPool.waitForDone();
+    m_pool.waitForDone();
+}
+
+bool DataService::closeConnections(const int msecs)
+{
+    cancelAll();
+
+    // pool whose work is done ends its threads
+    const bool filterDone = m_filterPool.waitForDone( msecs );
+    const bool done = m_pool.waitForDone( msecs );
+    qDebug() << "Connections closed: " << filterDone << done;
+    return filterDone && done;
+}
+
+QSqlDatabase DataService::connection(const QString &tuning) const
+{
+    if (!m_connections.hasLocalData())
+    {
+        const QString connectionName = QString( "data-%1" ).arg( reinterpret_cast< quintptr >( QThread::currentThread() ) );
+        QSettings settings( "settings.ini", QSettings::IniFormat );
+        QSqlDatabase db = ConnectionSettings::read( settings, "database" ).addDatabase( connectionName );
+
+        m_connections.setLocalData( new Connection( connectionName ) );
+        if (!tuning.isEmpty())
+            m_connections.localData()->setPrefetchRows( FetchTuning::apply( db, tuning ) );
+    }
+
+    Connection * const threadConnection = m_connections.localData();
+    const QString connectionName = threadConnection->name();
+    QSqlDatabase db = QSqlDatabase::database( connectionName, false );
+
+    // connection lives as long as its thread: prefetch learned since it was opened is applied by reopening it
+    if (!tuning.isEmpty() && FetchTuning::prefetchRows( db.driverName(), tuning ) != threadConnection->prefetchRows())
+    {
+        db.close();
+        threadConnection->setPrefetchRows( FetchTuning::apply( db, tuning ) );
+        qDebug() << "Re-tuned: " << connectionName << threadConnection->prefetchRows();
+    }
+    if (!db.isOpen() && !db.open())
+        qDebug() << connectionName << db.lastError();
+    return db;
+}
+
+QFuture< BookDetail > DataService::fetchBookDetail(const QString &isbn, const uint lookbackDays)
+{
+    return QtConcurrent::run( &m_pool, this, &DataService::doFetchBookDetail, isbn, lookbackDays );
+}
+
+QFuture< DataService::FilterResult > DataService::runFilter(const FilterParams &params)
+{
+    CancellationToken filterToken;
+    {
+        QMutexLocker locker( &m_mutex );
+        m_filterToken.cancel();
+        m_filterToken = filterToken;
+    }
+
+    return QtConcurrent::run( &m_filterPool, this, &DataService::doRunFilter, params, filterToken );
+}
+
+QFuture< Workflow::Outcome > DataService::saveBundle(const Bundle &bundle)
+{
+    return QtConcurrent::run( &m_pool, this, &DataService::doSaveBundle, bundle, token() );
+}
+
+QFuture< DataService::LoginResult > DataService::login(const QString &clerkID, const QString &password
+                                                     , const QString &database)
+{
+    return QtConcurrent::run( &m_pool, this, &DataService::doLogin, clerkID, password, database, token() );
+}
+
+QFuture< DataService::RequestResult > DataService::upsertRequest(const QString &isbn, const uint quantity
+                                                                , const uint clerkID)
+{
+    return QtConcurrent::run( &m_pool, this, &DataService::doUpsertRequest, isbn, quantity, clerkID, token() );
+}
+
+QFuture< DataService::RequestResult > DataService::writeRequest(const Request &read, const uint wanted)
+{
+    return QtConcurrent::run( &m_pool, this, &DataService::doWriteRequest, read, wanted, token() );
+}
+
+QFuture< Workflow::Outcome > DataService::upsertRequests(const QHash<QString, uint> &requests, const uint clerkID)
+{
+    return QtConcurrent::run( &m_pool, this, &DataService::doUpsertRequests, requests, clerkID, token() );
+}
+
+QFuture< DataService::BundleContent > DataService::loadBundle(const uint bundleID)
+{
+    return QtConcurrent::run( &m_pool, this, &DataService::doLoadBundle, bundleID );
+}
+
+QFuture< QVector< DataService::BundleSummary > > DataService::fetchBundlePage(const uint afterID, const int pageSize
+                                                                            , const uint lookbackDays)
+{
+    return QtConcurrent::run( &m_pool, this, &DataService::doFetchBundlePage, afterID, pageSize, lookbackDays );
+}
+
+QFuture< QVector< DataService::BundleBook > > DataService::fetchBundleBooks(const uint bundleID)
+{
+    return QtConcurrent::run( &m_pool, this, &DataService::doFetchBundleBooks, bundleID );
+}
+
+QFuture< DataService::SchemaState > DataService::checkSchema(const bool checkIndexes)
+{
+    return QtConcurrent::run( &m_pool, this, &DataService::doCheckSchema, checkIndexes );
+}
+
+QFuture< bool > DataService::createSchema()
+{
+    return QtConcurrent::run( &m_pool, this, &DataService::doCreateSchema );
+}
+
+QFuture< bool > DataService::upgradeSchema(const QList<Schema::Upgrade> &upgrades)
+{
+    return QtConcurrent::run( &m_pool, this, &DataService::doUpgradeSchema, upgrades );
+}
+
+void DataService::warmUp()
+{
+    QtConcurrent::run( &m_pool, this, &DataService::doWarmUp, QString() );
+    QtConcurrent::run( &m_filterPool, this, &DataService::doWarmUp, QString( "filter" ) );
+}
+
+void DataService::waitForDone()
+{
+    m_filterPool.waitForDone();
+    m_pool.waitForDone();
+}
+
+void DataService::doWarmUp(const QString &tuning) const
+{
+    qDebug() << "Warm up: " << connection( tuning ).isOpen();
+}
+
+BookDetail DataService::doFetchBookDetail(const QString &isbn, const uint lookbackDays) const
+{
+    BookDetail detail;
+    detail.isbn = isbn;
+
+    QSqlDatabase db = connection();
+    const bool loadResult = db.isOpen() && BookDetail::load( isbn, lookbackDays, detail, db );
+    qDebug() << "Detail: " << loadResult;
+    if (!loadResult)
+        return BookDetail();
+
+    return detail;
+}
+
+DataService::FilterResult DataService::doRunFilter(const FilterParams &params, const CancellationToken &token) const
+{
+    FilterResult result;
+    result.ok = false;
+    result.unchanged = false;
+    result.cacheHits = 0;
+
+    // superseded while it was queued
+    if (token.isCancelled())
+        return result;
+
+    QSqlDatabase db = connection( "filter" );
+    if (!db.isOpen())
+        return result;
+
+    // rows caller has are still current: whole stock isn't read (not even from cache) again
+    result.freshness = ResultCache::freshnessToken( db );
+    if (!result.freshness.isEmpty() && params.knownFreshness == result.freshness)
+    {
+        qDebug() << "Filter: data hasn't moved";
+        result.ok = true;
+        result.unchanged = true;
+        return result;
+    }
+
+    // heavy results are served from local cache while data hasn't moved
+    const ResultCache cache( params.cacheKey, result.freshness );
+
+    QElapsedTimer fetchTimer;
+    fetchTimer.start();
+
+    QSqlQuery stockSearch( db );
+    stockSearch.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                stockSearch.prepare( "SELECT isbn, quantity "
+                                     "FROM book "
+                                     "WHERE quantity BETWEEN :fromStock AND :toStock" );
+    stockSearch.bindValue( ":fromStock", params.fromStock );
+    stockSearch.bindValue( ":toStock", params.toStock );
+
+    QVector< QVariantList > rows;
+    if (!cache.rows( stockSearch, rows, db.connectionName() ))
+        return result;
+
+    result.isbns.reserve( rows.size() );
+    result.quantities.reserve( rows.size() );
+    for (int i( 0 ); rows.size() != i; ++i)
+    {
+        result.isbns      << rows.at( i ).at( 0 ).toString();
+        result.quantities << rows.at( i ).at( 1 ).toUInt();
+    }
+    if (0 == cache.hits())
+        FetchTuning::record( "filter", result.isbns.size(), fetchTimer.elapsed() );
+
+    // superseded while stock was read
+    if (token.isCancelled())
+    {
+        qDebug() << "Filter superseded";
+        return result;
+    }
+
+    result.ok = result.histogram.fetch( cache, db );
+    result.cacheHits = cache.hits();
+    qDebug() << "Filter: " << result.ok << result.isbns.size() << "row(s), served from cache: " << result.cacheHits;
+    return result;
+}
+
+Workflow::Outcome DataService::doSaveBundle(const Bundle &bundle, const CancellationToken &token) const
+{
+    QSqlDatabase db = connection();
+    Workflow workflow( db, token );
+
+    if (0 == bundle.bundleID)
+    {
+        uint bundleID = 0;
+        if (workflow.step( "insert bundle" ))
+            workflow.check( insertBundleHeader( db, bundle.name, bundle.comment, bundleID ) );
+        if (workflow.step( "insert books" ))
+            workflow.check( insertBundledBooks( db, bundleID, bundle.isbns, bundle.netCents, bundle.discounts ) );
+        return workflow.commit();
+    }
+
+    const BundleModel::ChangeSet& changes = bundle.changes;
+    qDebug() << "Added: " << changes.addedISBNs
+             << "Removed: " << changes.removedISBNs
+             << "Re-discounted: " << changes.rediscountedISBNs;
+
+    if (workflow.step( "update bundle" ))
+        workflow.check( updateBundleHeader( db, bundle.bundleID, bundle.name, bundle.comment ) );
+    // removed books are marked as deleted
+    if (workflow.step( "remove books" ))
+        workflow.check( removeBundledBooks( db, bundle.bundleID, changes.removedISBNs ) );
+    // only re-discounted books are updated (they are in bundle, so upsert only changes their prices)
+    if (workflow.step( "change discounts" ))
+        workflow.check( upsertBundledBooks( db, bundle.bundleID, changes.rediscountedISBNs
+                                          , changes.rediscountedNetCents, changes.rediscountedDiscounts ) );
+    // added books are inserted (or revived if they were deleted before)
+    if (workflow.step( "add books" ))
+        workflow.check( upsertBundledBooks( db, bundle.bundleID, changes.addedISBNs, changes.addedNetCents
+                                          , changes.addedDiscounts ) );
+    return workflow.commit();
+}
+
+DataService::LoginResult DataService::doLogin(const QString &clerkID, const QString &password
+                                              , const QString &database, const CancellationToken &token) const
+{
+    LoginResult result;
+    result.clerkID       = clerkID;
+    result.authenticated = false;
+
+    QSqlDatabase db = connection();
+    Workflow workflow( db, token );
+
+    QString passwordHash;
+    bool found = false;
+    if (workflow.step( "find clerk" ))
+        workflow.check( findPasswordHash( db, clerkID, passwordHash, found ) );
+
+    const PasswordHasher hasher( PasswordHasher::fromSettings() );
+    bool needsRehash = false;
+    // unknown clerk is verified against dummy hash: the same key derivation, so login time doesn't tell
+    // which clerk IDs exist
+    if (workflow.step( "verify password" ))
+        result.authenticated = hasher.verify( password, found ? passwordHash : hasher.dummyHash(), needsRehash )
+                            && found;
+
+    // legacy or weak hash is upgraded while password is at hand
+    if (result.authenticated && needsRehash && workflow.step( "rehash password" ))
+        workflow.check( storePasswordHash( db, clerkID, hasher.hash( password ) ) );
+
+    result.outcome = workflow.commit();
+    // failed upgrade of hash doesn't prevent login
+    result.authenticated = result.authenticated && !result.outcome.cancelled;
+    if (result.authenticated)
+        SessionToken::issue( database, clerkID, password );
+    return result;
+}
+
+DataService::RequestResult DataService::doUpsertRequest(const QString &isbn, const uint quantity, const uint clerkID
+                                                        , const CancellationToken &token) const
+{
+    RequestResult result;
+    result.conflict         = false;
+    result.wanted           = quantity;
+    result.request.isbn     = isbn;
+    result.request.quantity = quantity;
+    result.request.clerkID  = clerkID;
+    result.request.version  = 0;
+
+    QSqlDatabase db = connection();
+    Workflow workflow( db, token );
+    if (workflow.step( "upsert request" ))
+        workflow.check( upsertRequestRow( db, result.request ) );
+    result.outcome = workflow.commit();
+    return result;
+}
+
+DataService::RequestResult DataService::doWriteRequest(const Request &read, const uint wanted
+                                                       , const CancellationToken &token) const
+{
+    RequestResult result;
+    result.conflict = false;
+    result.wanted   = wanted;
+    result.request  = read;
+
+    QSqlDatabase db = connection();
+    Workflow workflow( db, token );
+
+    int affected = 0;
+    if (workflow.step( (0 == wanted) ? "remove request" : "modify request" ))
+        workflow.check( writeRequestRow( db, read, wanted, affected ) );
+
+    // write that matches no row: request has been changed or removed since it was read, nothing is written
+    result.conflict = workflow.isOk() && 1 != affected;
+    if (result.conflict && workflow.step( "read request" ))
+        workflow.check( findRequest( db, result.request ) );
+
+    result.outcome = workflow.commit();
+    if (result.outcome.ok && !result.conflict)
+    {
+        result.request.quantity = wanted;
+        result.request.clerkID  = (0 == wanted) ? 0 : read.clerkID;
+        result.request.version  = (0 == wanted) ? 0 : read.version + 1;
+    }
+    return result;
+}
+
+Workflow::Outcome DataService::doUpsertRequests(const QHash<QString, uint> &requests, const uint clerkID
+                                                , const CancellationToken &token) const
+{
+    QSqlDatabase db = connection();
+    Workflow workflow( db, token );
+    if (workflow.step( "submit requests" ))
+        workflow.check( upsertRequestRows( db, requests, clerkID ) );
+    return workflow.commit();
+}
+
+DataService::BundleContent DataService::doLoadBundle(const uint bundleID) const
+{
+    BundleContent bundle;
+    bundle.bundleID = bundleID;
+
+    QSqlDatabase db = connection();
+    bundle.ok = db.isOpen() && readBundle( db, bundle );
+    return bundle;
+}
+
+QVector< DataService::BundleSummary > DataService::doFetchBundlePage(const uint afterID, const int pageSize
+                                                                   , const uint lookbackDays) const
+{
+    QVector< BundleSummary > page;
+
+    QSqlDatabase db = connection();
+    if (!db.isOpen())
+        return page;
+    const SqlDialect& dialect = SqlDialect::forDriver( db.driverName() );
+
+    QSqlQuery pageQuery( db );
+    pageQuery.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                pageQuery.prepare( "SELECT p.bundle_id, p.name, COUNT(bb.isbn), SUM(bk.price), "
+                                          "SUM(bb.net_cents), SUM(s.sold), SUM(bk.quantity) "
+                                   "FROM (SELECT bundle_id, name FROM bundle "
+                                         "WHERE deleted = 0 AND bundle_id > :after "
+                                         "ORDER BY bundle_id " + dialect.limitClause() + ") p "
+                                   "LEFT JOIN bundledbook bb ON bb.bundle_id = p.bundle_id AND bb.deleted = 0 "
+                                   "LEFT JOIN book bk ON bk.isbn = bb.isbn "
+                                   "LEFT JOIN (SELECT isbn, SUM(sold) sold "
+                                              "FROM (SELECT isbn, COUNT(*) sold FROM history_of_purchasing "
+                                                    "WHERE purchasing_date >= :since GROUP BY isbn "
+                                                    "UNION ALL "
+                                                    "SELECT isbn, SUM(sold) sold FROM daily_sales "
+                                                    "WHERE sale_date >= :summarySince GROUP BY isbn) u "
+                                              "GROUP BY isbn) s "
+                                          "ON s.isbn = bb.isbn "
+                                   "GROUP BY p.bundle_id, p.name "
+                                   "ORDER BY p.bundle_id" );
+    pageQuery.bindValue( ":after", afterID );
+    pageQuery.bindValue( ":limit", pageSize );
+    // the same window as "sold" of input view
+    const QDate since = QDate::currentDate()
+                        .addDays( -static_cast< int >( SalesHistogram::daysBefore( lookbackDays ) ) );
+    pageQuery.bindValue( ":since", since.startOfDay() );
+    pageQuery.bindValue( ":summarySince", since );
+
+    const bool execResult = QueryProfiler::exec( pageQuery, db.connectionName() );
+    qDebug() << "Exec: " << execResult;
+    if (!execResult)
+    {
+        qDebug() << pageQuery.lastError();
+        return page;
+    }
+
+    while (pageQuery.next())
+    {
+        BundleSummary bundle;
+        bundle.id           = pageQuery.value( 0 ).toUInt();
+        bundle.name         = pageQuery.value( 1 ).toString();
+        bundle.items        = pageQuery.value( 2 ).toUInt();
+        bundle.listPrice    = pageQuery.value( 3 ).toDouble();
+        bundle.netCents     = pageQuery.value( 4 ).toLongLong();
+        const qreal sold    = pageQuery.value( 5 ).toDouble();
+        const qreal inStock = pageQuery.value( 6 ).toDouble();
+        bundle.sellThrough  = (0.0 < sold + inStock) ? sold / (sold + inStock) : 0.0;
+        page << bundle;
+    }
+    qDebug() << "Bundles fetched: " << page.size();
+
+    return page;
+}
+
+QVector< DataService::BundleBook > DataService::doFetchBundleBooks(const uint bundleID) const
+{
+    QVector< BundleBook > books;
+
+    QSqlDatabase db = connection();
+    if (!db.isOpen())
+        return books;
+
+    QSqlQuery booksQuery( db );
+    booksQuery.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                booksQuery.prepare( "SELECT bb.isbn, bk.title, bk.price, bb.net_cents "
+                                    "FROM bundledbook bb JOIN book bk ON bk.isbn = bb.isbn "
+                                    "WHERE bb.bundle_id = :bundleID AND bb.deleted = 0 "
+                                    "ORDER BY bk.title" );
+    booksQuery.bindValue( ":bundleID", bundleID );
+
+    const bool execResult = QueryProfiler::exec( booksQuery, db.connectionName() );
+    qDebug() << "Exec: " << execResult;
+    if (!execResult)
+    {
+        qDebug() << booksQuery.lastError();
+        return books;
+    }
+
+    while (booksQuery.next())
+    {
+        BundleBook book;
+        book.isbn     = booksQuery.value( 0 ).toString();
+        book.title    = booksQuery.value( 1 ).toString();
+        book.price    = booksQuery.value( 2 ).toDouble();
+        book.netCents = booksQuery.value( 3 ).toLongLong();
+        books << book;
+    }
+
+    return books;
+}
+
+DataService::SchemaState DataService::doCheckSchema(const bool checkIndexes) const
+{
+    SchemaState state;
+    state.hasTables = false;
+
+    QSqlDatabase db = connection();
+    state.ok = db.isOpen();
+    if (!state.ok)
+        return state;
+
+    state.hasTables = Schema::hasTables( db );
+    if (!state.hasTables)
+        return state;
+
+    state.upgrades = Schema::findUpgrades( db );
+    // indexes of missing tables can't be created anyway, so they are checked only in up-to-date database
+    if (checkIndexes && state.upgrades.isEmpty() && !Schema::findMissingIndexes( state.missingIndexes, db ))
+        state.missingIndexes.clear();
+    return state;
+}
+
+bool DataService::doCreateSchema() const
+{
+    QSqlDatabase db = connection();
+    return db.isOpen() && Schema::create( db );
+}
+
+bool DataService::doUpgradeSchema(const QList<Schema::Upgrade> &upgrades) const
+{
+    QSqlDatabase db = connection();
+    return db.isOpen() && Schema::upgrade( upgrades, db );
+}
+
+void DataService::cancelAll()
+{
+    QMutexLocker locker( &m_mutex );
+    m_token.cancel();
+    m_token = CancellationToken();
+    m_filterToken.cancel();
+}
+
+CancellationToken DataService::token() const
+{
+    QMutexLocker locker( &m_mutex );
+    return m_token;
+}
@@ -0,0 +1,358 @@
+#pragma once
+
+#include <QObject>
+#include <QFuture>
+#include <QThreadPool>
+#include <QMutex>
+#include <QThreadStorage>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QList>
+#include <QHash>
+
+#include "bookdetail.h"
+#include "bundlemodel.h"
+#include "saleshistogram.h"
+#include "schema.h"
+#include "workflow.h"
+
+class QSqlDatabase;
+
+/**
+ * @brief The DataService class runs database work on its own small thread pool ("dataservice/threads"
+ * of settings.ini); filter runs on dedicated thread of its own, so it never holds up other work.
+ * Every pool thread has its own connection, opened on first use and kept open until closeConnections()
+ * (or until service is destroyed); connection is closed and removed by thread that owns it.
+ * Independent reads run concurrently and never block GUI thread.
+ * Results are delivered as futures (watch them with QFutureWatcher).
+ */
+class DataService : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief The FilterParams struct bounds of stock for filter query
+     */
+    struct FilterParams
+    {
+        uint fromStock;
+        uint toStock;
+        /**
+         * @brief cacheKey identifies database in local result cache
+         */
+        QString cacheKey;
+        /**
+         * @brief knownFreshness freshness token of rows caller already has for the same bounds (empty if none):
+         * while data hasn't moved since, nothing is read again
+         */
+        QString knownFreshness;
+    };
+
+    /**
+     * @brief The FilterResult struct books in stock within bounds and sales histogram
+     */
+    struct FilterResult
+    {
+        bool ok;
+        QVector< QString > isbns;
+        QVector< uint > quantities;
+        SalesHistogram histogram;
+        /**
+         * @brief freshness freshness token of data rows were read at (see ResultCache::freshnessToken)
+         */
+        QString freshness;
+        /**
+         * @brief unchanged whether data hasn't moved since FilterParams::knownFreshness (no rows are read then)
+         */
+        bool unchanged;
+        /**
+         * @brief cacheHits how many results have been served from local result cache
+         */
+        int cacheHits;
+    };
+
+    /**
+     * @brief The Bundle struct bundle to be saved: new one (bundleID is 0) with all its books
+     * or changes of existing one
+     */
+    struct Bundle
+    {
+        uint bundleID;
+        QString name;
+        QString comment;
+        QStringList isbns;
+        /**
+         * @brief netCents exact net prices of books; discounts are what they amount to (kept in discount column)
+         */
+        QList< qint64 > netCents;
+        QList< qreal > discounts;
+        BundleModel::ChangeSet changes;
+    };
+
+    /**
+     * @brief The LoginResult struct result of login
+     */
+    struct LoginResult
+    {
+        QString clerkID;
+        bool authenticated;
+        Workflow::Outcome outcome;
+    };
+
+    /**
+     * @brief The Request struct request for book as it has been read (quantity is 0 if there is no request)
+     */
+    struct Request
+    {
+        QString isbn;
+        uint quantity;
+        uint clerkID;
+        /**
+         * @brief version request is modified or removed only if its version hasn't changed since it was read
+         */
+        uint version;
+    };
+
+    /**
+     * @brief The RequestResult struct result of write of request
+     */
+    struct RequestResult
+    {
+        Workflow::Outcome outcome;
+        /**
+         * @brief conflict whether request has been changed (or removed) since it was read: nothing is written then
+         */
+        bool conflict;
+        /**
+         * @brief wanted quantity clerk wants (0 to remove request)
+         */
+        uint wanted;
+        /**
+         * @brief request request as it is after write (or as it has been found, on conflict)
+         */
+        Request request;
+    };
+
+    /**
+     * @brief The BundleContent struct bundle with all its (not deleted) books, loaded for modification
+     */
+    struct BundleContent
+    {
+        /**
+         * @brief ok false if there is no such bundle (or it can't be read)
+         */
+        bool ok;
+        uint bundleID;
+        QString name;
+        QString comment;
+        QVector< BundleModel::Item > items;
+    };
+
+    /**
+     * @brief The BundleSummary struct bundle as bundle selection pane shows it
+     */
+    struct BundleSummary
+    {
+        uint    id;
+        QString name;
+        uint    items;
+        qreal   listPrice;
+        qint64  netCents;
+        /**
+         * @brief sellThrough sold / (sold + in stock) for bundled books during lookback window
+         */
+        qreal   sellThrough;
+    };
+
+    /**
+     * @brief The BundleBook struct book of bundle as bundle selection pane shows it
+     */
+    struct BundleBook
+    {
+        QString isbn;
+        QString title;
+        qreal   price;
+        qint64  netCents;
+    };
+
+    /**
+     * @brief The SchemaState struct what database lacks
+     */
+    struct SchemaState
+    {
+        /**
+         * @brief ok false if connection can't be opened
+         */
+        bool ok;
+        bool hasTables;
+        QList< Schema::Upgrade > upgrades;
+        /**
+         * @brief missingIndexes indexes that queries rely on, but that are missing (looked for only
+         * if they were asked for and database is up to date)
+         */
+        QList< Schema::Index > missingIndexes;
+    };
+
+    explicit DataService(QObject * const parent = NULL);
+    ~DataService();
+
+    /**
+     * @brief fetchBookDetail reads details of book within one read snapshot
+     * (isbn of result is empty if book can't be read)
+     */
+    QFuture< BookDetail > fetchBookDetail( const QString& isbn, const uint lookbackDays );
+    /**
+     * @brief runFilter reads books in stock within bounds and sales histogram. Filter that is still
+     * queued or running is superseded: it is skipped or stops before its next query
+     */
+    QFuture< FilterResult > runFilter( const FilterParams& params );
+    /**
+     * @brief saveBundle creates (or updates) bundle in one transaction
+     */
+    QFuture< Workflow::Outcome > saveBundle( const Bundle& bundle );
+    /**
+     * @brief login verifies password of clerk (and upgrades its hash, if it is legacy or weak).
+     * Session token is issued on success
+     * @param database identifies database for session token
+     */
+    QFuture< LoginResult > login( const QString& clerkID, const QString& password, const QString& database );
+
+    /**
+     * @brief upsertRequest creates request for book or changes quantity of request that has been filled
+     * by the same clerk, in one statement. Request of another clerk is left untouched (result tells its owner)
+     */
+    QFuture< RequestResult > upsertRequest( const QString& isbn, const uint quantity, const uint clerkID );
+    /**
+     * @brief writeRequest changes quantity of request (removes it, if wanted is 0). Write is guarded
+     * by version request has been read with: request that has changed since is left as it is (see RequestResult)
+     */
+    QFuture< RequestResult > writeRequest( const Request& read, const uint wanted );
+    /**
+     * @brief upsertRequests creates (or changes) requests for many books in one transaction: with one
+     * array-bound statement when backend has array binds, with multi-row upserts otherwise.
+     * Requests filled by another clerk are left untouched
+     */
+    QFuture< Workflow::Outcome > upsertRequests( const QHash< QString, uint >& requests, const uint clerkID );
+
+    /**
+     * @brief loadBundle reads bundle and all its books with their authors (number of queries doesn't depend
+     * on size of bundle)
+     */
+    QFuture< BundleContent > loadBundle( const uint bundleID );
+    /**
+     * @brief fetchBundlePage reads page of bundles that follow afterID with one aggregate query
+     * (empty page if it can't be read)
+     * @param lookbackDays window (in days) for which sell-through is computed
+     */
+    QFuture< QVector< BundleSummary > > fetchBundlePage( const uint afterID, const int pageSize, const uint lookbackDays );
+    /**
+     * @brief fetchBundleBooks reads books of bundle
+     */
+    QFuture< QVector< BundleBook > > fetchBundleBooks( const uint bundleID );
+
+    /**
+     * @brief checkSchema finds out whether database has tables of application and what upgrades it needs
+     * @param checkIndexes whether indexes are looked for too (in up-to-date database only)
+     */
+    QFuture< SchemaState > checkSchema( const bool checkIndexes );
+    /**
+     * @brief createSchema creates all tables and indexes in empty database
+     */
+    QFuture< bool > createSchema();
+    /**
+     * @brief upgradeSchema applies upgrades, every one in its own transaction
+     */
+    QFuture< bool > upgradeSchema( const QList< Schema::Upgrade >& upgrades );
+
+    /**
+     * @brief warmUp opens connections of pool threads in background, before the first work needs them.
+     * Threads keep them open and idle thread takes the next work of its pool (e.g. login)
+     */
+    void warmUp();
+
+    /**
+     * @brief cancelAll cancels workflows that have been submitted so far (their transactions are rolled back)
+     */
+    void cancelAll();
+
+    /**
+     * @brief waitForDone waits until all submitted work is done
+     */
+    void waitForDone();
+    /**
+     * @brief closeConnections cancels submitted work and closes connections of pool threads (threads end,
+     * every one removes its own connection). New work opens new connections
+     * @param msecs how long to wait for running work
+     * @return false if some work still runs (its connection stays open until service is destroyed)
+     */
+    bool closeConnections( const int msecs );
+
+private:
+    /**
+     * @brief connection connection of calling pool thread (opened)
+     * @param tuning statement prefetch of connection is tuned for (see FetchTuning). Connection is reopened
+     * when prefetch that FetchTuning chooses for it has changed since it was opened
+     */
+    QSqlDatabase connection( const QString& tuning = QString() ) const;
+
+    void doWarmUp( const QString& tuning ) const;
+    BookDetail doFetchBookDetail( const QString& isbn, const uint lookbackDays ) const;
+    FilterResult doRunFilter( const FilterParams& params, const CancellationToken& token ) const;
+    Workflow::Outcome doSaveBundle( const Bundle& bundle, const CancellationToken& token ) const;
+    LoginResult doLogin( const QString& clerkID, const QString& password, const QString& database
+                       , const CancellationToken& token ) const;
+    RequestResult doUpsertRequest( const QString& isbn, const uint quantity, const uint clerkID
+                                 , const CancellationToken& token ) const;
+    RequestResult doWriteRequest( const Request& read, const uint wanted, const CancellationToken& token ) const;
+    Workflow::Outcome doUpsertRequests( const QHash< QString, uint >& requests, const uint clerkID
+                                      , const CancellationToken& token ) const;
+    BundleContent doLoadBundle( const uint bundleID ) const;
+    QVector< BundleSummary > doFetchBundlePage( const uint afterID, const int pageSize, const uint lookbackDays ) const;
+    QVector< BundleBook > doFetchBundleBooks( const uint bundleID ) const;
+    SchemaState doCheckSchema( const bool checkIndexes ) const;
+    bool doCreateSchema() const;
+    bool doUpgradeSchema( const QList< Schema::Upgrade >& upgrades ) const;
+    /**
+     * @brief token cancellation token for newly submitted workflow
+     */
+    CancellationToken token() const;
+
+    /**
+     * @brief The Connection class connection of one pool thread. It is removed when its thread ends
+     */
+    class Connection
+    {
+    public:
+        explicit Connection( const QString& name ) : m_name( name ), m_prefetchRows( 0 ) {}
+        ~Connection();
+
+        const QString& name() const { return m_name; }
+        /**
+         * @brief prefetchRows rows per round trip connection has been opened with (see FetchTuning)
+         */
+        int prefetchRows() const { return m_prefetchRows; }
+        void setPrefetchRows( const int rows ) { m_prefetchRows = rows; }
+
+    private:
+        QString m_name;
+        int m_prefetchRows;
+    };
+
+    /**
+     * @brief m_connections connections of pool threads (must outlive threads of pools)
+     */
+    mutable QThreadStorage< Connection* > m_connections;
+    QThreadPool m_pool;
+    /**
+     * @brief m_filterPool single thread filter runs on
+     */
+    QThreadPool m_filterPool;
+    mutable QMutex m_mutex;
+    CancellationToken m_token;
+    /**
+     * @brief m_filterToken token of the last submitted filter
+     */
+    CancellationToken m_filterToken;
+};
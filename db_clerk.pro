@@ -4,9 +4,9 @@
 #
 #-------------------------------------------------
 
-QT       += core gui sql
+QT       += core gui sql network
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
 
 TARGET = db_clerk
 TEMPLATE = app
@@ -15,14 +15,67 @@ TEMPLATE = app
 SOURCES += main.cpp\
         mainwindow.cpp \
     logindialog.cpp \
-    fillrequestdialog.cpp
+    fillrequestdialog.cpp \
+    diagnosticsdialog.cpp \
+    queryprofiler.cpp \
+    fetchtuning.cpp \
+    resultexporter.cpp \
+    supplierimporter.cpp \
+    isbn.cpp \
+    inputmodel.cpp \
+    bundlemodel.cpp \
+    bundlebrowsermodel.cpp \
+    bundlepricing.cpp \
+    saleshistogram.cpp \
+    bookdetail.cpp \
+    readsnapshot.cpp \
+    storeinventory.cpp \
+    dataservice.cpp \
+    workflow.cpp \
+    historyrollup.cpp \
+    stringpool.cpp \
+    memorybudget.cpp \
+    sqldialect.cpp \
+    schema.cpp \
+    connectionsettings.cpp \
+    sessioncache.cpp \
+    resultcache.cpp \
+    passwordhasher.cpp \
+    sessiontoken.cpp
 
 HEADERS  += mainwindow.h \
     logindialog.h \
-    fillrequestdialog.h
+    fillrequestdialog.h \
+    diagnosticsdialog.h \
+    queryprofiler.h \
+    fetchtuning.h \
+    resultexporter.h \
+    supplierimporter.h \
+    isbn.h \
+    inputmodel.h \
+    bundlemodel.h \
+    bundlebrowsermodel.h \
+    bundlepricing.h \
+    saleshistogram.h \
+    bookdetail.h \
+    readsnapshot.h \
+    storeinventory.h \
+    dataservice.h \
+    workflow.h \
+    historyrollup.h \
+    stringpool.h \
+    memorybudget.h \
+    sqldialect.h \
+    schema.h \
+    connectionsettings.h \
+    sessioncache.h \
+    resultcache.h \
+    passwordhasher.h \
+    sessiontoken.h
 
 FORMS    += mainwindow.ui \
     logindialog.ui \
-    fillrequestdialog.ui
+    fillrequestdialog.ui \
+    diagnosticsdialog.ui
 
 OTHER_FILES +=
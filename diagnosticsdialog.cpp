@@ -0,0 +1,107 @@
+#include "diagnosticsdialog.h"
+#include "ui_diagnosticsdialog.h"
+#include "fetchtuning.h"
+#include "memorybudget.h"
+#include "stringpool.h"
+
+DiagnosticsDialog::DiagnosticsDialog(QWidget * const parent)
+  : QDialog(parent)
+  , ui(new Ui::DiagnosticsDialog)
+{
+    ui->setupUi(this);
+    ui->fetchTuningTree->setHeaderLabels( QStringList() << tr("Statement") << tr("Driver") << tr("Prefetch Rows")
+                                          << tr("Prefetch Memory") << tr("Runs") << tr("Last Rows")
+                                          << tr("Avg Rows") << tr("Avg ms") << tr("Round Trips") );
+
+    connect( ui->refreshButton, SIGNAL(clicked()), this, SLOT(refresh()) );
+    connect( ui->clearButton, SIGNAL(clicked()), this, SLOT(clearEntries()) );
+    connect( ui->slowQueriesList, SIGNAL(currentRowChanged(int)), this, SLOT(entrySelected(int)) );
+}
+
+DiagnosticsDialog::~DiagnosticsDialog()
+{
+    delete ui;
+}
+
+void DiagnosticsDialog::refresh()
+{
+    m_entries = QueryProfiler::entries();
+
+    ui->thresholdLabel->setText( tr("Plans are captured for statements slower than %1 ms.")
+                                 .arg( QueryProfiler::thresholdMs() ) );
+
+    ui->slowQueriesList->clear();
+    for (int i( 0 ); m_entries.size() != i; ++i)
+    {
+        const QueryProfiler::Entry& entry = m_entries.at( i );
+        ui->slowQueriesList->addItem( tr("%1  %2 ms  %3")
+                                      .arg( entry.executedAt.toString( "hh:mm:ss" ) )
+                                      .arg( entry.elapsedMs )
+                                      .arg( entry.statement.simplified().left( 60 ) ) );
+    }
+
+    if (m_entries.isEmpty())
+        ui->planView->clear();
+    else
+        ui->slowQueriesList->setCurrentRow( 0 );
+
+    refreshFetchTuning();
+
+    const MemoryBudget::Heap heap = MemoryBudget::heap();
+    const double MiB = 1024.0 * 1024.0;
+    ui->heapLabel->setText( heap.available
+                            ? tr("Heap: %1 MiB in use (%2 MiB mapped), %3 MiB free. Interned strings: %4.")
+                              .arg( heap.inUseBytes / MiB, 0, 'f', 1 )
+                              .arg( heap.mappedBytes / MiB, 0, 'f', 1 )
+                              .arg( heap.freeBytes / MiB, 0, 'f', 1 )
+                              .arg( StringPool::size() )
+                            : tr("Heap usage is not available. Interned strings: %1.").arg( StringPool::size() ) );
+}
+
+void DiagnosticsDialog::refreshFetchTuning()
+{
+    const QList< FetchTuning::Metrics > metrics = FetchTuning::metrics();
+
+    ui->fetchTuningTree->clear();
+    for (int i( 0 ); metrics.size() != i; ++i)
+    {
+        const FetchTuning::Metrics& m = metrics.at( i );
+        QTreeWidgetItem * const item = new QTreeWidgetItem( ui->fetchTuningTree );
+        item->setText( 0, m.statement );
+        item->setText( 1, m.driver );
+        // drivers without prefetch knob fetch whole result at once
+        item->setText( 2, (0 == m.prefetchRows) ? tr("whole result")
+                                                : tr("%1 (%2)").arg( m.prefetchRows )
+                                                  .arg( m.adaptive ? tr("adaptive") : tr("fixed") ) );
+        item->setText( 3, (0 == m.prefetchMemory) ? tr("unlimited") : QString::number( m.prefetchMemory ) );
+        item->setText( 4, QString::number( m.executions ) );
+        item->setText( 5, QString::number( m.lastRows ) );
+        item->setText( 6, QString::number( m.averageRows, 'f', 0 ) );
+        item->setText( 7, QString::number( m.averageMs, 'f', 1 ) );
+        item->setText( 8, QString::number( m.roundTrips ) );
+    }
+}
+
+void DiagnosticsDialog::clearEntries()
+{
+    QueryProfiler::clear();
+    refresh();
+}
+
+void DiagnosticsDialog::entrySelected(const int row)
+{
+    if (0 > row || m_entries.size() <= row)
+    {
+        ui->planView->clear();
+        return;
+    }
+
+    const QueryProfiler::Entry& entry = m_entries.at( row );
+    ui->planView->setPlainText( tr("Executed: %1\nConnection: %2\nElapsed: %3 ms\n\n%4\n\nBound values:\n%5\n\nPlan:\n%6")
+                                .arg( entry.executedAt.toString( Qt::ISODate ) )
+                                .arg( entry.connectionName )
+                                .arg( entry.elapsedMs )
+                                .arg( entry.statement )
+                                .arg( entry.boundValues.join( "\n" ) )
+                                .arg( entry.plan ) );
+}
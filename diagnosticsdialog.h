@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QDialog>
+#include <QList>
+
+#include "queryprofiler.h"
+
+namespace Ui {
+class DiagnosticsDialog;
+}
+
+/**
+ * @brief The DiagnosticsDialog class shows slow statements captured by QueryProfiler with their plans
+ * and effective fetch sizes chosen by FetchTuning, along with heap usage
+ */
+class DiagnosticsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DiagnosticsDialog(QWidget * const parent = NULL);
+    ~DiagnosticsDialog();
+
+public slots:
+    /**
+     * @brief refresh re-reads captured statements
+     */
+    void refresh();
+
+private slots:
+    void clearEntries();
+    void entrySelected( const int row );
+
+private:
+    /**
+     * @brief refreshFetchTuning re-reads effective prefetch values of statements
+     */
+    void refreshFetchTuning();
+
+    Ui::DiagnosticsDialog * const ui;
+    QList< QueryProfiler::Entry > m_entries;
+};
@@ -0,0 +1,146 @@
+#include "fetchtuning.h"
+#include <QSqlDatabase>
+#include <QSettings>
+#include <QStringList>
+#include <QDebug>
+#include <cmath>
+
+namespace
+{
+/**
+ * @brief Smoothing weight of the latest observation in running averages
+ */
+const double Smoothing = 0.3;
+
+/**
+ * @brief withOption replaces (or adds) option in semicolon separated connect options
+ */
+QString withOption( const QString& connectOptions, const QString& name, const int value )
+{
+    QStringList options = connectOptions.split( ";", Qt::SkipEmptyParts );
+    for (int i( options.size() - 1 ); 0 <= i; --i)
+        if (options.at( i ).trimmed().startsWith( name + "=" ))
+            options.removeAt( i );
+
+    options << QString( "%1=%2" ).arg( name ).arg( value );
+    return options.join( ";" );
+}
+}
+
+FetchTuning::FetchTuning()
+{
+    const QSettings settings( "settings.ini", QSettings::IniFormat );
+    m_fixedRows         = qMax( 0, settings.value( "fetch/prefetchRows", 0 ).toInt() );
+    m_prefetchMemory    = qMax( 0, settings.value( "fetch/prefetchMemory", 0 ).toInt() );
+    m_minRows           = qMax( 1, settings.value( "fetch/minRows", 100 ).toInt() );
+    m_maxRows           = qMax( m_minRows, settings.value( "fetch/maxRows", 10000 ).toInt() );
+    m_defaultRoundTrips = qMax( 1, settings.value( "fetch/targetRoundTrips", 8 ).toInt() );
+    m_roundTripBudgetMs = qMax( 1, settings.value( "fetch/roundTripBudgetMs", 20 ).toInt() );
+}
+
+FetchTuning& FetchTuning::instance()
+{
+    static FetchTuning tuning;
+    return tuning;
+}
+
+int FetchTuning::prefetchRowsFor(const Metrics &metrics) const
+{
+    if (0 != m_fixedRows)
+        return m_fixedRows;
+    if (0 == metrics.executions)
+        return m_minRows;
+
+    const int trips = m_targetRoundTrips.value( metrics.statement, m_defaultRoundTrips );
+    const double wanted = std::ceil( metrics.averageRows / trips );
+
+    // round up to power of two, so small changes of result size don't change options
+    int rows = m_minRows;
+    while (rows < wanted && rows < m_maxRows)
+        rows *= 2;
+    return qMin( rows, m_maxRows );
+}
+
+int FetchTuning::apply(QSqlDatabase &db, const QString &statement)
+{
+    FetchTuning& tuning = instance();
+    QMutexLocker locker( &tuning.m_mutex );
+
+    Metrics& metrics = tuning.m_metrics[ statement ];
+    if (metrics.statement.isEmpty())
+    {
+        metrics.statement   = statement;
+        metrics.executions  = 0;
+        metrics.lastRows    = 0;
+        metrics.averageRows = 0.0;
+        metrics.averageMs   = 0.0;
+        metrics.roundTrips  = 0;
+    }
+    metrics.driver   = db.driverName();
+    metrics.adaptive = 0 == tuning.m_fixedRows;
+
+    if (!metrics.driver.startsWith( "QOCI" ))
+    {
+        metrics.prefetchRows   = 0;
+        metrics.prefetchMemory = 0;
+        return 0;
+    }
+
+    metrics.prefetchRows   = tuning.prefetchRowsFor( metrics );
+    metrics.prefetchMemory = tuning.m_prefetchMemory;
+
+    QString options = withOption( db.connectOptions(), "OCI_ATTR_PREFETCH_ROWS", metrics.prefetchRows );
+    options = withOption( options, "OCI_ATTR_PREFETCH_MEMORY", metrics.prefetchMemory );
+    db.setConnectOptions( options );
+    qDebug() << "Fetch tuning: " << statement << options;
+    return metrics.prefetchRows;
+}
+
+int FetchTuning::prefetchRows(const QString &driver, const QString &statement)
+{
+    if (!driver.startsWith( "QOCI" ))
+        return 0;
+
+    FetchTuning& tuning = instance();
+    QMutexLocker locker( &tuning.m_mutex );
+
+    const QHash< QString, Metrics >::const_iterator it = tuning.m_metrics.constFind( statement );
+    if (tuning.m_metrics.constEnd() == it)
+        return (0 != tuning.m_fixedRows) ? tuning.m_fixedRows : tuning.m_minRows;
+
+    return tuning.prefetchRowsFor( it.value() );
+}
+
+void FetchTuning::record(const QString &statement, const qint64 rows, const qint64 elapsedMs)
+{
+    FetchTuning& tuning = instance();
+    QMutexLocker locker( &tuning.m_mutex );
+
+    if (!tuning.m_metrics.contains( statement ))
+        return;
+
+    Metrics& metrics = tuning.m_metrics[ statement ];
+    metrics.averageRows = (0 == metrics.executions) ? rows      : (1 - Smoothing) * metrics.averageRows + Smoothing * rows;
+    metrics.averageMs   = (0 == metrics.executions) ? elapsedMs : (1 - Smoothing) * metrics.averageMs + Smoothing * elapsedMs;
+    ++metrics.executions;
+    metrics.lastRows   = rows;
+    metrics.roundTrips = (0 == metrics.prefetchRows) ? 0 : 1 + rows / metrics.prefetchRows;
+
+    // round trips that are slower than budget are worth saving: aim at fewer of them next time
+    if (0 != metrics.roundTrips && elapsedMs / metrics.roundTrips > tuning.m_roundTripBudgetMs)
+    {
+        int& trips = tuning.m_targetRoundTrips[ statement ];
+        if (0 == trips)
+            trips = tuning.m_defaultRoundTrips;
+        trips = qMax( 1, trips / 2 );
+    }
+
+    qDebug() << "Fetched: " << statement << rows << "row(s) in" << elapsedMs << "ms," << metrics.roundTrips << "round trip(s)";
+}
+
+QList< FetchTuning::Metrics > FetchTuning::metrics()
+{
+    FetchTuning& tuning = instance();
+    QMutexLocker locker( &tuning.m_mutex );
+    return tuning.m_metrics.values();
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QMutex>
+
+class QSqlDatabase;
+
+/**
+ * @brief The FetchTuning class chooses how many rows driver fetches per network round trip for statements
+ * that return large results. Values are fixed in settings.ini ("fetch/prefetchRows", "fetch/prefetchMemory")
+ * or, when prefetchRows is 0, derived from row counts and latencies observed for the same statement.
+ * Only QOCI has such knobs (per connection, applied when it is opened, so connections that are kept open
+ * are reopened when their value changes, see prefetchRows); QPSQL and QSQLITE buffer
+ * or step through whole result themselves. May be used from any thread.
+ */
+class FetchTuning
+{
+public:
+    /**
+     * @brief The Metrics struct effective values and observations for one statement
+     */
+    struct Metrics
+    {
+        QString statement;
+        QString driver;
+        /**
+         * @brief prefetchRows rows fetched per round trip (0 if driver has no such knob)
+         */
+        int prefetchRows;
+        int prefetchMemory;
+        bool adaptive;
+        qint64 executions;
+        qint64 lastRows;
+        double averageRows;
+        double averageMs;
+        /**
+         * @brief roundTrips estimated round trips of the last execution
+         */
+        qint64 roundTrips;
+    };
+
+    /**
+     * @brief apply sets prefetch options of connection for statement that is about to run.
+     * Must be called before connection is opened
+     * @param statement name that identifies statement between runs
+     * @return rows fetched per round trip that have been set (0 if driver has no such knob)
+     */
+    static int apply( QSqlDatabase& db, const QString& statement );
+    /**
+     * @brief prefetchRows rows per round trip that apply() would set now. Connection that is kept open
+     * is re-tuned (closed, applied and opened again) when this differs from value it was opened with
+     */
+    static int prefetchRows( const QString& driver, const QString& statement );
+    /**
+     * @brief record remembers how many rows statement has returned and how long fetching took
+     */
+    static void record( const QString& statement, const qint64 rows, const qint64 elapsedMs );
+
+    static QList< Metrics > metrics();
+
+private:
+    FetchTuning();
+
+    static FetchTuning& instance();
+
+    int prefetchRowsFor( const Metrics& metrics ) const;
+
+    mutable QMutex m_mutex;
+    QHash< QString, Metrics > m_metrics;
+    QHash< QString, int > m_targetRoundTrips;
+    int m_fixedRows;
+    int m_prefetchMemory;
+    int m_minRows;
+    int m_maxRows;
+    int m_defaultRoundTrips;
+    qint64 m_roundTripBudgetMs;
+};
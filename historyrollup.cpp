@@ -0,0 +1,356 @@
+#include "historyrollup.h"
+#include "sqldialect.h"
+#include "schema.h"
+#include "queryprofiler.h"
+#include "connectionsettings.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSettings>
+#include <QStringList>
+#include <QTextStream>
+#include <QDebug>
+
+namespace
+{
+QDate firstOfMonth( const QDate& date )
+{
+    return QDate( date.year(), date.month(), 1 );
+}
+
+Workflow::Outcome failure( const QString& step, const QString& error )
+{
+    qDebug() << "Step failed: " << step << error;
+    Workflow::Outcome outcome;
+    outcome.ok         = false;
+    outcome.failedStep = step;
+    outcome.error      = error;
+
+    return outcome;
+}
+
+/**
+ * @brief execRange runs statement that binds :from and :to (dates) as step of workflow
+ */
+bool execRange( QSqlDatabase db, const QString& statement, const QDate& from, const QDate& to, Workflow& workflow
+              , int& affected )
+{
+    QSqlQuery rangeQuery( db );
+    qDebug() << "Prepare: " <<
+                rangeQuery.prepare( statement );
+    // plain dates: compare right with timestamps of every backend (SQLite included)
+    rangeQuery.bindValue( ":from", from );
+    rangeQuery.bindValue( ":to", to );
+
+    const bool execResult = QueryProfiler::exec( rangeQuery, db.connectionName() );
+    qDebug() << "Exec: " << execResult;
+    if (!execResult)
+    {
+        workflow.fail( rangeQuery.lastError().text() );
+        return false;
+    }
+
+    affected = rangeQuery.numRowsAffected();
+    qDebug() << "Affected: " << affected;
+    return true;
+}
+
+/**
+ * @brief execMonth runs statement that binds :month as step of workflow
+ */
+bool execMonth( QSqlDatabase db, const QString& statement, const QDate& month, Workflow& workflow )
+{
+    QSqlQuery monthQuery( db );
+    qDebug() << "Prepare: " <<
+                monthQuery.prepare( statement );
+    monthQuery.bindValue( ":month", month );
+
+    const bool execResult = QueryProfiler::exec( monthQuery, db.connectionName() );
+    qDebug() << "Exec: " << execResult;
+    if (!execResult)
+        workflow.fail( monthQuery.lastError().text() );
+    return execResult;
+}
+
+/**
+ * @brief findOldest finds date of the oldest purchase in [from, to) (from may be null)
+ * @param oldest [out] null if there is no such purchase
+ */
+bool findOldest( QSqlDatabase db, const QDate& from, const QDate& to, QDate& oldest, QString& error )
+{
+    QSqlQuery oldestQuery( db );
+    oldestQuery.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                oldestQuery.prepare( QString( "SELECT MIN(purchasing_date) FROM history_of_purchasing "
+                                              "WHERE %1purchasing_date < :to" )
+                                     .arg( from.isValid() ? "purchasing_date >= :from AND " : "" ) );
+    if (from.isValid())
+        oldestQuery.bindValue( ":from", from );
+    oldestQuery.bindValue( ":to", to );
+
+    const bool execResult = QueryProfiler::exec( oldestQuery, db.connectionName() );
+    qDebug() << "Exec: " << execResult;
+    if (!execResult)
+    {
+        error = oldestQuery.lastError().text();
+        return false;
+    }
+
+    oldest = QDate();
+    if (oldestQuery.next() && !oldestQuery.isNull( 0 ))
+    {
+        // SQLite keeps timestamps as text
+        const QVariant value = oldestQuery.value( 0 );
+        oldest = (QVariant::String == value.type()) ? QDate::fromString( value.toString().left( 10 ), Qt::ISODate )
+                                                    : value.toDate();
+    }
+    return true;
+}
+
+bool execDdl( QSqlDatabase db, const QStringList& statements, QString& error )
+{
+    for (int i( 0 ); statements.size() != i; ++i)
+    {
+        QSqlQuery ddlQuery( db );
+        const bool execResult = ddlQuery.exec( statements.at( i ) );
+        qDebug() << "Exec: " << execResult << statements.at( i );
+        if (!execResult)
+        {
+            error = ddlQuery.lastError().text();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief rollupRange rolls up and deletes purchases from [from, to) in one transaction
+ */
+void rollupRange( QSqlDatabase db, const QDate& from, const QDate& to, const CancellationToken& token
+                , HistoryRollup::Result& result )
+{
+    const QString month = from.toString( "yyyy-MM" );
+    Workflow workflow( db, token );
+
+    int days = 0;
+    int purged = 0;
+    if (workflow.step( "roll up " + month ))
+        workflow.check( execRange( db, SqlDialect::forDriver( db.driverName() ).rollupStatement(), from, to
+                                 , workflow, days ) );
+    if (workflow.step( "delete " + month ))
+        workflow.check( execRange( db, "DELETE FROM history_of_purchasing "
+                                       "WHERE purchasing_date >= :from AND purchasing_date < :to", from, to
+                                 , workflow, purged ) );
+
+    result.outcome = workflow.commit();
+    if (result.outcome.ok)
+        result.purged += purged;
+}
+
+/**
+ * @brief dropPartition drops partition of month that has been rolled up and forgets the month
+ */
+void dropPartition( QSqlDatabase db, const QDate& month, const CancellationToken& token
+                  , HistoryRollup::Result& result )
+{
+    const QString name = month.toString( "yyyy-MM" );
+
+    // partition may have been dropped by run that didn't get to forget the month
+    QDate oldest;
+    QString error;
+    if (!findOldest( db, month, month.addMonths( 1 ), oldest, error ))
+    {
+        result.outcome = failure( "find purchases of " + name, error );
+        return;
+    }
+    if (oldest.isValid())
+    {
+        if (!execDdl( db, QStringList() << SqlDialect::forDriver( db.driverName() ).dropHistoryPartitionStatement( month )
+                    , error ))
+        {
+            result.outcome = failure( "drop partition " + name, error );
+            return;
+        }
+        ++result.droppedMonths;
+    }
+
+    Workflow workflow( db, token );
+    if (workflow.step( "forget " + name ))
+        workflow.check( execMonth( db, "DELETE FROM history_rollup WHERE month = :month", month, workflow ) );
+    result.outcome = workflow.commit();
+}
+
+/**
+ * @brief rollupPartition rolls up whole month of partitioned history and drops its partition.
+ * Month is remembered in history_rollup in the same transaction that rolls it up, so it isn't rolled up
+ * again if partition can't be dropped (DDL commits implicitly on Oracle)
+ */
+void rollupPartition( QSqlDatabase db, const QDate& month, const CancellationToken& token
+                    , HistoryRollup::Result& result )
+{
+    const SqlDialect& dialect = SqlDialect::forDriver( db.driverName() );
+    const QString name = month.toString( "yyyy-MM" );
+
+    // rows of month may wait in default partition
+    QString error;
+    if (!execDdl( db, dialect.historyPartitionStatements( month ), error ))
+    {
+        result.outcome = failure( "create partition " + name, error );
+        return;
+    }
+
+    {
+        Workflow workflow( db, token );
+        int days = 0;
+        if (workflow.step( "roll up " + name ))
+            workflow.check( execRange( db, dialect.rollupStatement(), month, month.addMonths( 1 ), workflow, days ) );
+        if (workflow.step( "remember " + name ))
+            workflow.check( execMonth( db, "INSERT INTO history_rollup (month) VALUES (:month)", month, workflow ) );
+        result.outcome = workflow.commit();
+    }
+
+    if (result.outcome.ok)
+        dropPartition( db, month, token, result );
+}
+}
+
+HistoryRollup::Result::Result()
+    : purged( 0 )
+    , droppedMonths( 0 )
+{
+}
+
+uint HistoryRollup::keepDays()
+{
+    const QSettings settings( "settings.ini", QSettings::IniFormat );
+    return qMax( 1u, settings.value( "rollup/keepDays", 31 ).toUInt() );
+}
+
+bool HistoryRollup::isPartitioned(QSqlDatabase db)
+{
+    const QString partitionedQuery = SqlDialect::forDriver( db.driverName() ).historyPartitionedQuery();
+    if (partitionedQuery.isEmpty())
+        return false;
+
+    QSqlQuery catalogQuery( db );
+    catalogQuery.setForwardOnly( true );
+    const bool execResult = catalogQuery.exec( partitionedQuery );
+    qDebug() << "Exec: " << execResult;
+    if (!execResult)
+        qDebug() << catalogQuery.lastError();
+
+    return execResult && catalogQuery.next() && 0 < catalogQuery.value( 0 ).toInt();
+}
+
+HistoryRollup::Result HistoryRollup::run(QSqlDatabase db, const QDate &cutoff, const CancellationToken &token)
+{
+    qDebug() << "Cutoff: " << cutoff;
+    Result result;
+
+    // months that previous run has rolled up, but hasn't dropped
+    QList< QDate > remembered;
+    {
+        QSqlQuery rememberedQuery( db );
+        rememberedQuery.setForwardOnly( true );
+        if (!rememberedQuery.exec( "SELECT month FROM history_rollup ORDER BY month" ))
+        {
+            result.outcome = failure( "find rolled up months", rememberedQuery.lastError().text() );
+            return result;
+        }
+        while (rememberedQuery.next())
+        {
+            const QVariant value = rememberedQuery.value( 0 );
+            remembered << ((QVariant::String == value.type()) ? QDate::fromString( value.toString(), Qt::ISODate )
+                                                              : value.toDate());
+        }
+    }
+    for (int i( 0 ); remembered.size() != i && result.outcome.ok; ++i)
+        dropPartition( db, remembered.at( i ), token, result );
+
+    const SqlDialect& dialect = SqlDialect::forDriver( db.driverName() );
+    const bool partitioned = isPartitioned( db );
+    QDate from;
+    while (result.outcome.ok)
+    {
+        QDate oldest;
+        QString error;
+        if (!findOldest( db, from, cutoff, oldest, error ))
+        {
+            result.outcome = failure( "find oldest purchase", error );
+            break;
+        }
+        if (!oldest.isValid())
+            break;
+
+        const QDate month = firstOfMonth( oldest );
+        from = month.addMonths( 1 );
+        if (partitioned && from <= cutoff && !dialect.dropHistoryPartitionStatement( month ).isEmpty())
+            rollupPartition( db, month, token, result );
+        else
+            rollupRange( db, month, qMin( from, cutoff ), token, result );
+    }
+
+    qDebug() << "Purged: " << result.purged << "Dropped months: " << result.droppedMonths;
+    return result;
+}
+
+void HistoryRollup::maintainPartitions(QSqlDatabase db)
+{
+    const SqlDialect& dialect = SqlDialect::forDriver( db.driverName() );
+    const QDate today = QDate::currentDate();
+
+    QString error;
+    if (!execDdl( db, dialect.historyPartitionStatements( today ) + dialect.historyPartitionStatements( today.addMonths( 1 ) )
+                , error ))
+        qDebug() << "Partitions are not created: " << error;
+}
+
+int HistoryRollup::exec()
+{
+    QTextStream output( stdout );
+
+    const QString connectionName( "rollup" );
+    int exitCode = 0;
+    {
+        QSettings settings( "settings.ini", QSettings::IniFormat );
+        QSqlDatabase db = ConnectionSettings::read( settings, "database" ).addDatabase( connectionName );
+        if (!db.open())
+        {
+            output << "Cannot connect to database: " << db.lastError().text() << Qt::endl;
+            exitCode = 2;
+        }
+        else if (!Schema::upgrade( Schema::findUpgrades( db ), db ))
+        {
+            output << "Cannot upgrade database: " << db.lastError().text() << Qt::endl;
+            exitCode = 2;
+        }
+        else
+        {
+            const bool partitioned = isPartitioned( db );
+            if (partitioned)
+                maintainPartitions( db );
+            else if (Schema::partitionsHistory())
+                output << "history/partitioned is set, but history_of_purchasing is not partitioned: "
+                          "old purchases are deleted row by row. Recreate the table partitioned to drop whole months."
+                       << Qt::endl;
+
+            const QDate cutoff = QDate::currentDate().addDays( -static_cast< int >( keepDays() ) );
+            const Result result = run( db, cutoff );
+            if (result.outcome.ok)
+                output << "Rolled up purchases before " << cutoff.toString( Qt::ISODate ) << ": "
+                       << result.purged << " row(s) deleted, " << result.droppedMonths << " month(s) dropped"
+                       << Qt::endl;
+            else
+            {
+                output << "Rollup has failed at " << result.outcome.failedStep << ": " << result.outcome.error
+                       << Qt::endl;
+                exitCode = 1;
+            }
+
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase( connectionName );
+
+    return exitCode;
+}
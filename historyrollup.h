@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QDate>
+#include <QSqlDatabase>
+
+#include "workflow.h"
+
+/**
+ * @brief The HistoryRollup class is maintenance job that keeps history_of_purchasing short: rows older
+ * than keepDays() are rolled up into daily_sales (one row per book and day) and purged, month by month,
+ * every month in its own transaction. When history is partitioned (by month, as Schema creates it), whole
+ * months are purged by dropping their partitions; only part of month before cutoff is deleted row by row.
+ * Job runs headless (db_clerk --rollup), so it may be scheduled.
+ */
+class HistoryRollup
+{
+public:
+    /**
+     * @brief The Result struct how rollup has ended
+     */
+    struct Result
+    {
+        Workflow::Outcome outcome;
+        /**
+         * @brief purged number of rows of history that were deleted row by row
+         */
+        int purged;
+        /**
+         * @brief droppedMonths number of partitions of history that were dropped
+         */
+        int droppedMonths;
+
+        Result();
+    };
+
+    /**
+     * @brief keepDays how many days of history are kept as raw rows. Read from settings (rollup/keepDays)
+     */
+    static uint keepDays();
+    /**
+     * @brief isPartitioned whether history_of_purchasing is partitioned in database
+     */
+    static bool isPartitioned( QSqlDatabase db );
+
+    /**
+     * @brief run rolls up and purges rows older than cutoff. Connection must be opened
+     */
+    static Result run( QSqlDatabase db, const QDate& cutoff, const CancellationToken& token = CancellationToken() );
+    /**
+     * @brief maintainPartitions creates partitions of history for current and next month (where backend
+     * doesn't create them itself). Failures are logged and skipped
+     */
+    static void maintainPartitions( QSqlDatabase db );
+
+    /**
+     * @brief exec runs rollup over connection from settings
+     * @return exit code of process
+     */
+    static int exec();
+};
@@ -0,0 +1,323 @@
+#include "inputmodel.h"
+#include "isbn.h"
+#include <QDebug>
+#include <QElapsedTimer>
+
+namespace
+{
+/**
+ * @brief radixSort stable LSD radix sort of permutation by unsigned keys, byte by byte.
+ * Passes in which all keys share the same byte are skipped.
+ */
+template< typename Key >
+void radixSort( QVector< int >& order, const QVector< Key >& keys, const bool descending )
+{
+    const int size = order.size();
+    QVector< int > buffer( size );
+    const Key mask = descending ? ~Key( 0 ) : Key( 0 );
+
+    for (uint shift( 0 ); 8 * sizeof( Key ) != shift; shift += 8)
+    {
+        int counts[ 256 ] = { 0 };
+        for (int i( 0 ); size != i; ++i)
+            ++counts[ ((keys.at( order.at( i ) ) ^ mask) >> shift) & 0xFF ];
+
+        if (size == counts[ ((keys.at( order.at( 0 ) ) ^ mask) >> shift) & 0xFF ])
+            continue;
+
+        int offset = 0;
+        for (int digit( 0 ); 256 != digit; ++digit)
+        {
+            const int count = counts[ digit ];
+            counts[ digit ] = offset;
+            offset += count;
+        }
+
+        for (int i( 0 ); size != i; ++i)
+        {
+            const int row = order.at( i );
+            buffer[ counts[ ((keys.at( row ) ^ mask) >> shift) & 0xFF ]++ ] = row;
+        }
+        order.swap( buffer );
+    }
+}
+
+template< typename T >
+void permute( QVector< T >& values, const QVector< int >& order )
+{
+    QVector< T > result;
+    result.reserve( values.size() );
+    for (int i( 0 ); order.size() != i; ++i)
+        result << values.at( order.at( i ) );
+    values.swap( result );
+}
+}
+
+InputModel::InputModel(QObject * const parent)
+    : QAbstractTableModel( parent )
+{
+}
+
+void InputModel::setRows(const QVector<QString> &isbns, const QVector<uint> &sold, const QVector<uint> &quantities
+                        , const QVector< QVector< uint > >& storeStock)
+{
+    Q_ASSERT( isbns.size() == sold.size() && isbns.size() == quantities.size() );
+
+    beginResetModel();
+
+    m_isbns      = isbns;
+    m_sold       = sold;
+    m_quantities = quantities;
+    m_storeStock = storeStock;
+
+    computeKeys();
+
+    endResetModel();
+}
+
+void InputModel::setStoreNames(const QStringList &storeNames)
+{
+    if (storeNames == m_storeNames)
+        return;
+
+    beginResetModel();
+    m_storeNames = storeNames;
+    m_storeStock.clear();
+    endResetModel();
+}
+
+void InputModel::computeKeys()
+{
+    m_isbnKeys.clear();
+    m_isbnKeys.reserve( m_isbns.size() );
+    for (int i( 0 ); m_isbns.size() != i; ++i)
+        m_isbnKeys << Isbn::numericKey( m_isbns.at( i ) );
+
+    for (int i( 0 ); m_sortHistory.size() != i; ++i)
+        sortRows( m_sortHistory.at( i ).first, m_sortHistory.at( i ).second );
+}
+
+void InputModel::clear()
+{
+    beginResetModel();
+    m_isbns.clear();
+    m_sold.clear();
+    m_quantities.clear();
+    m_isbnKeys.clear();
+    m_storeStock.clear();
+    m_queuedRequests.clear();
+    endResetModel();
+
+    emit queuedRequestsChanged( 0 );
+}
+
+void InputModel::dequeueRequests(const QStringList &isbns)
+{
+    for (int i( 0 ); isbns.size() != i; ++i)
+    {
+        if (0 == m_queuedRequests.remove( isbns.at( i ) ))
+            continue;
+
+        const int row = rowOf( isbns.at( i ) );
+        if (-1 != row)
+            emit dataChanged( index( row, RequestColumn ), index( row, RequestColumn ) );
+    }
+
+    emit queuedRequestsChanged( m_queuedRequests.size() );
+}
+
+int InputModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_isbns.size();
+}
+
+int InputModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount + m_storeNames.size();
+}
+
+QVariant InputModel::data(const QModelIndex &index, const int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+
+    if (RequestColumn == index.column())
+    {
+        const QHash< QString, uint >::const_iterator it = m_queuedRequests.constFind( m_isbns.at( index.row() ) );
+        switch (role)
+        {
+        case Qt::DisplayRole:
+            return (m_queuedRequests.constEnd() == it) ? QVariant() : QVariant( it.value() );
+        case Qt::EditRole:
+            return (m_queuedRequests.constEnd() == it) ? 0u : it.value();
+        default:
+            return QVariant();
+        }
+    }
+
+    if (Qt::DisplayRole != role)
+        return QVariant();
+
+    switch (index.column())
+    {
+    case IsbnColumn:
+        return m_isbns.at( index.row() );
+    case SoldColumn:
+        return m_sold.at( index.row() );
+    case QuantityColumn:
+        return m_quantities.at( index.row() );
+    default:
+        {
+            const int store = index.column() - ColumnCount;
+            if (0 > store || m_storeStock.size() <= store)
+                return QVariant();
+            return m_storeStock.at( store ).at( index.row() );
+        }
+    }
+}
+
+QVariant InputModel::headerData(const int section, const Qt::Orientation orientation, const int role) const
+{
+    if (Qt::Horizontal != orientation || Qt::DisplayRole != role)
+        return QAbstractTableModel::headerData( section, orientation, role );
+
+    switch (section)
+    {
+    case IsbnColumn:
+        return tr("ISBN");
+    case SoldColumn:
+        return tr("Sold");
+    case QuantityColumn:
+        return tr("Quantity");
+    case RequestColumn:
+        return tr("Request");
+    default:
+        return m_storeNames.value( section - ColumnCount );
+    }
+}
+
+Qt::ItemFlags InputModel::flags(const QModelIndex &index) const
+{
+    if (index.isValid() && RequestColumn == index.column())
+        return QAbstractTableModel::flags( index ) | Qt::ItemIsEditable;
+
+    return QAbstractTableModel::flags( index );
+}
+
+bool InputModel::setData(const QModelIndex &index, const QVariant &value, const int role)
+{
+    if (!index.isValid() || RequestColumn != index.column() || Qt::EditRole != role)
+        return false;
+
+    bool ok = false;
+    const uint quantity = value.toUInt( &ok );
+    if (!ok)
+        return false;
+
+    // zero takes book out of queue
+    if (0 == quantity)
+        m_queuedRequests.remove( m_isbns.at( index.row() ) );
+    else
+        m_queuedRequests.insert( m_isbns.at( index.row() ), quantity );
+
+    emit dataChanged( index, index );
+    emit queuedRequestsChanged( m_queuedRequests.size() );
+    return true;
+}
+
+void InputModel::sort(const int column, const Qt::SortOrder order)
+{
+    if (0 > column || columnCount() <= column)
+        return;
+
+    for (int i( 0 ); m_sortHistory.size() != i; ++i)
+        if (column == m_sortHistory.at( i ).first)
+        {
+            m_sortHistory.removeAt( i );
+            break;
+        }
+    m_sortHistory << qMakePair( column, order );
+
+    emit layoutAboutToBeChanged();
+
+    const QModelIndexList oldPersistent = persistentIndexList();
+    QVector< int > oldRows;
+    oldRows.reserve( oldPersistent.size() );
+    for (int i( 0 ); oldPersistent.size() != i; ++i)
+        oldRows << oldPersistent.at( i ).row();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector< int > permutation( m_isbns.size() );
+    for (int i( 0 ); permutation.size() != i; ++i)
+        permutation[ i ] = i;
+    sortRows( column, order, permutation );
+
+    qDebug() << "Sorted" << m_isbns.size() << "rows in" << timer.elapsed() << "ms";
+
+    QVector< int > newRows( permutation.size() );
+    for (int i( 0 ); permutation.size() != i; ++i)
+        newRows[ permutation.at( i ) ] = i;
+
+    QModelIndexList newPersistent;
+    newPersistent.reserve( oldPersistent.size() );
+    for (int i( 0 ); oldPersistent.size() != i; ++i)
+        newPersistent << index( newRows.at( oldRows.at( i ) ), oldPersistent.at( i ).column() );
+    changePersistentIndexList( oldPersistent, newPersistent );
+
+    emit layoutChanged();
+}
+
+void InputModel::sortRows(const int column, const Qt::SortOrder order)
+{
+    QVector< int > permutation( m_isbns.size() );
+    for (int i( 0 ); permutation.size() != i; ++i)
+        permutation[ i ] = i;
+    sortRows( column, order, permutation );
+}
+
+void InputModel::sortRows(const int column, const Qt::SortOrder order, QVector< int >& permutation)
+{
+    if (permutation.isEmpty())
+        return;
+
+    const bool descending = Qt::DescendingOrder == order;
+    switch (column)
+    {
+    case IsbnColumn:
+        radixSort( permutation, m_isbnKeys, descending );
+        break;
+    case SoldColumn:
+        radixSort( permutation, m_sold, descending );
+        break;
+    case QuantityColumn:
+        radixSort( permutation, m_quantities, descending );
+        break;
+    case RequestColumn:
+        {
+            QVector< uint > requests;
+            requests.reserve( m_isbns.size() );
+            for (int i( 0 ); m_isbns.size() != i; ++i)
+                requests << m_queuedRequests.value( m_isbns.at( i ), 0 );
+            radixSort( permutation, requests, descending );
+        }
+        break;
+    default:
+        if (0 > column - ColumnCount || m_storeStock.size() <= column - ColumnCount)
+            return;
+        radixSort( permutation, m_storeStock.at( column - ColumnCount ), descending );
+    }
+
+    applyOrder( permutation );
+}
+
+void InputModel::applyOrder(const QVector<int> &order)
+{
+    permute( m_isbns, order );
+    permute( m_sold, order );
+    permute( m_quantities, order );
+    permute( m_isbnKeys, order );
+    for (int i( 0 ); m_storeStock.size() != i; ++i)
+        permute( m_storeStock[ i ], order );
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include <QString>
+#include <QList>
+#include <QPair>
+#include <QStringList>
+#include <QHash>
+
+/**
+ * @brief The InputModel class holds result of filter (ISBN, sold, quantity) in typed
+ * contiguous columns. Stock of other stores of chain (if any) is shown in additional columns
+ * after RequestColumn.
+ * RequestColumn is editable: entered quantities are queued (by ISBN) until they are submitted.
+ */
+class InputModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column
+    {
+        IsbnColumn = 0,
+        SoldColumn,
+        QuantityColumn,
+        RequestColumn,
+        ColumnCount
+    };
+
+    explicit InputModel(QObject * const parent = NULL);
+
+    /**
+     * @brief setRows replaces content of model with given columns (all of them must have same size)
+     * @param storeStock stock in other stores: storeStock[ store ][ row ]
+     */
+    void setRows( const QVector< QString >& isbns, const QVector< uint >& sold, const QVector< uint >& quantities
+                , const QVector< QVector< uint > >& storeStock = QVector< QVector< uint > >() );
+    /**
+     * @brief setStoreNames sets names of other stores (one column per store)
+     */
+    void setStoreNames( const QStringList& storeNames );
+    /**
+     * @brief clear removes all rows (and queued requests) from model
+     */
+    void clear();
+
+    const QString& isbn( const int row ) const { return m_isbns.at( row ); }
+    uint sold( const int row )           const { return m_sold.at( row );  }
+    uint quantity( const int row )       const { return m_quantities.at( row ); }
+    int storeCount()                     const { return m_storeNames.size(); }
+
+    const QVector< QString >& isbns()    const { return m_isbns;      }
+    const QVector< uint >& soldValues()  const { return m_sold;       }
+    const QVector< uint >& quantities()  const { return m_quantities; }
+
+    /**
+     * @brief queuedRequests quantities entered into RequestColumn that haven't been submitted yet
+     */
+    const QHash< QString, uint >& queuedRequests() const { return m_queuedRequests; }
+    /**
+     * @brief dequeueRequests removes submitted requests from queue
+     */
+    void dequeueRequests( const QStringList& isbns );
+
+    /**
+     * @brief rowOf row of book with given ISBN or -1 if there is no such book
+     */
+    int rowOf( const QString& isbn ) const { return m_isbns.indexOf( isbn ); }
+
+    int rowCount( const QModelIndex& parent = QModelIndex() ) const;
+    int columnCount( const QModelIndex& parent = QModelIndex() ) const;
+    QVariant data( const QModelIndex& index, const int role = Qt::DisplayRole ) const;
+    QVariant headerData( const int section, const Qt::Orientation orientation, const int role = Qt::DisplayRole ) const;
+    Qt::ItemFlags flags( const QModelIndex& index ) const;
+    bool setData( const QModelIndex& index, const QVariant& value, const int role = Qt::EditRole );
+
+    /**
+     * @brief sort stable in-memory sort by column. Rows that are equal by column keep the order
+     * of previous sort, so consecutive sorts form multi-column ordering. Sort history is replayed
+     * after every setRows.
+     */
+    void sort( const int column, const Qt::SortOrder order = Qt::AscendingOrder );
+
+signals:
+    /**
+     * @brief queuedRequestsChanged emitted whenever request is queued or dequeued
+     * @param count number of queued requests
+     */
+    void queuedRequestsChanged( const int count );
+
+private:
+    /**
+     * @brief sortRows sorts rows without remembering column in sort history
+     */
+    void sortRows( const int column, const Qt::SortOrder order );
+    /**
+     * @brief sortRows sorts rows and leaves resulting permutation (permutation[ newRow ] == oldRow)
+     */
+    void sortRows( const int column, const Qt::SortOrder order, QVector< int >& permutation );
+    /**
+     * @brief applyOrder physically reorders all columns according to permutation
+     * @param order order[ newRow ] == oldRow
+     */
+    void applyOrder( const QVector< int >& order );
+    /**
+     * @brief computeKeys precomputes sort keys and replays sort history
+     */
+    void computeKeys();
+
+    /**
+     * @brief m_isbns ISBN numbers of found books
+     */
+    QVector< QString > m_isbns;
+    /**
+     * @brief m_sold how many copies of book were sold during lookback window
+     */
+    QVector< uint > m_sold;
+    /**
+     * @brief m_quantities how many copies of book there are in stock
+     */
+    QVector< uint > m_quantities;
+    /**
+     * @brief m_isbnKeys precomputed sort keys for ISBNs (numeric value of ISBN-13)
+     */
+    QVector< quint64 > m_isbnKeys;
+    /**
+     * @brief m_storeNames names of other stores
+     */
+    QStringList m_storeNames;
+    /**
+     * @brief m_storeStock how many copies of book there are in other stores: m_storeStock[ store ][ row ]
+     */
+    QVector< QVector< uint > > m_storeStock;
+    /**
+     * @brief m_queuedRequests quantities entered for books (by ISBN), kept over refreshes and sorting
+     */
+    QHash< QString, uint > m_queuedRequests;
+    /**
+     * @brief m_sortHistory columns that were used for sorting (least significant first)
+     */
+    QList< QPair< int, Qt::SortOrder > > m_sortHistory;
+};
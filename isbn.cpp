@@ -0,0 +1,80 @@
+#include "isbn.h"
+
+const quint64 Isbn::InvalidKey;
+
+quint64 Isbn::numericKey(const QString &isbn)
+{
+    quint64 key = 0;
+    quint64 body = 0;
+    int digits = 0;
+    // 'X' is check digit of ISBN-10: nothing may follow it
+    bool checkX = false;
+    for (int i( 0 ); isbn.size() != i; ++i)
+    {
+        const QChar c = isbn.at( i );
+        if (c.isDigit() && 13 > digits && !checkX)
+        {
+            body = key;
+            key = 10 * key + c.digitValue();
+            ++digits;
+        }
+        else if ((QChar( 'X' ) == c || QChar( 'x' ) == c) && 9 == digits)
+        {
+            body = key;
+            ++digits;
+            checkX = true;
+        }
+        else if (QChar( '-' ) != c && QChar( ' ' ) != c)
+            return InvalidKey;
+    }
+
+    if (10 == digits)
+    {
+        // 978 prefix + first nine digits; check digit is recomputed
+        key = Q_UINT64_C( 978000000000 ) + body;
+        quint64 rest = key;
+        uint sum = 0;
+        for (int i( 0 ); 12 != i; ++i, rest /= 10)
+            sum += (rest % 10) * ((i % 2) ? 1 : 3);
+        key = 10 * key + (10 - sum % 10) % 10;
+    }
+    else if (13 != digits)
+        return InvalidKey;
+
+    return key;
+}
+
+bool Isbn::isValid(const QString &isbn)
+{
+    int values[ 13 ];
+    int digits = 0;
+    for (int i( 0 ); isbn.size() != i; ++i)
+    {
+        const QChar c = isbn.at( i );
+        // 'X' is check digit of ISBN-10: nothing may follow it
+        if (c.isDigit() && 13 > digits && !(10 == digits && 10 == values[ 9 ]))
+            values[ digits++ ] = c.digitValue();
+        else if ((QChar( 'X' ) == c || QChar( 'x' ) == c) && 9 == digits)
+            values[ digits++ ] = 10;
+        else if (QChar( '-' ) != c && QChar( ' ' ) != c)
+            return false;
+    }
+
+    if (10 == digits)
+    {
+        int sum = 0;
+        for (int i( 0 ); 10 != i; ++i)
+            sum += (10 - i) * values[ i ];
+        return 0 == sum % 11;
+    }
+
+    if (13 == digits)
+    {
+        int sum = 0;
+        for (int i( 0 ); 13 != i; ++i)
+            sum += values[ i ] * ((i % 2) ? 3 : 1);
+        return 0 == sum % 10;
+    }
+
+    return false;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QString>
+
+/**
+ * @brief The Isbn class helpers for ISBN-10 and ISBN-13 numbers written with or without dashes (spaces)
+ */
+class Isbn
+{
+public:
+    /**
+     * @brief InvalidKey numeric key of malformed ISBN (greater than key of any valid ISBN)
+     */
+    static const quint64 InvalidKey = Q_UINT64_C( 0xFFFFFFFFFFFFFFFF );
+
+    /**
+     * @brief numericKey numeric value of ISBN-13 for given ISBN (ISBN-10 is converted), so both forms
+     * of the same book have the same key. Check digit is not verified
+     * @return InvalidKey if ISBN is malformed
+     */
+    static quint64 numericKey( const QString& isbn );
+
+    /**
+     * @brief isValid whether ISBN is well-formed and its check digit is right
+     */
+    static bool isValid( const QString& isbn );
+};
@@ -1,6 +1,5 @@
 #include "logindialog.h"
 #include "ui_logindialog.h"
-#include <QCryptographicHash>
 
 LoginDialog::LoginDialog(QWidget *parent)
   : QDialog(parent)
@@ -20,12 +19,12 @@ void LoginDialog::clear()
     ui->passwordEdit->clear();
     ui->userEdit->clear();
     ui->userEdit->setFocus();
-    m_passwordHash.clear();
+    m_password.clear();
     m_userName.clear();
 }
 
 void LoginDialog::store_credentials()
 {
-    m_passwordHash = QCryptographicHash::hash((ui->passwordEdit->text().toStdString().c_str()), QCryptographicHash::Md5).toHex();
+    m_password = ui->passwordEdit->text();
     m_userName = ui->userEdit->text();
 }
@@ -14,12 +14,12 @@ public:
     explicit LoginDialog(QWidget *parent = 0);
     ~LoginDialog();
     
-    const QString& passwordHash() const { return m_passwordHash; }
-    const QString& userName()     const { return m_userName;     }
+    const QString& password() const { return m_password; }
+    const QString& userName() const { return m_userName; }
     void clear();
 private:
     Ui::LoginDialog *ui;
-    QString m_passwordHash;
+    QString m_password;
     QString m_userName;
 private slots:
     void store_credentials();
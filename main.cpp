@@ -1,16 +1,33 @@
 #include "mainwindow.h"
+#include "historyrollup.h"
 #include <QApplication>
 #include <stdexcept>
 #include <QDebug>
 
-
-int main(int argc, char *argv[])
+namespace
+{
+void setApplicationNames()
 {
-    QApplication a(argc, argv);
-
     QCoreApplication::setOrganizationName( "Bookstore" );
     QCoreApplication::setOrganizationDomain( "example.com" );
     QCoreApplication::setApplicationName( "bookstore_clerk" );
+}
+}
+
+int main(int argc, char *argv[])
+{
+    // maintenance mode: no windows (and no display) are needed
+    for (int i( 1 ); argc > i; ++i)
+        if (0 == qstrcmp( argv[ i ], "--rollup" ))
+        {
+            QCoreApplication a(argc, argv);
+            setApplicationNames();
+
+            return HistoryRollup::exec();
+        }
+
+    QApplication a(argc, argv);
+    setApplicationNames();
 
     MainWindow w;
     w.show();
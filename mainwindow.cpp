@@ -1,23 +1,44 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include <QSqlDatabase>
-#include <QSqlQuery>
-#include <QSqlQueryModel>
 #include <QDebug>
 #include <QMessageBox>
 #include <stdexcept>
 #include <QTimer>
-#include <QSqlError>
 #include <QSettings>
 #include <QItemSelectionModel>
-#include <QSqlRecord>
-#include <QSqlResult>
-#include <QStringListModel>
+#include <QHash>
 #include <numeric>
 #include <algorithm>
+#include <limits>
+#include <QLocale>
+#include <QInputDialog>
+#include <QDate>
+#include <QFileDialog>
+#include <QProgressDialog>
+#include <QStandardPaths>
+#include <QElapsedTimer>
 
 #include "logindialog.h"
 #include "fillrequestdialog.h"
+#include "diagnosticsdialog.h"
+#include "inputmodel.h"
+#include "bundlemodel.h"
+#include "bundlebrowsermodel.h"
+#include "bundlepricing.h"
+#include "bookdetail.h"
+#include "saleshistogram.h"
+#include "storeinventory.h"
+#include "sqldialect.h"
+#include "schema.h"
+#include "resultexporter.h"
+#include "supplierimporter.h"
+#include "connectionsettings.h"
+#include "sessioncache.h"
+#include "resultcache.h"
+#include "stringpool.h"
+#include "memorybudget.h"
+#include "sessiontoken.h"
 
 namespace
 {
@@ -27,8 +48,9 @@ namespace
  */
 struct DebugHelper
 {
-    const QString m_funcInfo;
-    DebugHelper( const QString funcInfo )
+    // Q_FUNC_INFO is string literal, so nothing is copied
+    const char * const m_funcInfo;
+    DebugHelper( const char * const funcInfo )
         : m_funcInfo(funcInfo)
     {
         qDebug() << "=====ENTERING " << m_funcInfo << "===========";
@@ -39,26 +61,6 @@ struct DebugHelper
     }
 };
 
-/**
- * @brief The DBOpener struct RAII helper that tries to (re)open connection database and closes it afterwards.
- */
-struct DBOpener
-{
-    MainWindow * const mw;
-    DBOpener( MainWindow * const iMW)
-        : mw( iMW )
-    {
-        bool isOpened = QSqlDatabase::database().open();
-        qDebug() << "DBOpen: " << isOpened;
-        if (!isOpened)
-            QMessageBox::critical(iMW, "Database connection error", "Cannot establish connection to database");
-    }
-    ~DBOpener()
-    {
-        qDebug() << "~DBOpen: ";
-        QSqlDatabase::database().close();
-    }
-};
 }
 
 MainWindow::MainWindow(QWidget * const parent)
@@ -68,18 +70,49 @@ MainWindow::MainWindow(QWidget * const parent)
     , m_fillRequestAction( new QAction( tr("Add Request"), this) )
     , m_modifyRequestAction( new QAction( tr("Modify Request"), this) )
     , m_removeRequestAction( new QAction( tr("Remove Request"), this) )
+    , m_submitRequestsAction( new QAction( tr("Submit Queued Requests"), this) )
     , m_addToBundleAction( new QAction( tr("Add to Bundle"), this ) )
     , m_removeBookFromBundle( new QAction( tr("Remove from Bundle"), this))
     , m_saveBundleAction( new QAction( tr("Save Bundle"), this))
+    , m_editBundleAction( new QAction( tr("Edit Bundle"), this))
+    , m_discountAllAction( new QAction( tr("Discount All..."), this))
+    , m_targetTotalAction( new QAction( tr("Discount to Total..."), this))
+    , m_ageDiscountAction( new QAction( tr("Discount by Age"), this))
     , m_login(new LoginDialog(this))
     , m_fillRequest( new FillRequestDialog( this ))
-    , m_inputModel( new QSqlQueryModel( this ) )
+    , m_diagnostics( new DiagnosticsDialog( this ))
+    , m_exporter( new ResultExporter( this ))
+    , m_exportProgress( new QProgressDialog( this ))
+    , m_importer( new SupplierImporter( this ))
+    , m_importProgress( new QProgressDialog( this ))
+    , m_dataService( new DataService( this ))
+    , m_filterWatcher( new QFutureWatcher< DataService::FilterResult >( this ))
+    , m_bookDetailWatcher( new QFutureWatcher< BookDetail >( this ))
+    , m_saveBundleWatcher( new QFutureWatcher< Workflow::Outcome >( this ))
+    , m_loginWatcher( new QFutureWatcher< DataService::LoginResult >( this ))
+    , m_requestWatcher( new QFutureWatcher< DataService::RequestResult >( this ))
+    , m_queuedRequestsWatcher( new QFutureWatcher< Workflow::Outcome >( this ))
+    , m_loadBundleWatcher( new QFutureWatcher< DataService::BundleContent >( this ))
+    , m_schemaWatcher( new QFutureWatcher< DataService::SchemaState >( this ))
+    , m_schemaChangeWatcher( new QFutureWatcher< bool >( this ))
+    , m_afterSubmit( AfterSubmitNothing )
+    , m_detailShowsRequest( false )
+    , m_inputModel( new InputModel( this ) )
     , m_inputSelectionModel( new QItemSelectionModel( m_inputModel, this ) )
+    , m_storeInventory( new StoreInventory( this ) )
     , m_filterButtons( new QButtonGroup( this ) )
-    , m_bundleBookModel( new QStringListModel( this ))
+    , m_bundleBookModel( new BundleModel( this ))
     , m_bundleBookSelectionModel( new QItemSelectionModel( m_bundleBookModel, this ))
+    , m_bundleBrowserModel( new BundleBrowserModel( m_dataService, this ))
     , m_isBundleUnderConstruction( false )
+    , m_editedBundleID( 0 )
+    , m_schemaChecked( false )
+    , m_releaseTimer( new QTimer( this ))
+    , m_stockReleased( false )
 {
+    m_stockParams.fromStock = 0;
+    m_stockParams.toStock   = 0;
+
     ui->setupUi(this);
     ui->filterGroupBox->hide();
     ui->discountBox->hide();
@@ -90,22 +123,35 @@ MainWindow::MainWindow(QWidget * const parent)
     m_filterButtons->addButton( ui->overstockedRadioButton, 1 );
     m_filterButtons->addButton( ui->customRadioButton, 2 );
 
-    /* setup connection to database */
-    setupConnection();
+    ui->lookbackCombo->addItem( tr("1 day"), 1 );
+    ui->lookbackCombo->addItem( tr("7 days"), 7 );
+    ui->lookbackCombo->addItem( tr("30 days"), 30 );
+    ui->lookbackCombo->addItem( tr("90 days"), 90 );
+    ui->lookbackCombo->setCurrentIndex( 1 );
+    ui->soldCaptionLabel->setText( tr("Sold in last %n day(s):", 0, lookbackDays()) );
 
-    connect(this, SIGNAL(connected()), this, SLOT(redrawView()));
+    /* connection to database is set up lazily, by first login */
+    connect(this, SIGNAL(connected()), this, SLOT(checkSchema()));
+    connect(this, SIGNAL(connected()), this, SLOT(restoreSession()));
     QTimer::singleShot(10, this, SLOT(processLogin()));
 
     ui->tableView->setModel(m_inputModel);
     ui->tableView->setSelectionModel( m_inputSelectionModel );
+    ui->tableView->setSortingEnabled( true );
 
     ui->bundleBooksView->setModel( m_bundleBookModel );
     ui->bundleBooksView->setSelectionModel( m_bundleBookSelectionModel );
+    ui->bundleBooksView->setUniformItemSizes( true );
+    ui->bundleBooksView->setSelectionMode( QAbstractItemView::ExtendedSelection );
+
+    ui->bundlesView->setModel( m_bundleBrowserModel );
 
+    connect( m_storeInventory, SIGNAL(fetched(int)), this, SLOT(storesFetched(int)) );
     connect( m_filterButtons, SIGNAL(buttonClicked(int)), this, SLOT(filterChanged(int)));
     connectFilters();
 
     connect( ui->filterButton, SIGNAL(clicked()), this, SLOT(redrawView()));
+    connect( ui->lookbackCombo, SIGNAL(currentIndexChanged(int)), this, SLOT(lookbackChanged(int)));
     connect( m_fillRequestAction, SIGNAL(triggered()), this, SLOT(fillRequest()));
 
     connect( ui->actionDisconnect, SIGNAL(triggered()), this, SLOT(disconnectClerk()) );
@@ -114,6 +160,43 @@ MainWindow::MainWindow(QWidget * const parent)
 
     connect( ui->actionAbou, SIGNAL(triggered()), this, SLOT(showAbout()) );
     connect( ui->actionAbout_Qt, SIGNAL(triggered()), this, SLOT(showAboutQt()) );
+    connect( ui->actionDiagnostics, SIGNAL(triggered()), this, SLOT(showDiagnostics()) );
+
+    m_exportProgress->setWindowTitle( tr("Export") );
+    m_exportProgress->setRange( 0, 0 );
+    m_exportProgress->setAutoReset( false );
+    m_exportProgress->setAutoClose( false );
+    m_exportProgress->reset();
+    connect( ui->actionExportResults, SIGNAL(triggered()), this, SLOT(exportResults()) );
+    connect( ui->actionExportRequests, SIGNAL(triggered()), this, SLOT(exportRequests()) );
+    connect( ui->actionExportHistory, SIGNAL(triggered()), this, SLOT(exportHistory()) );
+    connect( m_exporter, SIGNAL(progress(qint64)), this, SLOT(exportProgressed(qint64)) );
+    connect( m_exporter, SIGNAL(finished(bool,qint64,QString)), this, SLOT(exportFinished(bool,qint64,QString)) );
+    connect( m_exportProgress, SIGNAL(canceled()), m_exporter, SLOT(cancel()) );
+
+    m_importProgress->setWindowTitle( tr("Import") );
+    m_importProgress->setRange( 0, 0 );
+    m_importProgress->setAutoReset( false );
+    m_importProgress->setAutoClose( false );
+    m_importProgress->reset();
+    connect( ui->actionImportSupplierFeed, SIGNAL(triggered()), this, SLOT(importSupplierFeed()) );
+    connect( m_importer, SIGNAL(progress(qint64)), this, SLOT(importProgressed(qint64)) );
+    connect( m_importer, SIGNAL(finished(bool,qint64,qint64,QString)), this, SLOT(importFinished(bool,qint64,qint64,QString)) );
+    connect( m_importProgress, SIGNAL(canceled()), m_importer, SLOT(cancel()) );
+
+    connect( m_filterWatcher, SIGNAL(finished()), this, SLOT(filterFetched()) );
+    connect( m_bookDetailWatcher, SIGNAL(finished()), this, SLOT(bookDetailFetched()) );
+    connect( m_saveBundleWatcher, SIGNAL(finished()), this, SLOT(bundleSaved()) );
+    connect( m_loginWatcher, SIGNAL(finished()), this, SLOT(loginFinished()) );
+    connect( m_requestWatcher, SIGNAL(finished()), this, SLOT(requestWritten()) );
+    connect( m_queuedRequestsWatcher, SIGNAL(finished()), this, SLOT(queuedRequestsSubmitted()) );
+    connect( m_loadBundleWatcher, SIGNAL(finished()), this, SLOT(bundleLoaded()) );
+    connect( m_schemaWatcher, SIGNAL(finished()), this, SLOT(schemaChecked()) );
+    connect( m_schemaChangeWatcher, SIGNAL(finished()), this, SLOT(schemaChanged()) );
+
+    m_releaseTimer->setSingleShot( true );
+    m_releaseTimer->setInterval( MemoryBudget::releaseAfterMs() );
+    connect( m_releaseTimer, SIGNAL(timeout()), this, SLOT(releaseOffscreenResults()) );
 
     connect( m_inputSelectionModel, SIGNAL(currentChanged(QModelIndex,QModelIndex)),
              this, SLOT(inputViewSelectionChanged(QModelIndex,QModelIndex)) );
@@ -122,6 +205,10 @@ MainWindow::MainWindow(QWidget * const parent)
 
     connect( m_modifyRequestAction, SIGNAL(triggered()), this, SLOT(modifyRequest()));
     connect( m_removeRequestAction, SIGNAL(triggered()), this, SLOT(removeRequest()));
+    connect( m_submitRequestsAction, SIGNAL(triggered()), this, SLOT(submitQueuedRequests()));
+    connect( m_inputModel, SIGNAL(queuedRequestsChanged(int)), this, SLOT(queuedRequestsChanged(int)));
+    connect( ui->tableView->itemDelegate(), SIGNAL(closeEditor(QWidget*,QAbstractItemDelegate::EndEditHint))
+             , this, SLOT(requestEditorClosed(QWidget*,QAbstractItemDelegate::EndEditHint)) );
 
     connect( m_addToBundleAction, SIGNAL(triggered()), this, SLOT(addToBundle()));
 
@@ -132,6 +219,10 @@ MainWindow::MainWindow(QWidget * const parent)
     connect( ui->resetDiscountButton, SIGNAL(clicked()), this, SLOT(discountReset()) );
     connect( m_removeBookFromBundle, SIGNAL(triggered()), this, SLOT(removeFromBundle()));
     connect( m_saveBundleAction, SIGNAL(triggered()), this, SLOT(saveBundle()));
+    connect( m_editBundleAction, SIGNAL(triggered()), this, SLOT(editBundle()));
+    connect( m_discountAllAction, SIGNAL(triggered()), this, SLOT(discountAll()));
+    connect( m_targetTotalAction, SIGNAL(triggered()), this, SLOT(discountToTarget()));
+    connect( m_ageDiscountAction, SIGNAL(triggered()), this, SLOT(discountByAge()));
     connect( ui->discountSpin, SIGNAL(valueChanged(int)), this, SLOT(discountChanged(int)));
 }
 
@@ -154,6 +245,10 @@ void MainWindow::currentTabChanged(const int index)
     DebugHelper debugHelper( Q_FUNC_INFO );
     ui->currentBookBox->hide();
 
+    // bundles are read again whenever their pane is shown
+    if (2 != index && MemoryBudget::isEnabled())
+        m_bundleBrowserModel->clear();
+
     switch (index)
     {
     case 0:
@@ -161,6 +256,8 @@ void MainWindow::currentTabChanged(const int index)
         ui->discountBox->hide();
         qDebug() << m_inputSelectionModel->currentIndex().row();
         m_removeBookFromBundle->setVisible( false );
+        m_editBundleAction->setVisible( false );
+        showBundlePricingActions( false );
         inputViewSelectionChanged( m_inputSelectionModel->currentIndex(), m_inputModel->index( -1, -1 ));
         break;
     case 1:
@@ -174,10 +271,21 @@ void MainWindow::currentTabChanged(const int index)
         m_modifyRequestAction->setVisible( false );
         m_modifyRequestAction->setVisible( false );
         m_fillRequestAction->setVisible( false );
+        m_editBundleAction->setVisible( false );
+        showBundlePricingActions( m_isBundleUnderConstruction );
         // do stuff for bundle modification pane
         break;
     case 2:
         // do stuff for bundle selection pane
+        ui->discountBox->hide();
+        m_addToBundleAction->setVisible( false );
+        m_modifyRequestAction->setVisible( false );
+        m_removeRequestAction->setVisible( false );
+        m_fillRequestAction->setVisible( false );
+        m_removeBookFromBundle->setVisible( false );
+        m_editBundleAction->setVisible( true );
+        showBundlePricingActions( false );
+        m_bundleBrowserModel->reload( lookbackDays() );
         break;
     default:
         throw std::logic_error( "There shouldn't be that tab!");
@@ -193,11 +301,13 @@ void MainWindow::configureActions()
     setShortcut( ui->actionAbou, QKeySequence::HelpContents, tr("F1"));
     setShortcut( ui->actionAbout_Qt, QKeySequence::WhatsThis, tr("Shift+F1"));
     setShortcut( m_fillRequestAction, QKeySequence::Bold, tr("Ctrl+B") );
-    setShortcut( m_modifyRequestAction, QKeySequence::Bold, tr("Ctrl+B") );
+    setShortcut( m_modifyRequestAction, QKeySequence::UnknownKey, tr("Ctrl+M") );
     setShortcut( m_removeRequestAction, QKeySequence::Underline, tr("Ctrl+U") );
+    setShortcut( m_submitRequestsAction, QKeySequence::UnknownKey, tr("Ctrl+Return") );
     setShortcut( m_addToBundleAction, QKeySequence::Italic, tr("Ctrl+I"));
-    setShortcut( m_removeBookFromBundle, QKeySequence::Italic, tr("Ctrl+I"));
+    setShortcut( m_removeBookFromBundle, QKeySequence::UnknownKey, tr("Ctrl+D"));
     setShortcut( m_saveBundleAction, QKeySequence::Save, tr("Ctrl+S"));
+    setShortcut( m_editBundleAction, QKeySequence::UnknownKey, tr("Ctrl+E"));
 
     m_fillRequestAction->setToolTip( tr("Fill request for selected book") );
     ui->mainToolBar->addAction( m_fillRequestAction);
@@ -214,6 +324,11 @@ void MainWindow::configureActions()
     ui->menuAction->addAction( m_removeRequestAction );
     m_removeRequestAction->setVisible( false );
 
+    m_submitRequestsAction->setToolTip( tr("Submit requests entered in Request column" ));
+    ui->mainToolBar->addAction( m_submitRequestsAction );
+    ui->menuAction->addAction( m_submitRequestsAction );
+    m_submitRequestsAction->setVisible( false );
+
     m_addToBundleAction->setToolTip( tr("Add selected book to bundle"));
     ui->mainToolBar->addAction( m_addToBundleAction );
     ui->menuAction->addAction( m_addToBundleAction );
@@ -228,136 +343,252 @@ void MainWindow::configureActions()
     ui->mainToolBar->addAction( m_saveBundleAction );
     ui->menuAction->addAction( m_saveBundleAction );
     m_saveBundleAction->setVisible( false );
+
+    m_editBundleAction->setToolTip( tr("Modify selected bundle"));
+    ui->mainToolBar->addAction( m_editBundleAction );
+    ui->menuAction->addAction( m_editBundleAction );
+    m_editBundleAction->setVisible( false );
+
+    m_discountAllAction->setToolTip( tr("Give the same discount to every book in bundle"));
+    m_targetTotalAction->setToolTip( tr("Discount books in bundle so it costs given total"));
+    m_ageDiscountAction->setToolTip( tr("Discount books in bundle by their age"));
+    ui->menuAction->addSeparator();
+    ui->menuAction->addAction( m_discountAllAction );
+    ui->menuAction->addAction( m_targetTotalAction );
+    ui->menuAction->addAction( m_ageDiscountAction );
+    showBundlePricingActions( false );
+}
+
+void MainWindow::showBundlePricingActions(const bool visible)
+{
+    m_discountAllAction->setVisible( visible );
+    m_targetTotalAction->setVisible( visible );
+    m_ageDiscountAction->setVisible( visible );
 }
 
 MainWindow::~MainWindow()
 {
+    if (0 != m_clerkID)
+        saveSession();
+
+    m_dataService->waitForDone();
     delete ui;
 }
 
 void MainWindow::setupConnection() const
 {
     QSettings settings( "settings.ini", QSettings::IniFormat );
+    const ConnectionSettings connection( ConnectionSettings::read( settings, "database" ) );
+
+    qDebug() << "driver: " << connection.driver;
+    qDebug() << "hostname: " << connection.hostName;
+    qDebug() << "database: " << connection.databaseName;
+    qDebug() << "username: " << connection.userName;
+    qDebug() << "password: " << connection.password;
+    qDebug() << "port: " << connection.port;
+    qDebug() << "dialect: " << SqlDialect::forDriver( connection.driver ).name();
 
-    settings.beginGroup( "database" );
-    const QString dbDriver( settings.value( "driver",   "QOCI"      ).toString() );
-    const QString hostName( settings.value( "hostname", "localhost" ).toString() );
-    const QString dbName( settings.value( "database", "bookstore" ).toString() );
-    const QString userName( settings.value( "user",     QString()   ).toString() );
-    const QString password( settings.value( "password", QString()   ).toString() );
-    const uint port( settings.value( "port", "1521").toUInt());
-    settings.endGroup();
-
-    qDebug() << "driver: " << dbDriver;
-    qDebug() << "hostname: " << hostName;
-    qDebug() << "database: " << dbName;
-    qDebug() << "username: " << userName;
-    qDebug() << "password: " << password;
-    qDebug() << "port: " << port;
-
-    QSqlDatabase db = QSqlDatabase::addDatabase( dbDriver );
-    db.setHostName(     hostName );
-    db.setDatabaseName( dbName );
-    db.setUserName(     userName );
-    db.setPassword(     password );
-    db.setPort( port );
+    connection.addDatabase( QSqlDatabase::defaultConnection );
 }
 
 namespace
 {
 /**
- * @brief find_authors_for_book get all authors that have written book
- * @param isbn ISBN number of book
- * @return StringList of authors
+ * @brief readFilterState reads current state of filter controls
  */
-const QStringList findAuthorsForBook( const QString& isbn )
+SessionCache::FilterState readFilterState( const Ui::MainWindow * const ui, const int preset, const uint lookbackDays )
+{
+    SessionCache::FilterState filter;
+    filter.preset             = preset;
+    filter.boughtMoreChecked  = ui->boughtMoreThanBox->isChecked();
+    filter.boughtMore         = ui->boughtMoreThenSpin->value();
+    filter.boughtLessChecked  = ui->boughtLessThanBox->isChecked();
+    filter.boughtLess         = ui->boughtLessThenSpin->value();
+    filter.instockMoreChecked = ui->instockMoreThanBox->isChecked();
+    filter.instockMore        = ui->instockMoreThenSpin->value();
+    filter.instockLessChecked = ui->instockLessThanBox->isChecked();
+    filter.instockLess        = ui->instockLessThenSpin->value();
+    filter.lookbackDays       = lookbackDays;
+
+    return filter;
+}
+}
+
+QString MainWindow::sessionKey() const
+{
+    const QSqlDatabase db = QSqlDatabase::database( QSqlDatabase::defaultConnection, false );
+    return db.driverName() + "/" + db.hostName() + "/" + db.databaseName();
+}
+
+void MainWindow::saveSession() const
+{
+    SessionCache::Snapshot snapshot;
+    snapshot.savedAt    = QDateTime::currentDateTime();
+    snapshot.isbns      = m_inputModel->isbns();
+    snapshot.sold       = m_inputModel->soldValues();
+    snapshot.quantities = m_inputModel->quantities();
+
+    qDebug() << "Save session: " <<
+                SessionCache( sessionKey() ).save( readFilterState( ui, m_filterButtons->checkedId(), lookbackDays() )
+                                                 , snapshot );
+}
+
+void MainWindow::restoreSession()
 {
     DebugHelper debugHelper( Q_FUNC_INFO );
-    QSqlQuery searchAuthors;
-    searchAuthors.setForwardOnly( true );
-    qDebug() << "Prepare: " <<
-        searchAuthors.prepare( "SELECT name "
-                               "FROM book JOIN book_s_author "
-                                         "ON book_s_author.isbn = book.isbn "
-                                         "JOIN author "
-                                         "ON author.author_id = book_s_author.author_id "
-                               "WHERE book_s_author.isbn = :isbn ");
 
-    searchAuthors.bindValue( ":isbn", isbn );
-    qDebug() << "Exec: " << searchAuthors.exec();
+    SessionCache::FilterState filter;
+    SessionCache::Snapshot snapshot;
+    if (SessionCache( sessionKey() ).load( filter, snapshot ))
+    {
+        disconnectFilters();
+        if (m_filterButtons->button( filter.preset ))
+            m_filterButtons->button( filter.preset )->setChecked( true );
+        ui->boughtMoreThanBox->setChecked( filter.boughtMoreChecked );
+        ui->boughtMoreThenSpin->setValue( filter.boughtMore );
+        ui->boughtLessThanBox->setChecked( filter.boughtLessChecked );
+        ui->boughtLessThenSpin->setValue( filter.boughtLess );
+        ui->instockMoreThanBox->setChecked( filter.instockMoreChecked );
+        ui->instockMoreThenSpin->setValue( filter.instockMore );
+        ui->instockLessThanBox->setChecked( filter.instockLessChecked );
+        ui->instockLessThenSpin->setValue( filter.instockLess );
+        connectFilters();
+
+        const int lookbackIndex = ui->lookbackCombo->findData( static_cast< int >( filter.lookbackDays ) );
+        if (-1 != lookbackIndex)
+        {
+            ui->lookbackCombo->blockSignals( true );
+            ui->lookbackCombo->setCurrentIndex( lookbackIndex );
+            ui->lookbackCombo->blockSignals( false );
+            ui->soldCaptionLabel->setText( tr("Sold in last %n day(s):", 0, lookbackDays()) );
+        }
 
-    QStringList authors;
-    while (searchAuthors.next())
-        authors << searchAuthors.value( 0 ).toString();
+        m_inputModel->setRows( snapshot.isbns, snapshot.sold, snapshot.quantities );
+        ui->tableView->resizeColumnsToContents();
+        statusBar()->showMessage( tr("Showing %1 row(s) cached at %2. Refreshing...")
+                                  .arg( m_inputModel->rowCount() )
+                                  .arg( QLocale().toString( snapshot.savedAt, QLocale::ShortFormat ) ) );
+    }
 
-    qDebug() << "Authors: " << authors;
+    // let cached results be painted before fresh query blocks
+    QTimer::singleShot(10, this, SLOT(redrawView()));
+}
 
-    return authors;
+namespace
+{
+/**
+ * @brief checksIndexes whether missing indexes are looked for when schema is checked
+ */
+bool checksIndexes()
+{
+    const QSettings settings( "settings.ini", QSettings::IniFormat );
+    return settings.value( "schema/checkIndexes", true ).toBool();
 }
 }
 
-void MainWindow::modifyRequest()
+void MainWindow::checkSchema()
 {
-    DebugHelper debugHelper( Q_FUNC_INFO);
+    DebugHelper debugHelper( Q_FUNC_INFO );
 
-    const int row = m_inputSelectionModel->currentIndex().row();
-    if (-1 == row)
-    {
-        qDebug() << "No row is selected";
+    if (m_schemaChecked)
         return;
-    }
+    m_schemaChecked = true;
+
+    m_schemaWatcher->setFuture( m_dataService->checkSchema( checksIndexes() ) );
+}
 
-    m_fillRequest->prepareForm( ui->requestedLabel->text().toUInt() );
+void MainWindow::schemaChecked()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
 
-    if (QDialog::Accepted != m_fillRequest->exec())
+    const DataService::SchemaState state = m_schemaWatcher->result();
+    if (0 == m_clerkID)
+        return;
+
+    if (!state.ok)
     {
-        qDebug() << "Request has been cancelled!";
+        QMessageBox::critical( this, tr("Database connection error"), tr("Cannot establish connection to database") );
         return;
     }
 
-    const uint request = m_fillRequest->quantity();
+    if (!state.hasTables)
+    {
+        if (QMessageBox::Yes == QMessageBox::question( this, tr("Empty database")
+                                                       , tr("There are no bookstore tables in database. Create them?")
+                                                       , QMessageBox::Yes | QMessageBox::No ))
+        {
+            m_schemaUpgrades.clear();
+            m_schemaChangeWatcher->setFuture( m_dataService->createSchema() );
+        }
+        return;
+    }
 
-    if (request == ui->requestedLabel->text().toUInt())
+    const QList< Schema::Upgrade >& upgrades = state.upgrades;
+    if (!upgrades.isEmpty())
     {
-        qDebug() << "Request has not been changed";
+        QMessageBox question( QMessageBox::Question, tr("Database needs upgrade")
+                              , tr("Database has been created by older version of application: %n table(s) or "
+                                   "column(s) are missing, so some views will fail. Upgrade database now?"
+                                   , 0, upgrades.size())
+                              , QMessageBox::Yes | QMessageBox::No, this );
+        question.setDetailedText( Schema::upgradeScript( upgrades ) );
+        if (QMessageBox::Yes != question.exec())
+            return;
+
+        m_schemaUpgrades = upgrades;
+        m_schemaChangeWatcher->setFuture( m_dataService->upgradeSchema( upgrades ) );
         return;
     }
 
-    const QString isbn = ui->isbnLabel->text();
-    qDebug() << "ISBN: " << isbn;
+    const QList< Schema::Index >& missing = state.missingIndexes;
+    if (missing.isEmpty())
+        return;
 
-    DBOpener    dbopener( this );
+    QStringList ddl;
+    for (int i( 0 ); missing.size() != i; ++i)
+        ddl << "-- " + missing.at( i ).purpose
+            << Schema::createIndexStatement( missing.at( i ) ) + ";";
+
+    QMessageBox warning( QMessageBox::Warning, tr("Missing indexes")
+                         , tr("%n index(es) that queries rely on are missing, so they may be slow. "
+                              "Ask administrator of database to create them (see details).", 0, missing.size())
+                         , QMessageBox::Ok, this );
+    warning.setDetailedText( ddl.join( "\n" ) );
+    warning.exec();
+}
 
-    QSqlQuery updateQuery;
-    qDebug() << "Prepare: " <<
-                updateQuery.prepare( "UPDATE request "
-                                     "SET quantity = :quantity "
-                                     "where isbn = :isbn");
+void MainWindow::schemaChanged()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
 
-    updateQuery.bindValue( ":isbn", isbn );
-    updateQuery.bindValue( ":quantity", request );
+    const bool changed = m_schemaChangeWatcher->result();
+    const QList< Schema::Upgrade > upgrades = m_schemaUpgrades;
+    m_schemaUpgrades.clear();
 
-    qDebug() << "Transaction: " <<
-                QSqlDatabase::database().transaction();
-    const bool queryResult = updateQuery.exec();
-    qDebug() << "Exec: " << queryResult;
-    if (!queryResult) {
-        qDebug() << "Rollback" <<
-                  QSqlDatabase::database().rollback();
+    if (upgrades.isEmpty())
+    {
+        if (!changed)
+            QMessageBox::critical( this, tr("Database error"), tr("Cannot create tables.") );
         return;
     }
-    const bool commit = QSqlDatabase::database().commit();
-    qDebug() << "Commit: " << commit;
 
-    if (commit)
-        ui->requestedLabel->setText( QString::number( request ));
-    else
-        qDebug() << "Rollback" <<
-                  QSqlDatabase::database().rollback();
+    if (!changed)
+    {
+        QMessageBox failure( QMessageBox::Critical, tr("Database error")
+                             , tr("Cannot upgrade database. Ask administrator of database "
+                                  "to run upgrade script (see details).")
+                             , QMessageBox::Ok, this );
+        failure.setDetailedText( Schema::upgradeScript( upgrades ) );
+        failure.exec();
+        return;
+    }
 
+    // indexes are checked in upgraded database
+    if (0 != m_clerkID)
+        m_schemaWatcher->setFuture( m_dataService->checkSchema( checksIndexes() ) );
 }
 
-void MainWindow::removeRequest()
+void MainWindow::modifyRequest()
 {
     DebugHelper debugHelper( Q_FUNC_INFO);
 
@@ -368,44 +599,40 @@ void MainWindow::removeRequest()
         return;
     }
 
-    const QString isbn = ui->isbnLabel->text();
+    const QString isbn = m_inputModel->isbn( row );
     qDebug() << "ISBN: " << isbn;
+    if (m_bookDetail.isbn != isbn)
+    {
+        qDebug() << "Detail of book has not arrived yet";
+        return;
+    }
 
-    DBOpener    dbopener( this );
-
-    QSqlQuery removeQuery;
-    qDebug() << "Prepare: " <<
-                removeQuery.prepare( "DELETE "
-                                     "FROM request "
-                                     "where isbn = :isbn");
+    if (m_requestWatcher->isRunning())
+    {
+        qDebug() << "Request is being written";
+        return;
+    }
 
-    removeQuery.bindValue( ":isbn", isbn );
+    m_fillRequest->prepareForm( m_bookDetail.requested );
 
-    qDebug() << "Transaction: " <<
-                QSqlDatabase::database().transaction();
-    const bool queryResult = removeQuery.exec();
-    qDebug() << "Exec: " << queryResult;
-    if (!queryResult) {
-        qDebug() << "Rollback" <<
-                  QSqlDatabase::database().rollback();
+    if (QDialog::Accepted != m_fillRequest->exec())
+    {
+        qDebug() << "Request has been cancelled!";
         return;
     }
-    const bool commit = QSqlDatabase::database().commit();
-    qDebug() << "Commit: " << commit;
 
-    if (commit) {
-        ui->requestedLabel->setText( "None" );
-        m_modifyRequestAction->setVisible( false );
-        m_removeRequestAction->setVisible( false );
-        m_fillRequestAction->setVisible( true );
+    const uint request = m_fillRequest->quantity();
+
+    if (request == m_bookDetail.requested)
+    {
+        qDebug() << "Request has not been changed";
+        return;
     }
-    else
-        qDebug() << "Rollback" <<
-                  QSqlDatabase::database().rollback();
 
+    writeRequest( request );
 }
 
-void MainWindow::fillRequest()
+void MainWindow::removeRequest()
 {
     DebugHelper debugHelper( Q_FUNC_INFO);
 
@@ -416,57 +643,91 @@ void MainWindow::fillRequest()
         return;
     }
 
-    m_fillRequest->prepareForm( 1 );
-
-    if (QDialog::Accepted != m_fillRequest->exec())
+    const QString isbn = m_inputModel->isbn( row );
+    qDebug() << "ISBN: " << isbn;
+    if (m_bookDetail.isbn != isbn)
     {
-        qDebug() << "Request has been cancelled!";
+        qDebug() << "Detail of book has not arrived yet";
         return;
     }
 
-    const uint request = m_fillRequest->quantity();
-
-    const QString isbn = m_inputModel->record( row ).value( "isbn" ).toString();
-    qDebug() << "ISBN: " << isbn;
+    if (m_requestWatcher->isRunning())
+    {
+        qDebug() << "Request is being written";
+        return;
+    }
 
-    DBOpener    dbopener( this );
+    writeRequest( 0 );
+}
 
-    QSqlQuery insertRequest;
-    qDebug() << "Prepare: " <<
-                insertRequest.prepare( "INSERT INTO request( isbn, quantity, clerk_id ) VALUES "
-                                       "( :isbn, :quantity, :clerkID )");
+void MainWindow::fillRequest()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO);
 
-    insertRequest.bindValue( ":isbn", isbn );
-    insertRequest.bindValue( ":quantity", request );
-    insertRequest.bindValue( ":clerkID", m_clerkID );
+    const int row = m_inputSelectionModel->currentIndex().row();
+    if (-1 == row)
+    {
+        qDebug() << "No row is selected";
+        return;
+    }
 
-    qDebug() << "Transaction: " <<
-                QSqlDatabase::database().transaction();
-    const bool insertResult = insertRequest.exec();
-    qDebug() << "Exec: " << insertResult;
-    if (!insertResult) {
-        qDebug() << "Rollback" <<
-                  QSqlDatabase::database().rollback();
+    const QString isbn = m_inputModel->isbn( row );
+    if (m_bookDetail.isbn != isbn)
+    {
+        qDebug() << "Detail of book has not arrived yet";
         return;
     }
-    const bool commit = QSqlDatabase::database().commit();
-    qDebug() << "Commit: " << commit;
 
-    if (commit)
+    if (m_requestWatcher->isRunning())
     {
-        ui->requestedLabel->setText( QString::number( request ));
-        m_modifyRequestAction->setVisible( true );
-        m_fillRequestAction->setVisible( false );
+        qDebug() << "Request is being written";
+        return;
     }
-    else  {
-        qDebug() << "Rollback" <<
-                  QSqlDatabase::database().rollback();
+
+    m_fillRequest->prepareForm( 1 );
+
+    if (QDialog::Accepted != m_fillRequest->exec())
+    {
+        qDebug() << "Request has been cancelled!";
+        return;
     }
+
+    submitRequest( isbn, m_fillRequest->quantity() );
 }
 
 void MainWindow::disconnectClerk()
 {
+    if (submitBeforeDisconnect( AfterSubmitDisconnect ))
+        closeSession();
+}
+
+bool MainWindow::submitBeforeDisconnect(const AfterSubmit after)
+{
+    if (0 == m_clerkID || m_inputModel->queuedRequests().isEmpty())
+        return true;
+
+    // session is closed once queued requests have been submitted (see queuedRequestsSubmitted)
+    m_afterSubmit = after;
+    submitQueuedRequests();
+    return false;
+}
+
+void MainWindow::closeSession()
+{
+    // running workflows of this clerk are rolled back, connections of data service are closed
+    m_dataService->closeConnections( 5000 );
+
     m_inputModel->clear();
+    m_bookDetail = BookDetail();
+    m_salesHistogram.clear();
+    m_storeInventory->clear();
+    m_stockISBNs.clear();
+    m_stockQuantities.clear();
+    m_stockParams.knownFreshness.clear();
+    m_releaseTimer->stop();
+    m_bundleBrowserModel->clear();
+    m_editBundleAction->setVisible( false );
+    showBundlePricingActions( false );
     ui->tabWidget->hide();
     ui->mainToolBar->hide();
     ui->filterGroupBox->hide();
@@ -490,6 +751,13 @@ void MainWindow::connectClerk()
         return;
     }
 
+    // stores are read from settings by first login, not at startup
+    if (m_storeInventory->isEmpty())
+    {
+        m_storeInventory->setStores( StoreInventory::readStores() );
+        m_inputModel->setStoreNames( m_storeInventory->storeNames() );
+    }
+
     ui->tabWidget->show();
     ui->mainToolBar->show();
     ui->filterToggleButton->show();
@@ -519,350 +787,428 @@ void MainWindow::showAboutQt()
     QMessageBox::aboutQt( this, tr("Bookstore Clerk") );
 }
 
-namespace
+QString MainWindow::askExportFileName(const QString &title, const QString &baseName)
 {
-void findBookInfo( const QString& isbn, QString& title, uint& quantity, qreal& price, uint& year, QString& publisherName)
-{
-    DebugHelper debugHelper( Q_FUNC_INFO );
-    QSqlQuery searchBook;
-    searchBook.setForwardOnly( true );
-    qDebug() << "Prepare: " <<
-                searchBook.prepare( "SELECT title, price, quantity, year, publisher.name "
-                                    "FROM book JOIN publisher ON publisher.publisher_id = book.publisher_id "
-                                    "WHERE isbn = :isbn" );
+    if (m_exporter->isRunning())
+    {
+        QMessageBox::information( this, title, tr("Another export is still running.") );
+        return QString();
+    }
 
-    searchBook.bindValue( ":isbn", isbn );
+    const QString dir = QStandardPaths::writableLocation( QStandardPaths::DocumentsLocation );
+    return QFileDialog::getSaveFileName( this, title
+                                         , dir + "/" + baseName + "-" + QDate::currentDate().toString( Qt::ISODate ) + ".csv"
+                                         , tr("CSV (*.csv);;Columnar (*.dbcc)") );
+}
 
-    qDebug() << "Exec: " << searchBook.exec();
-    qDebug() << "First: "<< searchBook.first();
+void MainWindow::startExportProgress(const bool started)
+{
+    if (!started)
+    {
+        QMessageBox::information( this, tr("Export"), tr("Another export is still running.") );
+        return;
+    }
 
-    title = searchBook.value( 0 ).toString();
-    price = searchBook.value( 1 ).toFloat();
-    quantity = searchBook.value( 2 ).toUInt();
-    year = searchBook.value( 3 ).toUInt();
-    publisherName = searchBook.value( 4 ).toString();
-    qDebug() << "Title: " << title << "Quantity: " << quantity
-             << "Price: " << price << "Year: " << year
-             << "Publisher Name: " << publisherName;
+    m_exportProgress->setLabelText( tr("Exporting...") );
+    m_exportProgress->show();
 }
 
-uint findRequestedAmmount( const QString& isbn, uint& clerkID )
+void MainWindow::exportResults()
 {
     DebugHelper debugHelper( Q_FUNC_INFO );
-    QSqlQuery findRequest;
-    findRequest.setForwardOnly( true );
 
-    qDebug() << "Prepare: " <<
-                findRequest.prepare( "SELECT quantity, clerk_id FROM request WHERE isbn = :isbn" );
+    const QString fileName = askExportFileName( tr("Export Filter Results"), "filter" );
+    if (fileName.isEmpty())
+        return;
 
-    findRequest.bindValue( ":isbn", isbn );
-    qDebug() << "Exec: " << findRequest.exec();
+    QStringList headers;
+    for (int column( 0 ); m_inputModel->columnCount() != column; ++column)
+        headers << m_inputModel->headerData( column, Qt::Horizontal ).toString();
 
-    if (0 == findRequest.size())
+    QVector< QVariantList > rows;
+    rows.reserve( m_inputModel->rowCount() );
+    for (int row( 0 ); m_inputModel->rowCount() != row; ++row)
     {
-        clerkID = 0;
-        return 0;
+        QVariantList values;
+        for (int column( 0 ); m_inputModel->columnCount() != column; ++column)
+            values << m_inputModel->data( m_inputModel->index( row, column ) );
+        rows << values;
     }
 
-    qDebug() << "First: " << findRequest.first();
-    clerkID = findRequest.value( 1 ).toUInt();
-    const uint requested = findRequest.value( 0 ).toUInt();
-
-    qDebug() << "ClerkID: " << clerkID << "Requested: " << requested;
-    return requested;
-}
+    startExportProgress( m_exporter->startRowsExport( fileName, headers, rows ) );
 }
 
-void MainWindow::saveBundle()
+void MainWindow::exportRequests()
 {
     DebugHelper debugHelper( Q_FUNC_INFO );
 
-    if (!m_isBundleUnderConstruction || m_bundledISBNs.empty() || ui->bundleNameEdit->text().isNull()) {
-        // can't do shit
+    const QString fileName = askExportFileName( tr("Export Requests"), "requests" );
+    if (fileName.isEmpty())
         return;
-    }
 
-    DBOpener db(this);
-
-#define _USE_PSQL
-#ifdef _USE_PSQL
-    QSqlQuery getBundleIdQuery;
-    getBundleIdQuery.setForwardOnly( true );
-    qDebug() << "Prepare: " <<
-                getBundleIdQuery.prepare( "SELECT 1 + COUNT(*) FROM bundle" );
-    qDebug() << "Exec: " << getBundleIdQuery.exec();
-    qDebug() << "First: "<< getBundleIdQuery.first();
-
-    const uint bundleID = getBundleIdQuery.value( 0 ).toUInt();
-    qDebug() << "BundleID: " << bundleID;
-#endif
-
-    QSqlQuery addBundleQuery;
-    qDebug() << "Prepare: " <<
-                addBundleQuery.prepare( "INSERT INTO bundle (bundle_id, name, deleted, commnt) VALUES ("
-                                    #ifdef _USE_PSQL
-                                        ":bundleID"
-                                    #else
-                                        "bundle_sequence.NEXTVAL"
-                                    #endif
-                                        ",:name, 0, :commnt)");
-#ifdef _USE_PSQL
-    addBundleQuery.bindValue( ":bundleID", bundleID);
-#endif
-    addBundleQuery.bindValue( ":name", ui->bundleNameEdit->text());
-    addBundleQuery.bindValue( ":commnt", ui->bundleCommentEdit->toPlainText());
-
-    qDebug() << "Transaction: " <<
-                QSqlDatabase::database().transaction();
-    const bool addBundleResult = addBundleQuery.exec();
-    qDebug() << "Exec: " << addBundleResult;
-    if (!addBundleResult) {
-        qDebug() << "Rollback" <<
-                  QSqlDatabase::database().rollback();
-        return;
-    }
-
-#ifndef _USE_PSQL
-    QSqlQuery getBundleIdQuery;
-    getBundleIdQuery.setForwardOnly( true );
-    qDebug() << "Prepare: " <<
-                getBundleIdQuery.prepare( "SELECT bundle_sequence.CURRVAL FROM dual" );
-    qDebug() << "Exec: " << getBundleIdQuery.exec() << getBundleIdQuery.first();
-
-    const uint bundleID = getBundleIdQuery.value( 0 ).toUInt();
-#endif
-
-    QSqlQuery addBookToBundleQuery;
-    qDebug() << "Prepare: " <<
-                addBookToBundleQuery.prepare( "INSERT INTO bundledbook (isbn, bundle_id, discount, deleted) VALUES "
-                                              "( :isbn, :bundle_id, :discount, 0 )");
-    addBookToBundleQuery.bindValue( ":bundle_id", bundleID );
-
-    for (int i( 0 ); m_bundledISBNs.size() != i; ++i) {
-        addBookToBundleQuery.bindValue( ":isbn", m_bundledISBNs.at( i ));
-        addBookToBundleQuery.bindValue( ":discount", m_bundledDiscounts.at( i ));
-
-        const bool addBookResult = addBookToBundleQuery.exec();
-        qDebug() << "Exec: " << addBookResult;
-        if (!addBookResult) {
-            qDebug() << "Rollback" <<
-                      QSqlDatabase::database().rollback();
-            return;
-        }
-    }
+    startExportProgress( m_exporter->startQueryExport( fileName
+                                                       , "SELECT request.isbn, book.title, request.quantity, request.clerk_id "
+                                                         "FROM request JOIN book ON book.isbn = request.isbn "
+                                                         "ORDER BY request.isbn" ) );
+}
 
+void MainWindow::exportHistory()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
 
-    const bool commit = QSqlDatabase::database().commit();
-    qDebug() << "Commit: " << commit;
-    if (!commit) {
-        qDebug() << "Rollback" <<
-                  QSqlDatabase::database().rollback();
+    const QString fileName = askExportFileName( tr("Export Sales History"), "history" );
+    if (fileName.isEmpty())
         return;
-    }
-
-    m_bundledISBNs.clear();
-    m_bundledDiscounts.clear();
-    m_bundledPrices.clear();
-    m_bundleBookModel->setStringList( QStringList() );
-    m_isBundleUnderConstruction = false;
-    m_saveBundleAction->setVisible( false );
 
+    // purchases that have been rolled up are exported as daily totals
+    startExportProgress( m_exporter->startQueryExport( fileName
+                                                       , "SELECT isbn, purchasing_date, 1 sold "
+                                                         "FROM history_of_purchasing "
+                                                         "UNION ALL "
+                                                         "SELECT isbn, sale_date, sold "
+                                                         "FROM daily_sales" ) );
 }
 
-void MainWindow::discountReset()
+void MainWindow::exportProgressed(const qint64 rows)
 {
-    const int row = m_bundleBookSelectionModel->currentIndex().row();
-
-    const qreal newValue = (1.0 - m_bundledDiscounts.at( row )) * m_bundledPrices.at( row );
-
-    ui->discountSpin->setValue( static_cast< uint >(100 * m_bundledDiscounts.at( row )));
-    ui->discountedPriceLabel->setText( QString::number( newValue, 'f', 2));
+    m_exportProgress->setLabelText( tr("Exported %1 row(s)...").arg( rows ) );
+}
 
-    ui->saveDiscountButton->setEnabled( false );
+void MainWindow::exportFinished(const bool ok, const qint64 rows, const QString &error)
+{
+    m_exportProgress->reset();
+    m_exportProgress->hide();
 
+    if (ok)
+        statusBar()->showMessage( tr("%1 row(s) exported.").arg( rows ) );
+    else
+        QMessageBox::warning( this, tr("Export"), tr("Export has failed: %1").arg( error ) );
 }
 
-void MainWindow::discountSave()
+void MainWindow::importSupplierFeed()
 {
-    const int row = m_bundleBookSelectionModel->currentIndex().row();
-
-    const qreal oldValue = (1.0 - m_bundledDiscounts.at( row )) * m_bundledPrices.at( row );
-    const qreal newValue = 0.01 * static_cast< qreal >(100 - ui->discountSpin->value()) * m_bundledPrices.at( row );
-    const qreal delta = newValue - oldValue;
+    DebugHelper debugHelper( Q_FUNC_INFO );
 
-    ui->totalLabel->setText( QString::number(
-                                 ui->totalLabel->text().toDouble() + delta
-                                 , 'f', 2
-                                 ));
+    if (m_importer->isRunning())
+    {
+        QMessageBox::information( this, tr("Import"), tr("Another import is still running.") );
+        return;
+    }
 
-    ui->savingsLabel->setText( QString::number(
-                                   ui->savingsLabel->text().toDouble() - delta
-                                   , 'f', 2
-                                   ));
+    const QString fileName = QFileDialog::getOpenFileName( this, tr("Import Supplier Feed")
+                                                           , QStandardPaths::writableLocation( QStandardPaths::DocumentsLocation )
+                                                           , tr("CSV (*.csv);;All files (*)") );
+    if (fileName.isEmpty())
+        return;
 
-    m_bundledDiscounts[ row ] = 0.01 * static_cast< qreal>( ui->discountSpin->value() );
+    if (!m_importer->start( fileName ))
+        return;
 
-    ui->saveDiscountButton->setEnabled( false );
+    m_importProgress->setLabelText( tr("Importing...") );
+    m_importProgress->show();
 }
 
-void MainWindow::discountChanged(const int value)
+void MainWindow::importProgressed(const qint64 lines)
 {
-    const int row = m_bundleBookSelectionModel->currentIndex().row();
+    m_importProgress->setLabelText( tr("Read %1 line(s)...").arg( lines ) );
+}
 
-    const qreal discount = 0.01 * static_cast< qreal >( value );
+void MainWindow::importFinished(const bool ok, const qint64 updated, const qint64 rejected, const QString &error)
+{
+    m_importProgress->reset();
+    m_importProgress->hide();
 
-    const qreal price = ( 1.0 - discount ) * m_bundledPrices.at( row );
+    if (!ok)
+    {
+        QMessageBox::warning( this, tr("Import"), tr("Import has failed, no book has been updated: %1").arg( error ) );
+        return;
+    }
 
-    ui->discountedPriceLabel->setText( QString::number( price, 'f', 2));
+    if (0 == rejected)
+        QMessageBox::information( this, tr("Import"), tr("%1 book(s) updated.").arg( updated ) );
+    else
+        QMessageBox::information( this, tr("Import")
+                                  , tr("%1 book(s) updated, %2 row(s) rejected.\nSee rejects in report next to feed.")
+                                  .arg( updated ).arg( rejected ) );
 
-    ui->saveDiscountButton->setEnabled( true );
+    if (0 != m_clerkID)
+        redrawView();
 }
 
-void MainWindow::removeFromBundle()
+void MainWindow::showDiagnostics()
 {
-    discountReset();
-
-    const int row = m_bundleBookSelectionModel->currentIndex().row();
-
-    const qreal savings = m_bundledPrices.at( row ) * m_bundledDiscounts.at( row );
+    m_diagnostics->refresh();
+    m_diagnostics->show();
+    m_diagnostics->raise();
+}
 
-    ui->savingsLabel->setText( QString::number(
-                                   ui->savingsLabel->text().toDouble() - savings
-                                   , 'f', 2));
+namespace
+{
+/**
+ * @brief requestBatchSize how many requests may be queued before they are submitted automatically
+ */
+int requestBatchSize()
+{
+    const QSettings settings( "settings.ini", QSettings::IniFormat );
+    return qMax( 1, settings.value( "requests/batchSize", 50 ).toInt() );
+}
+}
 
-    ui->totalLabel->setText( QString::number(
-                                 ui->totalLabel->text().toDouble() - m_bundledPrices.at( row ) + savings
-                                 , 'f', 2
-                                 ));
+void MainWindow::submitQueuedRequests()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
 
-    m_bundledDiscounts.removeAt( row );
-    m_bundledPrices.removeAt( row );
-    m_bundledISBNs.removeAt( row );
-    m_bundleBookModel->removeRow( row );
+    const QHash< QString, uint > requests = m_inputModel->queuedRequests();
+    if (requests.isEmpty())
+        return;
 
-    if (m_bundledISBNs.empty())
+    // requests queued meanwhile are submitted by next submission
+    if (m_queuedRequestsWatcher->isRunning())
     {
-        m_removeBookFromBundle->setVisible( false );
-        ui->currentBookBox->hide();
+        qDebug() << "Queued requests are being submitted";
+        return;
     }
+
+    m_submittedRequests = requests;
+    m_queuedRequestsWatcher->setFuture( m_dataService->upsertRequests( requests, m_clerkID ) );
+    statusBar()->showMessage( tr("Submitting %n request(s)...", 0, requests.size()) );
 }
 
-void MainWindow::addToBundle()
+void MainWindow::queuedRequestsSubmitted()
 {
     DebugHelper debugHelper( Q_FUNC_INFO );
 
-    if (!m_isBundleUnderConstruction)
+    const Workflow::Outcome outcome = m_queuedRequestsWatcher->result();
+    const QHash< QString, uint > submitted = m_submittedRequests;
+    m_submittedRequests.clear();
+
+    if (outcome.ok)
     {
-        if (QMessageBox::Yes == QMessageBox::warning( this, tr("No bundle under construction")
-                              , tr("There is no bundle under construction. Want to create new?")
-                              , QMessageBox::Yes, QMessageBox::Cancel) )
+        // requests that have been edited while they were submitted stay queued
+        const QHash< QString, uint >& queued = m_inputModel->queuedRequests();
+        QStringList unchanged;
+        for (QHash< QString, uint >::const_iterator it = submitted.constBegin(); submitted.constEnd() != it; ++it)
+            if (queued.contains( it.key() ) && queued.value( it.key() ) == it.value())
+                unchanged << it.key();
+        m_inputModel->dequeueRequests( unchanged );
+        statusBar()->showMessage( tr("%n request(s) submitted. Requests of other clerks were left untouched."
+                                     , 0, submitted.size()) );
+
+        // refresh request of selected book, if it was submitted
+        if (0 == ui->tabWidget->currentIndex() && submitted.contains( m_bookDetail.isbn ))
         {
-            m_bundledDiscounts.clear();
-            m_bundledISBNs.clear();
-            m_bundleBookModel->setStringList( QStringList() );
-            ui->bundleCommentEdit->clear();
-            ui->bundleNameEdit->setText( "Some Bundle Name");
-            ui->totalLabel->setText( QString::number(0.0, 'f', 2) );
-            ui->savingsLabel->setText( QString::number( 0.0, 'f', 2));
-
-            ui->tabBundleMod->setEnabled(true);
-
-            m_isBundleUnderConstruction = true;
-            m_saveBundleAction->setVisible( true );
+            m_detailShowsRequest = true;
+            m_bookDetailWatcher->setFuture( m_dataService->fetchBookDetail( m_bookDetail.isbn, lookbackDays() ) );
         }
     }
-
-    const int row = m_inputSelectionModel->currentIndex().row();
-    if (-1 == row)
+    else if (!outcome.cancelled)
     {
-        qDebug() << "No row is selected";
-        return;
+        statusBar()->clearMessage();
+        QMessageBox::critical( this, tr("Requests have not been submitted")
+                               , tr("Queued requests cannot be submitted (%1: %2). They are kept in queue.")
+                                 .arg( outcome.failedStep, outcome.error ) );
     }
 
-    const QString isbn = ui->isbnLabel->text();
-    qDebug() << "ISBN: " << isbn;
+    const AfterSubmit after = m_afterSubmit;
+    m_afterSubmit = AfterSubmitNothing;
+    if (AfterSubmitNothing == after)
+        return;
 
-    if (m_bundledISBNs.contains( isbn ))
-    {
-        qDebug() << "Already in Bundle";
-        QMessageBox::information( this, tr("Cannot add book to Bundle")
-                                  , tr("That book is already in bundle under construction."));
+    // requests that haven't been submitted are dropped only if clerk agrees
+    if (!m_inputModel->queuedRequests().isEmpty()
+            && QMessageBox::Discard != QMessageBox::warning( this, tr("Disconnect")
+                                                             , tr("%n queued request(s) have not been submitted. "
+                                                                  "Disconnect and discard them?"
+                                                                  , 0, m_inputModel->queuedRequests().size())
+                                                             , QMessageBox::Discard | QMessageBox::Cancel
+                                                             , QMessageBox::Cancel ))
         return;
-    }
 
-    const QString title = ui->titleLabel->text();
-    const qreal price   = ui->priceLabel->text().toDouble();
-    const QString year     = ui->yearLabel->text();
-    const QString publisherName( ui->publisherLabel->text() );
-    const QString authors = ui->authorsLabel->text();
+    closeSession();
+    if (AfterSubmitLogin == after)
+        processLogin();
+}
 
-    const QString bundleItem( tr("%0 by %1; %2 (%3)")
-                              .arg( title )
-                              .arg( authors )
-                              .arg( publisherName )
-                              .arg( year )
-                            );
+void MainWindow::requestEditorClosed(QWidget *editor, const QAbstractItemDelegate::EndEditHint hint)
+{
+    Q_UNUSED( editor );
 
-    m_bundledISBNs << isbn;
-    m_bundledDiscounts << 0.0;
-    m_bundledPrices << price;
+    const QModelIndex current = m_inputSelectionModel->currentIndex();
+    if (QAbstractItemDelegate::SubmitModelCache != hint
+            || !current.isValid() || InputModel::RequestColumn != current.column())
+        return;
 
-    m_bundleBookModel->insertRow( m_bundleBookModel->rowCount() );
-    QModelIndex index = m_bundleBookModel->index( m_bundleBookModel->rowCount() - 1);
-    m_bundleBookModel->setData( index, bundleItem );
+    if (requestBatchSize() <= m_inputModel->queuedRequests().size())
+        submitQueuedRequests();
 
-    ui->totalLabel->setText( QString::number(ui->totalLabel->text().toDouble() + price, 'f', 2));
+    const int nextRow = current.row() + 1;
+    if (m_inputModel->rowCount() == nextRow)
+        return;
 
-    m_addToBundleAction->setVisible( false );
+    const QModelIndex next = m_inputModel->index( nextRow, InputModel::RequestColumn );
+    m_inputSelectionModel->setCurrentIndex( next, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows );
+    ui->tableView->edit( next );
 }
 
-void MainWindow::inputViewSelectionChanged(const QModelIndex &current, const QModelIndex &previous)
+void MainWindow::queuedRequestsChanged(const int count)
 {
-    DebugHelper debugHelper( Q_FUNC_INFO );
+    m_submitRequestsAction->setVisible( 0 != count );
+    m_submitRequestsAction->setText( tr("Submit %n Queued Request(s)", 0, count) );
+}
 
-    if (current.row() == previous.row())
+void MainWindow::submitRequest(const QString &isbn, const uint request)
+{
+    DebugHelper debugHelper( Q_FUNC_INFO);
+    qDebug() << "ISBN: " << isbn;
+
+    m_requestWatcher->setFuture( m_dataService->upsertRequest( isbn, request, m_clerkID ) );
+}
+
+void MainWindow::writeRequest(const uint wanted)
+{
+    DebugHelper debugHelper( Q_FUNC_INFO);
+    qDebug() << "ISBN: " << m_bookDetail.isbn << "Wanted: " << wanted;
+
+    DataService::Request read;
+    read.isbn     = m_bookDetail.isbn;
+    read.quantity = m_bookDetail.requested;
+    read.clerkID  = m_clerkID;
+    read.version  = m_bookDetail.requestVersion;
+
+    m_requestWatcher->setFuture( m_dataService->writeRequest( read, wanted ) );
+}
+
+void MainWindow::requestWritten()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
+
+    const DataService::RequestResult result = m_requestWatcher->result();
+    if (0 == m_clerkID || result.outcome.cancelled)
+        return;
+
+    if (!result.outcome.ok)
     {
-        qDebug() << "Row has not changed";
+        QMessageBox::warning( this, tr("Request has not been changed"), tr("Request cannot be written (%1: %2).")
+                              .arg( result.outcome.failedStep, result.outcome.error ) );
         return;
     }
 
-    if (-1 == current.row())
+    // selection may have moved to another book while request was written
+    const DataService::Request& request = result.request;
+    const bool shown = m_bookDetail.isbn == request.isbn;
+    if (shown)
+        showRequest( request.quantity, request.clerkID, request.version );
+
+    if (!result.conflict)
     {
-        ui->currentBookBox->hide();
+        if (0 != request.quantity && request.clerkID != m_clerkID)
+            QMessageBox::information( this, tr("Request has not been changed")
+                                      , tr("That book has already been requested by another clerk.") );
         return;
     }
 
-    if (-1 == previous.row())
+    if (!shown)
     {
-        ui->currentBookBox->show();
+        statusBar()->showMessage( tr("Request has not been changed: it has been changed in the meantime.") );
+        return;
     }
 
-    const QString isbn = m_inputModel->record( current.row() ).value( "isbn" ).toString();
-    qDebug() << "Selected ISBN: " << isbn;
+    // detail may have been dropped while clerk was asked
+    if (resolveRequestConflict( request, result.wanted ) && m_bookDetail.isbn == request.isbn)
+        writeRequest( result.wanted );
+}
+
+bool MainWindow::resolveRequestConflict(const DataService::Request &current, const uint request)
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
+
+    if (current.quantity == request)
+    {
+        qDebug() << "Request already is as wanted";
+        return false;
+    }
+
+    if (0 == current.quantity)
+    {
+        QMessageBox::information( this, tr("Request has not been changed")
+                                  , tr("Request has been removed in the meantime. "
+                                       "Add new request if that book is still needed.") );
+        return false;
+    }
+
+    if (current.clerkID != m_clerkID)
+    {
+        QMessageBox::information( this, tr("Request has not been changed")
+                                  , tr("That book has already been requested by another clerk.") );
+        return false;
+    }
+
+    const QString question = (0 == request)
+            ? tr("Request has been changed to %1 since it was read. Remove it anyway?").arg( current.quantity )
+            : tr("Request has been changed to %1 since it was read. Change it to %2 anyway?")
+              .arg( current.quantity ).arg( request );
+    return QMessageBox::Retry == QMessageBox::question( this, tr("Request has been changed"), question
+                                                        , QMessageBox::Retry | QMessageBox::Cancel
+                                                        , QMessageBox::Retry );
+}
+
+void MainWindow::bookDetailFetched()
+{
+    const BookDetail detail = m_bookDetailWatcher->result();
+    if (detail.isbn.isEmpty())
+    {
+        statusBar()->showMessage( tr("Detail of book cannot be read.") );
+        return;
+    }
+
+    // selection may have moved to another book (or tab) while detail was read
+    QString selectedISBN;
+    if (m_detailShowsRequest)
+    {
+        const QModelIndex current = m_inputSelectionModel->currentIndex();
+        if (0 == ui->tabWidget->currentIndex() && current.isValid())
+            selectedISBN = m_inputModel->isbn( current.row() );
+    }
+    else
+    {
+        const QModelIndex current = m_bundleBookSelectionModel->currentIndex();
+        if (1 == ui->tabWidget->currentIndex() && current.isValid())
+            selectedISBN = m_bundleBookModel->item( current.row() ).isbn;
+    }
+    if (0 == m_clerkID || detail.isbn != selectedISBN)
+    {
+        qDebug() << "Detail is outdated: " << detail.isbn;
+        return;
+    }
+
+    m_bookDetail = detail;
+    showBookDetail( detail );
+    // actions for selected book are shown only when its detail is here
+    if (m_detailShowsRequest)
+    {
+        showRequest( detail.requested, detail.requestClerkID, detail.requestVersion );
+        m_addToBundleAction->setVisible( !m_bundleBookModel->contains( detail.isbn ) );
+    }
+}
+
+void MainWindow::showBookDetail(const BookDetail &detail)
+{
+    ui->isbnLabel->setText( detail.isbn );
+    ui->titleLabel->setText( detail.title );
+    ui->quantityLabel->setText( QString::number( detail.quantity ));
+    ui->priceLabel->setText( QString::number( detail.price, 'f', 2));
+    ui->yearLabel->setText( QString::number( detail.year ));
+    ui->publisherLabel->setText( detail.publisherName );
+    ui->soldLabel->setText( QString::number( detail.sold ) );
+    ui->authorsLabel->setText( detail.authors.join( ", " ) );
+}
+
+void MainWindow::showRequest(const uint requestedAmmount, const uint clerkID, const uint version)
+{
+    m_bookDetail.requested      = requestedAmmount;
+    m_bookDetail.requestClerkID = clerkID;
+    m_bookDetail.requestVersion = version;
 
-    DBOpener dBOpener( this );
-
-    QString title;
-    uint quantity;
-    qreal price;
-    uint year;
-    QString publisherName;
-    findBookInfo( isbn, title, quantity, price, year, publisherName);
-
-    const uint sold = m_inputModel->record( current.row() ).value( "sold" ).toUInt();
-    const QStringList authors = findAuthorsForBook( isbn );
-
-    ui->isbnLabel->setText( isbn );
-    ui->titleLabel->setText( title );
-    ui->quantityLabel->setText( QString::number( quantity ));
-    ui->priceLabel->setText( QString::number( price, 'f', 2));
-    ui->yearLabel->setText( QString::number( year ));
-    ui->publisherLabel->setText( publisherName );
-    ui->soldLabel->setText( QString::number( sold ) );
-    ui->authorsLabel->setText( authors.join( ", " ) );
-
-    uint clerkID;
-    const uint requestedAmmount = findRequestedAmmount( isbn, clerkID);
     if (0 == requestedAmmount) // No request found
     {
         ui->requestedLabel->setText( tr("None"));
@@ -879,18 +1225,312 @@ void MainWindow::inputViewSelectionChanged(const QModelIndex &current, const QMo
         m_modifyRequestAction->setVisible( clerkID == m_clerkID );
         m_removeRequestAction->setVisible( clerkID == m_clerkID );
     }
+}
+
+void MainWindow::saveBundle()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
+
+    if (!m_isBundleUnderConstruction || m_bundleBookModel->isEmpty() || ui->bundleNameEdit->text().isNull()) {
+        // can't do shit
+        return;
+    }
+
+    if (m_saveBundleWatcher->isRunning() || m_loadBundleWatcher->isRunning())
+        return;
 
-    if (m_bundledISBNs.contains(isbn))
+    DataService::Bundle bundle;
+    bundle.bundleID = m_editedBundleID;
+    bundle.name     = ui->bundleNameEdit->text();
+    bundle.comment  = ui->bundleCommentEdit->toPlainText();
+    if (0 == m_editedBundleID)
     {
-        m_addToBundleAction->setVisible( false );
+        bundle.isbns     = m_bundleBookModel->isbns();
+        bundle.netCents  = m_bundleBookModel->netCents();
+        bundle.discounts = m_bundleBookModel->discounts();
+    }
+    else
+        bundle.changes = m_bundleBookModel->changes();
+
+    m_saveBundleAction->setEnabled( false );
+    ui->tabBundleMod->setEnabled( false );
+    m_saveBundleWatcher->setFuture( m_dataService->saveBundle( bundle ) );
+}
+
+void MainWindow::bundleSaved()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
+
+    m_saveBundleAction->setEnabled( true );
+    ui->tabBundleMod->setEnabled( true );
+
+    const Workflow::Outcome outcome = m_saveBundleWatcher->result();
+    if (outcome.cancelled)
+        return;
+    if (!outcome.ok)
+    {
+        QMessageBox::warning( this, tr("Save Bundle"), tr("Bundle has not been saved (%1: %2).")
+                              .arg( outcome.failedStep, outcome.error ) );
         return;
     }
 
-    m_addToBundleAction->setVisible( true );
+    m_bundleBookModel->clear();
+    m_isBundleUnderConstruction = false;
+    m_editedBundleID = 0;
+    m_saveBundleAction->setVisible( false );
+    showBundlePricingActions( false );
+    updateBundleTotals();
 }
 
-void MainWindow::bundledBookViewSelectionChanged(const QModelIndex &current, const QModelIndex &previous)
+void MainWindow::editBundle()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
+
+    const uint bundleID = m_bundleBrowserModel->bundleID( ui->bundlesView->currentIndex() );
+    if (0 == bundleID)
+    {
+        qDebug() << "No bundle is selected";
+        return;
+    }
+
+    if (m_saveBundleWatcher->isRunning() || m_loadBundleWatcher->isRunning())
+    {
+        qDebug() << "Bundle is being saved (or loaded)";
+        return;
+    }
+
+    if (m_isBundleUnderConstruction && bundleID != m_editedBundleID
+            && QMessageBox::Yes != QMessageBox::warning( this, tr("Bundle under construction")
+                                                         , tr("Changes of bundle under construction will be lost. Continue?")
+                                                         , QMessageBox::Yes, QMessageBox::Cancel) )
+        return;
+
+    m_editBundleAction->setEnabled( false );
+    m_loadBundleWatcher->setFuture( m_dataService->loadBundle( bundleID ) );
+}
+
+void MainWindow::bundleLoaded()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
+
+    m_editBundleAction->setEnabled( true );
+
+    const DataService::BundleContent bundle = m_loadBundleWatcher->result();
+    if (0 == m_clerkID)
+        return;
+
+    if (!bundle.ok)
+    {
+        QMessageBox::critical( this, tr("Cannot edit bundle"), tr("That bundle cannot be read from database.") );
+        return;
+    }
+
+    m_bundleBookModel->clear();
+    m_bundleBookModel->appendItems( bundle.items );
+    m_bundleBookModel->markLoaded();
+
+    ui->bundleNameEdit->setText( bundle.name );
+    ui->bundleCommentEdit->setPlainText( bundle.comment );
+    updateBundleTotals();
+
+    ui->tabBundleMod->setEnabled( true );
+    m_isBundleUnderConstruction = true;
+    m_editedBundleID = bundle.bundleID;
+    m_saveBundleAction->setVisible( true );
+
+    ui->tabWidget->setCurrentIndex( 1 );
+}
+
+void MainWindow::updateBundleTotals()
+{
+    const BundlePricing::Totals totals = BundlePricing( *m_bundleBookModel ).totals();
+
+    ui->totalLabel->setText( BundlePricing::format( totals.netCents ));
+    ui->savingsLabel->setText( BundlePricing::format( totals.savingsCents() ));
+}
+
+void MainWindow::discountReset()
+{
+    const int row = m_bundleBookSelectionModel->currentIndex().row();
+    if (-1 == row)
+        return;
+    const BundleModel::Item& item = m_bundleBookModel->item( row );
+
+    ui->discountSpin->setValue( BundlePricing::percent( BundlePricing::toCents( item.price ), item.netCents ));
+    ui->discountedPriceLabel->setText( BundlePricing::format( item.netCents ));
+
+    ui->saveDiscountButton->setEnabled( false );
+
+}
+
+void MainWindow::discountSave()
+{
+    const int row = m_bundleBookSelectionModel->currentIndex().row();
+
+    m_bundleBookModel->setNetCents( row, BundlePricing::netCents( BundlePricing::toCents( m_bundleBookModel->item( row ).price )
+                                                                , ui->discountSpin->value() ) );
+    updateBundleTotals();
+
+    ui->saveDiscountButton->setEnabled( false );
+}
+
+void MainWindow::discountChanged(const int value)
+{
+    const int row = m_bundleBookSelectionModel->currentIndex().row();
+    if (-1 == row)
+        return;
+
+    const qint64 price = BundlePricing::netCents( BundlePricing::toCents( m_bundleBookModel->item( row ).price ), value );
+
+    ui->discountedPriceLabel->setText( BundlePricing::format( price ));
+
+    ui->saveDiscountButton->setEnabled( true );
+}
+
+void MainWindow::discountAll()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
+
+    bool ok = false;
+    const int percent = QInputDialog::getInt( this, tr("Discount All"), tr("Discount for every book (%):")
+                                              , ui->discountSpin->value(), ui->discountSpin->minimum()
+                                              , ui->discountSpin->maximum(), 1, &ok );
+    if (!ok)
+        return;
+
+    BundlePricing pricing( *m_bundleBookModel );
+    pricing.applyPercent( percent );
+    m_bundleBookModel->setNetCents( pricing.netCents() );
+
+    updateBundleTotals();
+    discountReset();
+}
+
+void MainWindow::discountToTarget()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
+
+    BundlePricing pricing( *m_bundleBookModel );
+    const BundlePricing::Totals totals = pricing.totals();
+
+    bool ok = false;
+    const double target = QInputDialog::getDouble( this, tr("Discount to Total"), tr("Price of bundle:")
+                                                   , 0.01 * totals.netCents, 0.0, 0.01 * totals.listCents, 2, &ok );
+    if (!ok)
+        return;
+
+    if (!pricing.applyTargetTotal( BundlePricing::toCents( target ) ))
+    {
+        QMessageBox::information( this, tr("Cannot discount bundle")
+                                  , tr("Price of bundle can't be higher than list price of its books."));
+        return;
+    }
+    m_bundleBookModel->setNetCents( pricing.netCents() );
+
+    updateBundleTotals();
+    discountReset();
+}
+
+void MainWindow::discountByAge()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
+
+    BundlePricing pricing( *m_bundleBookModel );
+    pricing.applyAgeTiers( BundlePricing::ageTiersFromSettings(), QDate::currentDate().year() );
+    m_bundleBookModel->setNetCents( pricing.netCents() );
+
+    updateBundleTotals();
+    discountReset();
+}
+
+void MainWindow::removeFromBundle()
+{
+    discountReset();
+
+    QList< int > rows;
+    const QModelIndexList selected = m_bundleBookSelectionModel->selectedRows();
+    for (int i( 0 ); selected.size() != i; ++i)
+        rows << selected.at( i ).row();
+    if (rows.isEmpty())
+        rows << m_bundleBookSelectionModel->currentIndex().row();
+
+    m_bundleBookModel->removeItems( rows );
+    updateBundleTotals();
+
+    m_removeBookFromBundle->setVisible( false );
+    ui->currentBookBox->hide();
+}
+
+void MainWindow::addToBundle()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
+
+    if (!m_isBundleUnderConstruction)
+    {
+        if (QMessageBox::Yes == QMessageBox::warning( this, tr("No bundle under construction")
+                              , tr("There is no bundle under construction. Want to create new?")
+                              , QMessageBox::Yes, QMessageBox::Cancel) )
+        {
+            m_bundleBookModel->clear();
+            ui->bundleCommentEdit->clear();
+            ui->bundleNameEdit->setText( "Some Bundle Name");
+            updateBundleTotals();
+
+            ui->tabBundleMod->setEnabled(true);
+
+            m_isBundleUnderConstruction = true;
+            m_editedBundleID = 0;
+            m_saveBundleAction->setVisible( true );
+        }
+    }
+
+    const int row = m_inputSelectionModel->currentIndex().row();
+    if (-1 == row)
+    {
+        qDebug() << "No row is selected";
+        return;
+    }
+
+    const QString& isbn = m_inputModel->isbn( row );
+    qDebug() << "ISBN: " << isbn;
+    if (m_bookDetail.isbn != isbn)
+    {
+        qDebug() << "Detail of book has not arrived yet";
+        return;
+    }
+
+    if (m_bundleBookModel->contains( isbn ))
+    {
+        qDebug() << "Already in Bundle";
+        QMessageBox::information( this, tr("Cannot add book to Bundle")
+                                  , tr("That book is already in bundle under construction."));
+        return;
+    }
+
+    BundleModel::Item item;
+    item.isbn      = isbn;
+    item.title     = m_bookDetail.title;
+    item.authors   = m_bookDetail.authors.join( ", " );
+    item.publisher = m_bookDetail.publisherName;
+    item.year      = m_bookDetail.year;
+    item.price     = m_bookDetail.price;
+    item.netCents  = BundlePricing::toCents( item.price );
+
+    m_bundleBookModel->appendItems( QVector< BundleModel::Item >() << item );
+    updateBundleTotals();
+
+    m_addToBundleAction->setVisible( false );
+}
+
+void MainWindow::inputViewSelectionChanged(const QModelIndex &current, const QModelIndex &previous)
 {
+    DebugHelper debugHelper( Q_FUNC_INFO );
+
+    // typed digits go to Request column, whatever column was clicked
+    if (current.isValid() && InputModel::RequestColumn != current.column())
+        m_inputSelectionModel->setCurrentIndex( m_inputModel->index( current.row(), InputModel::RequestColumn )
+                                                , QItemSelectionModel::NoUpdate );
+
     if (current.row() == previous.row())
     {
         qDebug() << "Row has not changed";
@@ -908,127 +1548,264 @@ void MainWindow::bundledBookViewSelectionChanged(const QModelIndex &current, con
         ui->currentBookBox->show();
     }
 
-    const QString& isbn = m_bundledISBNs.at( current.row() );
+    const QString isbn = m_inputModel->isbn( current.row() );
     qDebug() << "Selected ISBN: " << isbn;
 
-    DBOpener dBOpener( this );
+    // detail of previous book must not be acted on: actions come back with detail of selected one
+    m_bookDetail = BookDetail();
+    m_fillRequestAction->setVisible( false );
+    m_modifyRequestAction->setVisible( false );
+    m_removeRequestAction->setVisible( false );
+    m_addToBundleAction->setVisible( false );
+
+    m_detailShowsRequest = true;
+    m_bookDetailWatcher->setFuture( m_dataService->fetchBookDetail( isbn, lookbackDays() ) );
+}
+
+void MainWindow::bundledBookViewSelectionChanged(const QModelIndex &current, const QModelIndex &previous)
+{
+    if (current.row() == previous.row())
+    {
+        qDebug() << "Row has not changed";
+        return;
+    }
+
+    if (-1 == current.row())
+    {
+        ui->currentBookBox->hide();
+        return;
+    }
 
-    QString title;
-    uint quantity;
-    qreal price;
-    uint year;
-    QString publisherName;
-    findBookInfo( isbn, title, quantity, price, year, publisherName);
+    if (-1 == previous.row())
+    {
+        ui->currentBookBox->show();
+    }
 
-    const uint sold = m_inputModel->record( current.row() ).value( "sold" ).toUInt();
-    const QStringList authors = findAuthorsForBook( isbn );
+    const BundleModel::Item& item = m_bundleBookModel->item( current.row() );
+    const QString& isbn = item.isbn;
+    qDebug() << "Selected ISBN: " << isbn;
 
-    ui->isbnLabel->setText( isbn );
-    ui->titleLabel->setText( title );
-    ui->quantityLabel->setText( QString::number( quantity ));
-    ui->priceLabel->setText( QString::number( price, 'f', 2));
-    ui->yearLabel->setText( QString::number( year ));
-    ui->publisherLabel->setText( publisherName );
-    ui->soldLabel->setText( QString::number( sold ) );
-    ui->authorsLabel->setText( authors.join( ", " ) );
+    m_detailShowsRequest = false;
+    m_bookDetailWatcher->setFuture( m_dataService->fetchBookDetail( isbn, lookbackDays() ) );
 
-    ui->discountSpin->setValue( m_bundledDiscounts.at( current.row() ));
+    ui->discountSpin->setValue( BundlePricing::percent( BundlePricing::toCents( item.price ), item.netCents ));
 
-    ui->discountedPriceLabel->setText( QString::number(
-                                           (1.0 - m_bundledDiscounts.at( current.row() ) ) * m_bundledPrices.at( current.row() )
-                                           , 'f', 2 ) );
+    ui->discountedPriceLabel->setText( BundlePricing::format( item.netCents ));
 
     m_removeBookFromBundle->setVisible( true );
 }
 
 void MainWindow::processLogin()
 {
-    disconnectClerk();
+    // login continues once queued requests have been submitted
+    if (!submitBeforeDisconnect( AfterSubmitLogin ))
+        return;
+    closeSession();
+
+    if (!QSqlDatabase::contains())
+        setupConnection();
+    // connections that login and filter will use are opened while login dialog is shown
+    m_dataService->warmUp();
 
     m_login->clear();
     if (QDialog::Accepted == m_login->exec())
     {
-        DBOpener dbopener( this );
+        const QString userName = m_login->userName();
+        const QString password = m_login->password();
+        m_login->clear();
 
-        qDebug() << "Trying to login with ID: " << m_login->userName() << "; and passwordHash = " <<
-                    m_login->passwordHash();
+        qDebug() << "Trying to login with ID: " << userName;
 
-        QSqlQuery searchPasswordHash;
-        searchPasswordHash.setForwardOnly( true );
-        qDebug() << "Prepare: " <<
-                    searchPasswordHash.prepare( "SELECT COUNT(*) "
-                                                "FROM clerk "
-                                                "WHERE clerk_id = :clerkID "
-                                                "AND password_hash = :passwordHash ");
-        searchPasswordHash.bindValue( ":clerkID", m_login->userName() );
-        searchPasswordHash.bindValue( ":passwordHash", m_login->passwordHash() );
-
-        qDebug() << "Exec: " << searchPasswordHash.exec();
-        qDebug() << "First: "<< searchPasswordHash.first();
-
-        if (1 == searchPasswordHash.value( 0 ).toUInt())
+        if (SessionToken::verify( sessionKey(), userName, password ))
         {
-            m_clerkID = m_login->userName().toUInt();
+            qDebug() << "Session token is valid";
+            m_clerkID = userName.toUInt();
             emit connected();
+            return;
         }
-        else
-        {
-            m_clerkID = 0;
-            if (QMessageBox::Retry ==
-                    QMessageBox::critical( this
-                                           , tr("Login error")
-                                           , tr("User with provided credentials does not exist! Retry?")
-                                           , QMessageBox::Retry | QMessageBox::Cancel)
-                    )
-                QTimer::singleShot(10, this, SLOT(processLogin()));
-        }
+
+        m_loginWatcher->setFuture( m_dataService->login( userName, password, sessionKey() ) );
+        statusBar()->showMessage( tr("Logging in...") );
     }
 }
 
+void MainWindow::loginFinished()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
+    statusBar()->clearMessage();
+
+    const DataService::LoginResult result = m_loginWatcher->result();
+    if (result.outcome.cancelled)
+        return;
+
+    if (result.authenticated)
+    {
+        m_clerkID = result.clerkID.toUInt();
+        emit connected();
+        return;
+    }
+
+    m_clerkID = 0;
+    const QString reason = result.outcome.ok ? tr("User with provided credentials does not exist!")
+                                             : tr("Cannot verify credentials (%1: %2).")
+                                               .arg( result.outcome.failedStep, result.outcome.error );
+    if (QMessageBox::Retry ==
+            QMessageBox::critical( this
+                                   , tr("Login error")
+                                   , reason + " " + tr("Retry?")
+                                   , QMessageBox::Retry | QMessageBox::Cancel)
+            )
+        QTimer::singleShot(10, this, SLOT(processLogin()));
+}
+
 void MainWindow::redrawView()
 {
     DebugHelper debugHelper( Q_FUNC_INFO);
-    DBOpener dbopener( this );
-
-    QSqlQuery simpleSearch;
-    qDebug() << "Prepare: " <<
-                simpleSearch.prepare( "SELECT b.isbn, COUNT(purchasing_date) sold, MAX(quantity) "
-                                      "FROM book b LEFT JOIN history_of_purchasing h ON h.isbn = b.isbn "
-                                      "WHERE (quantity BETWEEN :fromStock AND :toStock) "
-                                      "AND (purchasing_date IS NULL OR purchasing_date >= trunc(sysdate - 7)) "
-                                      "GROUP BY b.isbn "
-                                      "HAVING count(*) BETWEEN :fromBought AND :toBought");
-    simpleSearch.bindValue(":fromBought",
-                           ui->boughtMoreThanBox->isChecked() ?
-                               ui->boughtMoreThenSpin->value()
-                             : -1
-                               );
-    simpleSearch.bindValue(":toBought",
-                           ui->boughtLessThanBox->isChecked() ?
-                               ui->boughtLessThenSpin->value()
-                             : 9000
-                               );
-    simpleSearch.bindValue(":fromStock",
-                           ui->instockMoreThanBox->isChecked() ?
-                               ui->instockMoreThenSpin->value()
-                             : 0
-                               );
-    simpleSearch.bindValue(":toStock",
-                           ui->instockLessThanBox->isChecked() ?
-                               ui->instockLessThenSpin->value()
-                             : 9000
-                               );
-
-    qDebug() << "Exec: " << simpleSearch.exec();
-
-    qDebug() << simpleSearch.lastError();
-
-    m_inputModel->setQuery(simpleSearch);
-    m_inputModel->setHeaderData( 0, Qt::Horizontal, tr("ISBN") );
-    m_inputModel->setHeaderData( 1, Qt::Horizontal, tr("Sold"));
-    m_inputModel->setHeaderData( 2, Qt::Horizontal, tr("Quantity"));
+
+    // other stores are queried on worker threads while local queries run (unless their stock is fresh)
+    m_storeInventory->startFetch();
+
+    DataService::FilterParams params;
+    params.fromStock = ui->instockMoreThanBox->isChecked() ? ui->instockMoreThenSpin->value() : 0;
+    params.toStock   = ui->instockLessThanBox->isChecked() ? ui->instockLessThenSpin->value() : 9000;
+    params.cacheKey  = sessionKey();
+    // rows of the same bounds are kept while data hasn't moved
+    if (!m_stockReleased && m_stockParams.fromStock == params.fromStock && m_stockParams.toStock == params.toStock)
+        params.knownFreshness = m_stockParams.knownFreshness;
+    m_stockParams = params;
+
+    // result of previous (still running) filter is dropped
+    m_filterWatcher->setFuture( m_dataService->runFilter( params ) );
+    statusBar()->showMessage( tr("Refreshing...") );
+}
+
+void MainWindow::filterFetched()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO);
+
+    if (0 == m_clerkID)
+        return;
+
+    const DataService::FilterResult result = m_filterWatcher->result();
+    if (!result.ok)
+    {
+        statusBar()->showMessage( tr("Filter query has failed.") );
+        return;
+    }
+
+    m_stockParams.knownFreshness = result.freshness;
+    // rows that are already here are filtered again (bought bounds may have changed)
+    if (result.unchanged)
+    {
+        applyFilter();
+        return;
+    }
+
+    m_stockISBNs      = result.isbns;
+    m_stockQuantities = result.quantities;
+    m_salesHistogram  = result.histogram;
+    m_stockReleased   = false;
+    if (MemoryBudget::isEnabled())
+        m_releaseTimer->start();
+
+    applyFilter();
+    saveSession();
+}
+
+void MainWindow::storesFetched(const int answered)
+{
+    DebugHelper debugHelper( Q_FUNC_INFO);
+    qDebug() << "Stores: " << answered;
+
+    // stock of other stores that arrives after local rows is shown by filtering them again
+    if (0 == m_clerkID || 0 == answered || m_stockReleased || m_stockISBNs.isEmpty())
+        return;
+
+    applyFilter();
+}
+
+void MainWindow::applyFilter()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO);
+
+    const uint days = lookbackDays();
+    const uint fromBought = ui->boughtMoreThanBox->isChecked() ?
+                ui->boughtMoreThenSpin->value()
+              : 0;
+    const uint toBought = ui->boughtLessThanBox->isChecked() ?
+                ui->boughtLessThenSpin->value()
+              : std::numeric_limits< uint >::max();
+
+    QVector< QString > isbns;
+    QVector< uint > sold;
+    QVector< uint > quantities;
+    for (int i( 0 ); m_stockISBNs.size() != i; ++i)
+    {
+        const uint bookSold = m_salesHistogram.sold( m_stockISBNs.at( i ), days );
+        if (bookSold < fromBought || toBought < bookSold)
+            continue;
+
+        isbns      << m_stockISBNs.at( i );
+        sold       << bookSold;
+        quantities << m_stockQuantities.at( i );
+    }
+
+    const QModelIndex current = m_inputSelectionModel->currentIndex();
+    const QString currentISBN = current.isValid() ? m_inputModel->isbn( current.row() ) : QString();
+
+    m_inputModel->setRows( isbns, sold, quantities, m_storeInventory->quantities( isbns ) );
     statusBar()->showMessage(tr("%1 row(s) were found.").arg(m_inputModel->rowCount()));
     ui->tableView->resizeColumnsToContents();
+
+    // keep selected book selected if it is still there
+    if (!currentISBN.isEmpty())
+    {
+        const int row = m_inputModel->rowOf( currentISBN );
+        if (-1 != row)
+            m_inputSelectionModel->setCurrentIndex( m_inputModel->index( row, 0 )
+                                                    , QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows );
+        else if (0 == ui->tabWidget->currentIndex())
+            ui->currentBookBox->hide();
+    }
+}
+
+uint MainWindow::lookbackDays() const
+{
+    const uint days = ui->lookbackCombo->itemData( ui->lookbackCombo->currentIndex() ).toUInt();
+    return (0 == days) ? 7 : days;
+}
+
+void MainWindow::lookbackChanged(const int index)
+{
+    qDebug() << "Lookback window: " << ui->lookbackCombo->itemData( index ).toUInt();
+
+    ui->soldCaptionLabel->setText( tr("Sold in last %n day(s):", 0, lookbackDays()) );
+    if (m_stockReleased)
+        redrawView();
+    else
+        applyFilter();
+}
+
+void MainWindow::releaseOffscreenResults()
+{
+    DebugHelper debugHelper( Q_FUNC_INFO );
+    qDebug() << "Heap before release: " << MemoryBudget::heap().inUseBytes;
+
+    // rows shown in input view stay; raw stock rows are needed only to re-filter them
+    m_stockISBNs.clear();
+    m_stockISBNs.squeeze();
+    m_stockQuantities.clear();
+    m_stockQuantities.squeeze();
+    m_salesHistogram.clear();
+    m_stockParams.knownFreshness.clear();
+    m_stockReleased = true;
+
+    if (2 != ui->tabWidget->currentIndex())
+        m_bundleBrowserModel->clear();
+
+    StringPool::clear();
+    MemoryBudget::trim();
+    qDebug() << "Heap after release: " << MemoryBudget::heap().inUseBytes;
 }
 
 void MainWindow::connectFilters() const
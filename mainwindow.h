@@ -1,6 +1,13 @@
 #pragma once
 
 #include <QMainWindow>
+#include <QVector>
+#include <QAbstractItemDelegate>
+#include <QFutureWatcher>
+#include <QHash>
+
+#include "dataservice.h"
+#include "saleshistogram.h"
 
 namespace Ui {
 class MainWindow;
@@ -8,13 +15,20 @@ class MainWindow;
 
 class LoginDialog;
 class FillRequestDialog;
-class QSqlQueryModel;
+class DiagnosticsDialog;
+class InputModel;
 class QButtonGroup;
 class QItemSelectionModel;
 class QStringList;
 class QModelIndex;
 class QAction;
-class QStringListModel;
+class BundleModel;
+class BundleBrowserModel;
+class StoreInventory;
+class ResultExporter;
+class SupplierImporter;
+class QProgressDialog;
+class QTimer;
 
 class MainWindow : public QMainWindow
 {
@@ -25,11 +39,27 @@ public:
     ~MainWindow();
     
 private:
+    /**
+     * @brief The AfterSubmit enum what is done once queued requests have been submitted
+     */
+    enum AfterSubmit
+    {
+        AfterSubmitNothing,
+        AfterSubmitDisconnect,
+        AfterSubmitLogin
+    };
+
     Ui::MainWindow *ui;
     /**
      * @brief m_clerkID ID number of connected clerk
      */
     uint m_clerkID;
+    /**
+     * @brief m_bookDetail detail of book shown in current book panel (isbn is empty until one arrives).
+     * Actions for selected book work with it; request is modified or removed only if its version
+     * hasn't changed since it was read
+     */
+    BookDetail m_bookDetail;
     /**
      * @brief fillRequestAction Action for filling new request for book
      */
@@ -42,12 +72,26 @@ private:
      * @brief  Action for removing request for book
      */
     QAction *m_removeRequestAction;
+    /**
+     * @brief m_submitRequestsAction Action that submits requests queued in Request column of input view
+     */
+    QAction *m_submitRequestsAction;
     /**
      * @brief m_addToBundleAction Action that adds book to bundle under construction
      */
     QAction *m_addToBundleAction;
     QAction *m_removeBookFromBundle;
     QAction *m_saveBundleAction;
+    /**
+     * @brief m_editBundleAction Action that loads bundle selected in bundle selection pane for modification
+     */
+    QAction *m_editBundleAction;
+    /**
+     * @brief m_discountAllAction, m_targetTotalAction, m_ageDiscountAction bulk pricing of bundle under construction
+     */
+    QAction *m_discountAllAction;
+    QAction *m_targetTotalAction;
+    QAction *m_ageDiscountAction;
     /**
      * @brief m_login Login dialog form
      */
@@ -56,34 +100,116 @@ private:
      * @brief m_fillRequest Fill Request form
      */
     FillRequestDialog *m_fillRequest;
+    /**
+     * @brief m_diagnostics Diagnostics window (slow statements and their plans)
+     */
+    DiagnosticsDialog *m_diagnostics;
+    /**
+     * @brief m_exporter writes filter results, requests and sales history into files on worker thread
+     */
+    ResultExporter *m_exporter;
+    QProgressDialog *m_exportProgress;
+    /**
+     * @brief m_importer applies supplier feeds (price and stock) on worker thread
+     */
+    SupplierImporter *m_importer;
+    QProgressDialog *m_importProgress;
+    /**
+     * @brief m_dataService runs all database work (filter, book detail, requests, bundles, schema checks)
+     * on its own threads
+     */
+    DataService *m_dataService;
+    QFutureWatcher< DataService::FilterResult > *m_filterWatcher;
+    QFutureWatcher< BookDetail > *m_bookDetailWatcher;
+    QFutureWatcher< Workflow::Outcome > *m_saveBundleWatcher;
+    QFutureWatcher< DataService::LoginResult > *m_loginWatcher;
+    QFutureWatcher< DataService::RequestResult > *m_requestWatcher;
+    QFutureWatcher< Workflow::Outcome > *m_queuedRequestsWatcher;
+    QFutureWatcher< DataService::BundleContent > *m_loadBundleWatcher;
+    QFutureWatcher< DataService::SchemaState > *m_schemaWatcher;
+    QFutureWatcher< bool > *m_schemaChangeWatcher;
+    /**
+     * @brief m_submittedRequests queued requests that are being submitted (they are dequeued once
+     * submitted, unless they have been edited meanwhile)
+     */
+    QHash< QString, uint > m_submittedRequests;
+    /**
+     * @brief m_afterSubmit what is done once queued requests have been submitted
+     */
+    AfterSubmit m_afterSubmit;
+    /**
+     * @brief m_detailShowsRequest whether request of book is shown with book detail that is being fetched
+     * (it is for input view, but not for bundle under construction)
+     */
+    bool m_detailShowsRequest;
     /**
      * @brief m_inputModel Model that will hold data for input view
      */
-    QSqlQueryModel *m_inputModel;
+    InputModel *m_inputModel;
     /**
      * @brief m_inputSelectionModel Selection model for m_inputModel
      */
     QItemSelectionModel *m_inputSelectionModel;
+    /**
+     * @brief m_salesHistogram daily sales of books, used to count sold books for any lookback window
+     */
+    SalesHistogram m_salesHistogram;
+    /**
+     * @brief m_stockISBNs ISBN numbers of books that have passed stock filter during last redrawView
+     */
+    QVector< QString > m_stockISBNs;
+    /**
+     * @brief m_stockQuantities quantities of books in m_stockISBNs
+     */
+    QVector< uint > m_stockQuantities;
+    /**
+     * @brief m_stockParams bounds of last filter; knownFreshness is freshness token of data m_stockISBNs
+     * have been read at (empty while they are missing or belong to other bounds)
+     */
+    DataService::FilterParams m_stockParams;
+    /**
+     * @brief m_storeInventory stock of other stores of chain (read concurrently with local stock; stores are
+     * read from settings by first login)
+     */
+    StoreInventory *m_storeInventory;
     /**
      * @brief m_filterButtons group of radio buttons for filters
      */
     QButtonGroup *m_filterButtons;
     /**
-     * @brief m_bundledISBNs ISBN numbers of books that are currently in bundle under construction (modification)
+     * @brief m_bundleBookModel books (with prices and discounts) that are currently in bundle
+     * under construction (modification)
      */
-    QStringList m_bundledISBNs;
+    BundleModel *m_bundleBookModel;
+    QItemSelectionModel *m_bundleBookSelectionModel;
     /**
-     * @brief m_bundledDiscounts discounts for books that are currently in bundle under construction (modification)
+     * @brief m_bundleBrowserModel existing bundles shown in bundle selection pane
      */
-    QList< qreal > m_bundledDiscounts;
-    QList< qreal > m_bundledPrices;
-
-    QStringListModel *m_bundleBookModel;
-    QItemSelectionModel *m_bundleBookSelectionModel;
+    BundleBrowserModel *m_bundleBrowserModel;
     /**
      * @brief m_isBundleUnderConstruction is there any bundle under construction right now
      */
     bool m_isBundleUnderConstruction;
+    /**
+     * @brief m_editedBundleID id of existing bundle that is under modification (0 if new bundle is constructed)
+     */
+    uint m_editedBundleID;
+    /**
+     * @brief m_schemaChecked whether database schema has already been checked during this run
+     */
+    bool m_schemaChecked;
+    /**
+     * @brief m_schemaUpgrades upgrades that are being applied (empty while tables are being created)
+     */
+    QList< Schema::Upgrade > m_schemaUpgrades;
+    /**
+     * @brief m_releaseTimer releases results that are not on screen (stock rows, histogram) in memory budget mode
+     */
+    QTimer *m_releaseTimer;
+    /**
+     * @brief m_stockReleased whether m_stockISBNs and histogram have been released (so they must be read again)
+     */
+    bool m_stockReleased;
 
     /**
      * @brief Setup database connection: login, host, etc
@@ -102,6 +228,79 @@ private:
      * @brief configureActions configures actions
      */
     void configureActions();
+    /**
+     * @brief applyFilter filters cached stock rows by sales during lookback window and shows them in main view
+     */
+    void applyFilter();
+    /**
+     * @brief lookbackDays selected lookback window (in days)
+     */
+    uint lookbackDays() const;
+    /**
+     * @brief submitRequest creates or modifies request for book in one round trip
+     * @param isbn ISBN number of requested book
+     * @param request how many books to request
+     */
+    void submitRequest( const QString& isbn, const uint request );
+    /**
+     * @brief writeRequest changes request of book shown in current book panel (as it has been shown)
+     * @param wanted quantity clerk wants (0 to remove request)
+     */
+    void writeRequest( const uint wanted );
+    /**
+     * @brief submitBeforeDisconnect submits queued requests before session is closed
+     * @param after what is done once they have been submitted
+     * @return true if there is nothing to submit (session may be closed right away)
+     */
+    bool submitBeforeDisconnect( const AfterSubmit after );
+    /**
+     * @brief closeSession disconnects clerk: clears all views and closes connections of data service
+     */
+    void closeSession();
+    /**
+     * @brief showBookDetail fills current book panel (request is shown separately, see showRequest)
+     */
+    void showBookDetail( const BookDetail& detail );
+    /**
+     * @brief showRequest shows requested ammount and enables actions that are allowed for that request.
+     * Request is remembered in m_bookDetail (actions modify or remove it as it was shown)
+     * @param requestedAmmount how many books are requested (0 if there is no request)
+     * @param clerkID clerk that has filled request
+     * @param version version of request
+     */
+    void showRequest( const uint requestedAmmount, const uint clerkID, const uint version );
+    /**
+     * @brief resolveRequestConflict called when request has been changed (or removed) since it was read:
+     * asks whether change should be applied on top of its current state
+     * @param current request as it is now
+     * @param request quantity clerk wants (0 to remove request)
+     * @return true if change has to be retried
+     */
+    bool resolveRequestConflict( const DataService::Request& current, const uint request );
+    /**
+     * @brief sessionKey identifies database of current session (used as key for session cache)
+     */
+    QString sessionKey() const;
+    /**
+     * @brief saveSession stores current filter and its results into local session cache
+     */
+    void saveSession() const;
+    /**
+     * @brief askExportFileName asks where to export; empty if user has cancelled
+     */
+    QString askExportFileName( const QString& title, const QString& baseName );
+    /**
+     * @brief startExportProgress shows (modeless) progress of started export
+     */
+    void startExportProgress( const bool started );
+    /**
+     * @brief updateBundleTotals shows exact total and savings of bundle under construction
+     */
+    void updateBundleTotals();
+    /**
+     * @brief showBundlePricingActions shows (or hides) bulk pricing actions
+     */
+    void showBundlePricingActions( const bool visible );
 private slots:
     /**
      * @brief processLogin (re)login into system
@@ -112,6 +311,63 @@ private slots:
      * @brief redrawView Run again select query (possibly with new parameters) and show results in main view
      */
     void redrawView();
+    /**
+     * @brief filterFetched shows results of filter query started by redrawView
+     */
+    void filterFetched();
+    /**
+     * @brief storesFetched shows stock of other stores that has been read since rows were filtered
+     * @param answered number of stores that have answered
+     */
+    void storesFetched( const int answered );
+    /**
+     * @brief bookDetailFetched fills current book panel, unless selection has moved to another book meanwhile
+     */
+    void bookDetailFetched();
+    /**
+     * @brief bundleSaved finishes saving of bundle under construction
+     */
+    void bundleSaved();
+    /**
+     * @brief loginFinished connects clerk once password has been verified (or asks to retry)
+     */
+    void loginFinished();
+    /**
+     * @brief requestWritten shows request as it is after write (or resolves conflict with request
+     * that has been changed meanwhile)
+     */
+    void requestWritten();
+    /**
+     * @brief queuedRequestsSubmitted dequeues submitted requests and closes session, if that was waiting for them
+     */
+    void queuedRequestsSubmitted();
+    /**
+     * @brief bundleLoaded puts bundle loaded by editBundle under construction
+     */
+    void bundleLoaded();
+    /**
+     * @brief schemaChecked offers to create tables or upgrade database and warns about missing indexes
+     */
+    void schemaChecked();
+    /**
+     * @brief schemaChanged reports failed creation (upgrade) of tables; upgraded database is checked again
+     */
+    void schemaChanged();
+    /**
+     * @brief releaseOffscreenResults frees results that are not on screen and returns freed heap to system
+     */
+    void releaseOffscreenResults();
+    /**
+     * @brief restoreSession shows filter and results of last session from local cache (if any)
+     * and schedules fresh query that will replace them
+     */
+    void restoreSession();
+    /**
+     * @brief checkSchema starts check of database: empty database, database created by older version
+     * and indexes that queries rely on, but that are missing (see schemaChecked).
+     * Runs once, after first login
+     */
+    void checkSchema();
 
     /**
      * @brief Dummy slots that will maintain filter controls in usable state
@@ -131,6 +387,12 @@ private slots:
      */
     void filterChanged(const int buttonId);
 
+    /**
+     * @brief lookbackChanged recomputes sales for new lookback window from cached histogram
+     * @param index index of selected window
+     */
+    void lookbackChanged(const int index);
+
     /**
      * @brief fillRequest about how many books to request for selected ISBN
      */
@@ -143,9 +405,24 @@ private slots:
      * @brief allows to remove previously filled request
      */
     void removeRequest();
+    /**
+     * @brief submitQueuedRequests submits all queued requests in one transaction (with array binds
+     * where backend has them, with multi-row upserts otherwise)
+     */
+    void submitQueuedRequests();
+    /**
+     * @brief requestEditorClosed moves editor to the next row when request is entered with Enter.
+     * Queue is submitted when it grows to "requests/batchSize" entries
+     */
+    void requestEditorClosed( QWidget *editor, const QAbstractItemDelegate::EndEditHint hint );
+    /**
+     * @brief queuedRequestsChanged shows number of queued requests
+     */
+    void queuedRequestsChanged( const int count );
 
     /**
-     * @brief disconnect_clerk Disconnect current clerk (clear all tables, etc, etc)
+     * @brief disconnect_clerk Disconnect current clerk (clear all tables, etc, etc).
+     * Queued requests are submitted first; if they can't be, clerk stays connected unless they are discarded
      */
     void disconnectClerk();
 
@@ -164,12 +441,57 @@ private slots:
      */
     void showAboutQt();
 
+    /**
+     * @brief showDiagnostics shows diagnostics window
+     */
+    void showDiagnostics();
+
+    /**
+     * @brief exportResults exports rows shown in input view
+     */
+    void exportResults();
+    /**
+     * @brief exportRequests exports all outstanding requests
+     */
+    void exportRequests();
+    /**
+     * @brief exportHistory exports whole history of purchasing: one row per recent purchase and one row
+     * per book and day for purchases that have been rolled up (see HistoryRollup)
+     */
+    void exportHistory();
+    void exportProgressed( const qint64 rows );
+    void exportFinished( const bool ok, const qint64 rows, const QString& error );
+
+    /**
+     * @brief importSupplierFeed applies prices and quantities of supplier feed to books
+     */
+    void importSupplierFeed();
+    void importProgressed( const qint64 lines );
+    void importFinished( const bool ok, const qint64 updated, const qint64 rejected, const QString& error );
+
     /**
      * @brief add_to_bundle add selected to bundle that is currently under construction (modification)
      */
     void addToBundle();
     void removeFromBundle();
     void saveBundle();
+    /**
+     * @brief editBundle loads bundle selected in bundle selection pane for modification
+     */
+    void editBundle();
+
+    /**
+     * @brief discountAll gives the same discount to every book in bundle
+     */
+    void discountAll();
+    /**
+     * @brief discountToTarget discounts books proportionally, so bundle costs exactly given total
+     */
+    void discountToTarget();
+    /**
+     * @brief discountByAge discounts books by their age (tiers are read from settings)
+     */
+    void discountByAge();
 
     /**
      * @brief selectionChanged is executed every time selection changed in input view
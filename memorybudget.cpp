@@ -0,0 +1,52 @@
+#include "memorybudget.h"
+#include <QSettings>
+#include <QDebug>
+
+#if defined( __GLIBC__ )
+#include <malloc.h>
+#endif
+
+bool MemoryBudget::isEnabled()
+{
+    const QSettings settings( "settings.ini", QSettings::IniFormat );
+    return settings.value( "memory/budgetMode", true ).toBool();
+}
+
+int MemoryBudget::releaseAfterMs()
+{
+    const QSettings settings( "settings.ini", QSettings::IniFormat );
+    return 1000 * qMax( 1, settings.value( "memory/releaseAfterSeconds", 300 ).toInt() );
+}
+
+MemoryBudget::Heap MemoryBudget::heap()
+{
+    Heap heap;
+    heap.available   = false;
+    heap.inUseBytes  = 0;
+    heap.freeBytes   = 0;
+    heap.mappedBytes = 0;
+
+#if defined( __GLIBC__ ) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const struct mallinfo2 info = mallinfo2();
+    heap.available   = true;
+    heap.inUseBytes  = info.uordblks + info.hblkhd;
+    heap.freeBytes   = info.fordblks;
+    heap.mappedBytes = info.hblkhd;
+#elif defined( __GLIBC__ )
+    // counters of mallinfo are int and wrap above 2 GiB
+    const struct mallinfo info = mallinfo();
+    heap.available   = true;
+    heap.inUseBytes  = static_cast< unsigned int >( info.uordblks ) + static_cast< unsigned int >( info.hblkhd );
+    heap.freeBytes   = static_cast< unsigned int >( info.fordblks );
+    heap.mappedBytes = static_cast< unsigned int >( info.hblkhd );
+#endif
+
+    return heap;
+}
+
+void MemoryBudget::trim()
+{
+#if defined( __GLIBC__ )
+    qDebug() << "Trim: " << malloc_trim( 0 );
+#endif
+}
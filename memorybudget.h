@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QtGlobal>
+
+/**
+ * @brief The MemoryBudget class keeps long (all-shift) sessions flat in memory. In budget mode
+ * ("memory/budgetMode" of settings.ini) results that are not on screen are released after
+ * "memory/releaseAfterSeconds" and freed heap is returned to system. Heap usage is read for diagnostics.
+ */
+class MemoryBudget
+{
+public:
+    /**
+     * @brief The Heap struct heap usage of process (as reported by allocator)
+     */
+    struct Heap
+    {
+        /**
+         * @brief available false if allocator can't report usage
+         */
+        bool available;
+        qint64 inUseBytes;
+        qint64 freeBytes;
+        qint64 mappedBytes;
+    };
+
+    static bool isEnabled();
+    /**
+     * @brief releaseAfterMs how long results that are not on screen are kept
+     */
+    static int releaseAfterMs();
+
+    static Heap heap();
+    /**
+     * @brief trim returns free heap memory to system (where allocator supports it)
+     */
+    static void trim();
+};
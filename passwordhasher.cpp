@@ -0,0 +1,99 @@
+#include "passwordhasher.h"
+#include <QPasswordDigestor>
+#include <QCryptographicHash>
+#include <QRandomGenerator>
+#include <QSettings>
+#include <QStringList>
+#include <QDebug>
+
+namespace
+{
+const char * const Scheme     = "pbkdf2-sha256";
+const int          SaltLength = 16;
+const int          KeyLength  = 32;
+}
+
+PasswordHasher::PasswordHasher(const uint iterations)
+    : m_iterations( qMax( iterations, 1u ) )
+{
+}
+
+PasswordHasher PasswordHasher::fromSettings()
+{
+    QSettings settings( "settings.ini", QSettings::IniFormat );
+    return PasswordHasher( settings.value( "security/pbkdf2Iterations", 100000 ).toUInt() );
+}
+
+QByteArray PasswordHasher::derive(const QString &password, const QByteArray &salt, const uint iterations)
+{
+    return QPasswordDigestor::deriveKeyPbkdf2( QCryptographicHash::Sha256, password.toUtf8()
+                                             , salt, iterations, KeyLength );
+}
+
+QString PasswordHasher::hash(const QString &password) const
+{
+    QByteArray salt( SaltLength, Qt::Uninitialized );
+    QRandomGenerator::system()->fillRange( reinterpret_cast< quint32* >( salt.data() ), SaltLength / sizeof( quint32 ) );
+
+    return (QStringList()
+            << Scheme
+            << QString::number( m_iterations )
+            << QString::fromLatin1( salt.toBase64() )
+            << QString::fromLatin1( derive( password, salt, m_iterations ).toBase64() )
+            ).join( "$" );
+}
+
+bool PasswordHasher::verify(const QString &password, const QString &stored, bool &needsRehash) const
+{
+    needsRehash = false;
+
+    const QStringList parts = stored.split( '$' );
+    if (4 == parts.size() && Scheme == parts.at( 0 ))
+    {
+        const uint iterations = parts.at( 1 ).toUInt();
+        const QByteArray salt = QByteArray::fromBase64( parts.at( 2 ).toLatin1() );
+        const QByteArray key  = QByteArray::fromBase64( parts.at( 3 ).toLatin1() );
+        if (0 == iterations || salt.isEmpty() || key.isEmpty())
+        {
+            qDebug() << "Malformed password hash";
+            return false;
+        }
+
+        needsRehash = iterations < m_iterations;
+        return constantTimeEquals( derive( password, salt, iterations ), key );
+    }
+
+    // legacy: unsalted MD5 in hex
+    if (32 == stored.size())
+    {
+        needsRehash = true;
+        return constantTimeEquals( QCryptographicHash::hash( password.toUtf8(), QCryptographicHash::Md5 ).toHex()
+                                 , stored.toLower().toLatin1() );
+    }
+
+    qDebug() << "Unknown password hash format";
+    return false;
+}
+
+QString PasswordHasher::dummyHash() const
+{
+    // derived key is never all zeros (in practice), so nothing matches
+    return (QStringList()
+            << Scheme
+            << QString::number( m_iterations )
+            << QString::fromLatin1( QByteArray( SaltLength, '\0' ).toBase64() )
+            << QString::fromLatin1( QByteArray( KeyLength, '\0' ).toBase64() )
+            ).join( "$" );
+}
+
+bool PasswordHasher::constantTimeEquals(const QByteArray &left, const QByteArray &right)
+{
+    if (left.size() != right.size())
+        return false;
+
+    char difference = 0;
+    for (int i( 0 ); left.size() != i; ++i)
+        difference |= left.at( i ) ^ right.at( i );
+
+    return 0 == difference;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+
+/**
+ * @brief The PasswordHasher class hashes and verifies clerk passwords with salted PBKDF2-SHA256.
+ * Hashes are stored as "pbkdf2-sha256$<iterations>$<salt>$<key>" (salt and key are base64),
+ * so clerk.password_hash must hold at least 100 characters.
+ * Legacy unsalted MD5 hashes are still accepted, but reported as needing rehash.
+ */
+class PasswordHasher
+{
+public:
+    /**
+     * @param iterations number of PBKDF2 iterations for new hashes
+     */
+    explicit PasswordHasher( const uint iterations );
+
+    /**
+     * @brief fromSettings hasher with number of iterations read from settings.ini ([security] pbkdf2Iterations)
+     */
+    static PasswordHasher fromSettings();
+
+    /**
+     * @brief hash hashes password with new random salt
+     */
+    QString hash( const QString& password ) const;
+
+    /**
+     * @brief verify checks password against stored hash
+     * @param needsRehash set to true if stored hash is legacy or weaker than current settings
+     * @return true if password matches
+     */
+    bool verify( const QString& password, const QString& stored, bool& needsRehash ) const;
+    /**
+     * @brief dummyHash well-formed hash with current number of iterations that matches no password.
+     * Password of unknown clerk is verified against it, so login takes the same time whether clerk exists
+     * or not
+     */
+    QString dummyHash() const;
+
+    /**
+     * @brief constantTimeEquals compares two byte arrays in time that doesn't depend on their content
+     */
+    static bool constantTimeEquals( const QByteArray& left, const QByteArray& right );
+
+private:
+    static QByteArray derive( const QString& password, const QByteArray& salt, const uint iterations );
+
+    uint m_iterations;
+};
@@ -0,0 +1,190 @@
+#include "queryprofiler.h"
+#include "sqldialect.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSettings>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QHash>
+#include <QThread>
+#include <QThreadStorage>
+#include <QDebug>
+
+namespace
+{
+/**
+ * @brief The PlanConnections struct profiler connections of one thread: clones of connections
+ * statements ran on, keyed by name of original connection. Removed when thread finishes
+ */
+struct PlanConnections
+{
+    QHash< QString, QString > names;
+
+    ~PlanConnections()
+    {
+        for (QHash< QString, QString >::const_iterator it = names.constBegin(); names.constEnd() != it; ++it)
+            QSqlDatabase::removeDatabase( it.value() );
+    }
+};
+
+QThreadStorage< PlanConnections* > planConnections;
+
+bool sameDatabase( const QSqlDatabase& left, const QSqlDatabase& right )
+{
+    return left.driverName() == right.driverName() && left.databaseName() == right.databaseName()
+        && left.hostName() == right.hostName() && left.port() == right.port()
+        && left.userName() == right.userName();
+}
+
+/**
+ * @brief planConnection opened clone of connection (owned by calling thread). Plans are captured over it,
+ * so EXPLAIN never runs inside transaction of caller: it can neither abort it (PostgreSQL) nor fail
+ * in read-only one (Oracle writes plan into PLAN_TABLE)
+ * @return invalid connection if clone can't be opened
+ */
+QSqlDatabase planConnection( const QString& connectionName )
+{
+    if (!planConnections.hasLocalData())
+        planConnections.setLocalData( new PlanConnections );
+    QHash< QString, QString >& names = planConnections.localData()->names;
+
+    const QSqlDatabase source = QSqlDatabase::database( connectionName, false );
+    QString name = names.value( connectionName );
+    if (!name.isEmpty())
+    {
+        {
+            const QSqlDatabase clone = QSqlDatabase::database( name, false );
+            if (clone.isOpen() && sameDatabase( source, clone ))
+                return clone;
+        }
+        // original connection has been replaced (or clone has been closed)
+        QSqlDatabase::removeDatabase( name );
+        names.remove( connectionName );
+    }
+
+    name = QString( "profiler-%1-%2" ).arg( connectionName )
+                                      .arg( reinterpret_cast< quintptr >( QThread::currentThread() ), 0, 16 );
+    {
+        QSqlDatabase clone = QSqlDatabase::cloneDatabase( source, name );
+        const bool openResult = clone.open();
+        qDebug() << "Profiler connection: " << name << openResult;
+        if (openResult)
+        {
+            names.insert( connectionName, name );
+            return clone;
+        }
+    }
+    QSqlDatabase::removeDatabase( name );
+
+    return QSqlDatabase();
+}
+}
+
+QueryProfiler::QueryProfiler()
+{
+    const QSettings settings( "settings.ini", QSettings::IniFormat );
+    m_thresholdMs = settings.value( "diagnostics/slowQueryMs", 200 ).toLongLong();
+    m_capacity    = qMax( 1, settings.value( "diagnostics/planBufferSize", 50 ).toInt() );
+}
+
+QueryProfiler& QueryProfiler::instance()
+{
+    static QueryProfiler profiler;
+    return profiler;
+}
+
+bool QueryProfiler::exec(QSqlQuery &query, const QString &connectionName)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const bool execResult = query.exec();
+    const qint64 elapsed = timer.elapsed();
+
+    QueryProfiler& profiler = instance();
+    if (!execResult || elapsed < profiler.m_thresholdMs)
+        return execResult;
+
+    qDebug() << "Slow statement: " << elapsed << "ms" << query.lastQuery();
+
+    Entry entry;
+    entry.executedAt     = QDateTime::currentDateTime();
+    entry.elapsedMs      = elapsed;
+    entry.connectionName = connectionName;
+    entry.statement      = query.lastQuery();
+    entry.plan           = capturePlan( query, connectionName );
+
+    const QMap< QString, QVariant > bound = query.boundValues();
+    for (QMap< QString, QVariant >::const_iterator it = bound.constBegin(); bound.constEnd() != it; ++it)
+        entry.boundValues << it.key() + " = " + it.value().toString();
+
+    profiler.record( entry );
+    return execResult;
+}
+
+QString QueryProfiler::capturePlan(QSqlQuery &query, const QString &connectionName)
+{
+    const QSqlDatabase db = planConnection( connectionName );
+    if (!db.isValid())
+        return QString( "Plan is not captured: profiler connection can't be opened" );
+
+    const SqlDialect& dialect = SqlDialect::forDriver( db.driverName() );
+
+    QSqlQuery explainQuery( db );
+    explainQuery.setForwardOnly( true );
+    if (!explainQuery.prepare( dialect.explainStatement( query.lastQuery() ) ))
+        return explainQuery.lastError().text();
+
+    if (dialect.explainTakesBinds())
+    {
+        const QMap< QString, QVariant > bound = query.boundValues();
+        int position = 0;
+        for (QMap< QString, QVariant >::const_iterator it = bound.constBegin(); bound.constEnd() != it; ++it, ++position)
+            if (it.key().startsWith( ':' ))
+                explainQuery.bindValue( it.key(), it.value() );
+            else
+                explainQuery.bindValue( position, it.value() );
+    }
+
+    if (!explainQuery.exec())
+        return explainQuery.lastError().text();
+
+    if (!dialect.planQuery().isEmpty())
+    {
+        explainQuery.finish();
+        if (!explainQuery.exec( dialect.planQuery() ))
+            return explainQuery.lastError().text();
+    }
+
+    QStringList plan;
+    while (explainQuery.next())
+        plan << explainQuery.value( dialect.planColumn() ).toString();
+
+    return plan.join( "\n" );
+}
+
+void QueryProfiler::record(const Entry &entry)
+{
+    QMutexLocker locker( &m_mutex );
+    m_entries.prepend( entry );
+    while (m_entries.size() > m_capacity)
+        m_entries.removeLast();
+}
+
+QList< QueryProfiler::Entry > QueryProfiler::entries()
+{
+    QueryProfiler& profiler = instance();
+    QMutexLocker locker( &profiler.m_mutex );
+    return profiler.m_entries;
+}
+
+void QueryProfiler::clear()
+{
+    QueryProfiler& profiler = instance();
+    QMutexLocker locker( &profiler.m_mutex );
+    profiler.m_entries.clear();
+}
+
+qint64 QueryProfiler::thresholdMs()
+{
+    return instance().m_thresholdMs;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QList>
+#include <QMutex>
+#include <QSqlDatabase>
+
+class QSqlQuery;
+
+/**
+ * @brief The QueryProfiler class times executed statements. When statement runs longer than threshold
+ * ("diagnostics/slowQueryMs" of settings.ini), its plan is captured with the same bound values and kept
+ * in ring buffer of last slow statements ("diagnostics/planBufferSize"). Plans are captured over clone
+ * of connection (one per thread and connection, opened with first slow statement), never inside
+ * transaction of caller. May be used from any thread.
+ */
+class QueryProfiler
+{
+public:
+    /**
+     * @brief The Entry struct one slow statement
+     */
+    struct Entry
+    {
+        QDateTime executedAt;
+        qint64 elapsedMs;
+        QString connectionName;
+        QString statement;
+        QStringList boundValues;
+        QString plan;
+    };
+
+    /**
+     * @brief exec executes prepared query and captures its plan if it was slow
+     * @param connectionName connection query was prepared on (plan is captured over its clone)
+     * @return result of QSqlQuery::exec()
+     */
+    static bool exec( QSqlQuery& query, const QString& connectionName = QLatin1String( QSqlDatabase::defaultConnection ) );
+
+    /**
+     * @brief entries slow statements, the latest first
+     */
+    static QList< Entry > entries();
+    static void clear();
+    static qint64 thresholdMs();
+
+private:
+    QueryProfiler();
+
+    static QueryProfiler& instance();
+    static QString capturePlan( QSqlQuery& query, const QString& connectionName );
+
+    void record( const Entry& entry );
+
+    mutable QMutex m_mutex;
+    QList< Entry > m_entries;
+    int m_capacity;
+    qint64 m_thresholdMs;
+};
@@ -0,0 +1,34 @@
+#include "readsnapshot.h"
+#include "sqldialect.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+ReadSnapshot::ReadSnapshot(QSqlDatabase db)
+    : m_db( db )
+    , m_valid( false )
+{
+    m_valid = m_db.transaction();
+    qDebug() << "Snapshot: " << m_valid;
+    if (!m_valid)
+        return;
+
+    const QString statement = SqlDialect::forDriver( m_db.driverName() ).readSnapshotStatement();
+    if (statement.isEmpty())
+        return;
+
+    QSqlQuery snapshotQuery( m_db );
+    if (!snapshotQuery.exec( statement ))
+    {
+        qDebug() << snapshotQuery.lastError();
+        qDebug() << "Rollback" << m_db.rollback();
+        m_valid = false;
+    }
+}
+
+ReadSnapshot::~ReadSnapshot()
+{
+    // nothing has been written, so commit only ends transaction
+    if (m_valid)
+        qDebug() << "~Snapshot: " << m_db.commit();
+}
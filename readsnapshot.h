@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QSqlDatabase>
+
+/**
+ * @brief The ReadSnapshot class is RAII-helper that runs all reads made over connection during its
+ * lifetime inside one read-only transaction, so they see database at single moment.
+ * Transaction is ended when snapshot is destroyed. Connection must be opened.
+ */
+class ReadSnapshot
+{
+public:
+    explicit ReadSnapshot( QSqlDatabase db = QSqlDatabase::database() );
+    ~ReadSnapshot();
+
+    /**
+     * @brief isValid whether snapshot transaction has been started
+     */
+    bool isValid() const { return m_valid; }
+
+private:
+    ReadSnapshot( const ReadSnapshot& );
+    ReadSnapshot& operator=( const ReadSnapshot& );
+
+    QSqlDatabase m_db;
+    bool m_valid;
+};
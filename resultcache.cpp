@@ -0,0 +1,176 @@
+#include "resultcache.h"
+#include "queryprofiler.h"
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlError>
+#include <QSettings>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDate>
+#include <QMap>
+#include <QDebug>
+
+namespace
+{
+const quint32 CacheMagic   = 0x42524331; // "BRC1"
+const quint32 CacheVersion = 1;
+}
+
+ResultCache::ResultCache(const QString &key, const QString &freshness)
+    : m_key( key )
+    , m_freshness( freshness )
+    , m_hits( 0 )
+{
+    const QSettings settings( "settings.ini", QSettings::IniFormat );
+    m_enabled    = settings.value( "cache/results", true ).toBool() && !freshness.isEmpty();
+    m_ttlSeconds = settings.value( "cache/ttlSeconds", 3600 ).toLongLong();
+    m_maxEntries = qMax( 1, settings.value( "cache/maxEntries", 32 ).toInt() );
+
+    m_dir = QStandardPaths::writableLocation( QStandardPaths::CacheLocation ) + "/results";
+    if (m_enabled)
+        QDir().mkpath( m_dir );
+}
+
+QString ResultCache::freshnessToken(QSqlDatabase db)
+{
+    QSqlQuery probeQuery( db );
+    probeQuery.setForwardOnly( true );
+    // versions only grow, so their sum changes whenever any of them does
+    if (!probeQuery.exec( "SELECT SUM(version) FROM data_version" ) || !probeQuery.next())
+    {
+        qDebug() << "Freshness probe: " << probeQuery.lastError();
+        return QString();
+    }
+
+    QStringList token;
+    token << QDate::currentDate().toString( Qt::ISODate );
+    for (int i( 0 ); probeQuery.record().count() != i; ++i)
+        token << probeQuery.value( i ).toString();
+
+    qDebug() << "Freshness: " << token;
+    return token.join( "|" );
+}
+
+QString ResultCache::fileName(QSqlQuery &query) const
+{
+    // normalized statement: whitespace doesn't matter
+    QByteArray key = m_key.toUtf8() + '\n' + query.lastQuery().simplified().toUtf8();
+
+    const QMap< QString, QVariant > bound = query.boundValues();
+    for (QMap< QString, QVariant >::const_iterator it = bound.constBegin(); bound.constEnd() != it; ++it)
+        key += '\n' + it.key().toUtf8() + '=' + it.value().toString().toUtf8();
+
+    return m_dir + "/" + QCryptographicHash::hash( key, QCryptographicHash::Md5 ).toHex() + ".result";
+}
+
+bool ResultCache::rows(QSqlQuery &query, QVector< QVariantList > &rows, const QString &connectionName) const
+{
+    rows.clear();
+
+    const QString file = m_enabled ? fileName( query ) : QString();
+    if (m_enabled && load( file, rows ))
+    {
+        ++m_hits;
+        return true;
+    }
+
+    const bool execResult = QueryProfiler::exec( query, connectionName );
+    qDebug() << "Exec: " << execResult;
+    if (!execResult)
+    {
+        qDebug() << query.lastError();
+        return false;
+    }
+
+    const int columns = query.record().count();
+    while (query.next())
+    {
+        QVariantList row;
+        row.reserve( columns );
+        for (int i( 0 ); columns != i; ++i)
+            row << query.value( i );
+        rows << row;
+    }
+
+    if (m_enabled)
+        save( file, rows );
+    return true;
+}
+
+bool ResultCache::load(const QString &fileName, QVector< QVariantList > &rows) const
+{
+    QFile file( fileName );
+    if (!file.open( QIODevice::ReadOnly ))
+        return false;
+
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_5_0 );
+
+    quint32 magic;
+    quint32 version;
+    QString freshness;
+    QDateTime savedAt;
+    QByteArray compressed;
+    stream >> magic >> version >> freshness >> savedAt >> compressed;
+    if (QDataStream::Ok != stream.status() || CacheMagic != magic || CacheVersion != version)
+    {
+        qDebug() << "Result cache has unknown format: " << fileName;
+        return false;
+    }
+
+    if (freshness != m_freshness || savedAt.secsTo( QDateTime::currentDateTime() ) > m_ttlSeconds)
+    {
+        qDebug() << "Result cache is stale: " << fileName << savedAt;
+        return false;
+    }
+
+    QDataStream rowStream( qUncompress( compressed ) );
+    rowStream.setVersion( QDataStream::Qt_5_0 );
+    rowStream >> rows;
+    if (QDataStream::Ok != rowStream.status())
+    {
+        qDebug() << "Result cache is corrupted: " << fileName;
+        rows.clear();
+        return false;
+    }
+
+    qDebug() << "Result cache: " << rows.size() << " row(s) from " << savedAt;
+    return true;
+}
+
+void ResultCache::save(const QString &fileName, const QVector< QVariantList > &rows) const
+{
+    QByteArray serialized;
+    {
+        QDataStream rowStream( &serialized, QIODevice::WriteOnly );
+        rowStream.setVersion( QDataStream::Qt_5_0 );
+        rowStream << rows;
+    }
+
+    QSaveFile file( fileName );
+    if (!file.open( QIODevice::WriteOnly ))
+    {
+        qDebug() << "Cannot write result cache: " << fileName;
+        return;
+    }
+
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_5_0 );
+    stream << CacheMagic << CacheVersion << m_freshness << QDateTime::currentDateTime() << qCompress( serialized );
+
+    qDebug() << "Save result cache: " << file.commit();
+    prune();
+}
+
+void ResultCache::prune() const
+{
+    const QFileInfoList entries = QDir( m_dir ).entryInfoList( QStringList() << "*.result", QDir::Files, QDir::Time );
+    for (int i( m_maxEntries ); entries.size() > i; ++i)
+        QFile::remove( entries.at( i ).absoluteFilePath() );
+}
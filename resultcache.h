@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QVariantList>
+#include <QSqlDatabase>
+
+class QSqlQuery;
+
+/**
+ * @brief The ResultCache class keeps results of heavy queries on local disk, compressed, keyed by
+ * normalized statement and its bound values. Cached result is served only while it is fresh: freshness
+ * token (versions of tables kept by triggers, see freshnessToken) must not have changed since result was
+ * stored and result must be younger than "cache/ttlSeconds" of settings.ini.
+ */
+class ResultCache
+{
+public:
+    /**
+     * @param key identifies database that cache belongs to (every database has its own entries)
+     * @param freshness token of current state of data (see freshnessToken)
+     */
+    ResultCache( const QString& key, const QString& freshness );
+
+    /**
+     * @brief freshnessToken reads versions of book, history_of_purchasing and daily_sales from data_version
+     * (connection must be opened). Triggers bump version of table by every statement that changes it
+     * (every row on SQLite), so token changes with any write, even one that cancels out previous one;
+     * day is a part of it too, since results may depend on current date
+     * @return empty string if probe has failed (nothing will be cached then)
+     */
+    static QString freshnessToken( QSqlDatabase db = QSqlDatabase::database() );
+
+    /**
+     * @brief rows rows of prepared query: from cache if they are fresh, otherwise query is executed
+     * (and its result is stored)
+     * @param connectionName connection query was prepared on
+     * @return false if query has failed
+     */
+    bool rows( QSqlQuery& query, QVector< QVariantList >& rows
+             , const QString& connectionName = QLatin1String( QSqlDatabase::defaultConnection ) ) const;
+
+    /**
+     * @brief hits how many results have been served from cache by this object
+     */
+    int hits() const { return m_hits; }
+
+private:
+    QString fileName( QSqlQuery& query ) const;
+    bool load( const QString& fileName, QVector< QVariantList >& rows ) const;
+    void save( const QString& fileName, const QVector< QVariantList >& rows ) const;
+    /**
+     * @brief prune removes the least recently stored entries beyond "cache/maxEntries"
+     */
+    void prune() const;
+
+    QString m_key;
+    QString m_freshness;
+    QString m_dir;
+    bool m_enabled;
+    qint64 m_ttlSeconds;
+    int m_maxEntries;
+    mutable int m_hits;
+};
@@ -0,0 +1,395 @@
+#include "resultexporter.h"
+#include "connectionsettings.h"
+#include "fetchtuning.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlError>
+#include <QSettings>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QDataStream>
+#include <QScopedPointer>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <QDebug>
+
+const int ResultExporter::ChunkRows;
+
+namespace
+{
+const quint32 ColumnarMagic   = 0x44424343; // "DBCC"
+const quint16 ColumnarVersion = 1;
+
+/**
+ * @brief The TableWriter class writes table into file row by row
+ */
+class TableWriter
+{
+public:
+    virtual ~TableWriter() {}
+
+    virtual bool open( const QString& fileName, const QStringList& headers, const QList< QVariant::Type >& types ) = 0;
+    virtual bool writeRow( const QVariantList& row ) = 0;
+    /**
+     * @brief finish flushes buffered rows and commits file
+     */
+    virtual bool finish() = 0;
+    virtual QString errorString() const = 0;
+};
+
+class CsvWriter : public TableWriter
+{
+public:
+    bool open( const QString& fileName, const QStringList& headers, const QList< QVariant::Type >& types )
+    {
+        Q_UNUSED( types );
+
+        m_file.setFileName( fileName );
+        if (!m_file.open( QIODevice::WriteOnly | QIODevice::Text ))
+            return false;
+
+        m_stream.setDevice( &m_file );
+        m_stream.setCodec( "UTF-8" );
+
+        QVariantList row;
+        for (int i( 0 ); headers.size() != i; ++i)
+            row << headers.at( i );
+        return writeRow( row );
+    }
+
+    bool writeRow( const QVariantList& row )
+    {
+        for (int i( 0 ); row.size() != i; ++i)
+        {
+            if (0 != i)
+                m_stream << ',';
+            m_stream << field( row.at( i ) );
+        }
+        m_stream << '\n';
+
+        return QTextStream::Ok == m_stream.status();
+    }
+
+    bool finish()
+    {
+        m_stream.flush();
+        return QTextStream::Ok == m_stream.status() && m_file.commit();
+    }
+
+    QString errorString() const { return m_file.errorString(); }
+
+private:
+    static QString field( const QVariant& value )
+    {
+        if (value.isNull())
+            return QString();
+
+        QString text = (QVariant::DateTime == value.type()) ? value.toDateTime().toString( Qt::ISODate )
+                                                            : value.toString();
+        if (text.contains( ',' ) || text.contains( '"' ) || text.contains( '\n' ) || text.contains( '\r' ))
+            text = '"' + text.replace( "\"", "\"\"" ) + '"';
+
+        return text;
+    }
+
+    QSaveFile m_file;
+    QTextStream m_stream;
+};
+
+class ColumnarWriter : public TableWriter
+{
+public:
+    enum ColumnType
+    {
+        IntegerColumn = 1,
+        RealColumn,
+        DateTimeColumn,
+        TextColumn
+    };
+
+    ColumnarWriter()
+        : m_chunkRows( 0 )
+    {
+    }
+
+    bool open( const QString& fileName, const QStringList& headers, const QList< QVariant::Type >& types )
+    {
+        m_file.setFileName( fileName );
+        if (!m_file.open( QIODevice::WriteOnly ))
+            return false;
+
+        m_stream.setDevice( &m_file );
+        m_stream.setVersion( QDataStream::Qt_5_0 );
+
+        m_types.clear();
+        for (int i( 0 ); types.size() != i; ++i)
+            m_types << columnType( types.at( i ) );
+
+        m_stream << ColumnarMagic << ColumnarVersion << static_cast< quint32 >( headers.size() );
+        for (int i( 0 ); headers.size() != i; ++i)
+            m_stream << headers.at( i ) << static_cast< quint8 >( m_types.at( i ) );
+
+        startChunk();
+        return QDataStream::Ok == m_stream.status();
+    }
+
+    bool writeRow( const QVariantList& row )
+    {
+        for (int i( 0 ); m_types.size() != i; ++i)
+        {
+            const QVariant& value = row.at( i );
+            QDataStream& column = *m_columns[ i ];
+            column << static_cast< quint8 >( value.isNull() ? 0 : 1 );
+            switch (m_types.at( i ))
+            {
+            case IntegerColumn:
+                column << static_cast< qint64 >( value.toLongLong() );
+                break;
+            case RealColumn:
+                column << value.toDouble();
+                break;
+            case DateTimeColumn:
+                column << static_cast< qint64 >( value.isNull() ? 0 : value.toDateTime().toMSecsSinceEpoch() );
+                break;
+            case TextColumn:
+                column << value.toString();
+                break;
+            }
+        }
+
+        return (ResultExporter::ChunkRows == ++m_chunkRows) ? flushChunk() : true;
+    }
+
+    bool finish()
+    {
+        if (0 != m_chunkRows && !flushChunk())
+            return false;
+
+        m_stream << static_cast< quint32 >( 0 );
+        qDeleteAll( m_columns );
+        m_columns.clear();
+
+        return QDataStream::Ok == m_stream.status() && m_file.commit();
+    }
+
+    QString errorString() const { return m_file.errorString(); }
+
+    ~ColumnarWriter()
+    {
+        qDeleteAll( m_columns );
+    }
+
+private:
+    static ColumnType columnType( const QVariant::Type type )
+    {
+        switch (type)
+        {
+        case QVariant::Int:
+        case QVariant::UInt:
+        case QVariant::LongLong:
+        case QVariant::ULongLong:
+        case QVariant::Bool:
+            return IntegerColumn;
+        case QVariant::Double:
+            return RealColumn;
+        case QVariant::Date:
+        case QVariant::DateTime:
+            return DateTimeColumn;
+        default:
+            return TextColumn;
+        }
+    }
+
+    void startChunk()
+    {
+        qDeleteAll( m_columns );
+        m_columns.clear();
+        m_buffers.resize( m_types.size() );
+        for (int i( 0 ); m_types.size() != i; ++i)
+        {
+            m_buffers[ i ].clear();
+            QDataStream * const column = new QDataStream( &m_buffers[ i ], QIODevice::WriteOnly );
+            column->setVersion( QDataStream::Qt_5_0 );
+            m_columns << column;
+        }
+        m_chunkRows = 0;
+    }
+
+    bool flushChunk()
+    {
+        m_stream << static_cast< quint32 >( m_chunkRows );
+        for (int i( 0 ); m_types.size() != i; ++i)
+            m_stream << qCompress( m_buffers.at( i ) );
+
+        startChunk();
+        return QDataStream::Ok == m_stream.status();
+    }
+
+    QSaveFile m_file;
+    QDataStream m_stream;
+    QList< ColumnType > m_types;
+    QVector< QByteArray > m_buffers;
+    QList< QDataStream * > m_columns;
+    int m_chunkRows;
+};
+
+TableWriter * createWriter( const ResultExporter::Format format )
+{
+    if (ResultExporter::Csv == format)
+        return new CsvWriter;
+    return new ColumnarWriter;
+}
+}
+
+ResultExporter::ResultExporter(QObject * const parent)
+    : QObject( parent )
+    , m_cancelled( 0 )
+{
+}
+
+ResultExporter::~ResultExporter()
+{
+    cancel();
+    m_future.waitForFinished();
+}
+
+ResultExporter::Format ResultExporter::formatOf(const QString &fileName)
+{
+    return (0 == QFileInfo( fileName ).suffix().compare( "csv", Qt::CaseInsensitive )) ? Csv : Columnar;
+}
+
+bool ResultExporter::isRunning() const
+{
+    return m_future.isRunning();
+}
+
+void ResultExporter::cancel()
+{
+    m_cancelled.fetchAndStoreOrdered( 1 );
+}
+
+bool ResultExporter::startQueryExport(const QString &fileName, const QString &statement, const QVariantMap &bindings)
+{
+    if (isRunning())
+        return false;
+
+    m_cancelled.fetchAndStoreOrdered( 0 );
+    m_future = QtConcurrent::run( this, &ResultExporter::runQueryExport, fileName, statement, bindings );
+    return true;
+}
+
+bool ResultExporter::startRowsExport(const QString &fileName, const QStringList &headers, const QVector<QVariantList> &rows)
+{
+    if (isRunning())
+        return false;
+
+    m_cancelled.fetchAndStoreOrdered( 0 );
+    m_future = QtConcurrent::run( this, &ResultExporter::runRowsExport, fileName, headers, rows );
+    return true;
+}
+
+void ResultExporter::runQueryExport(const QString &fileName, const QString &statement, const QVariantMap &bindings)
+{
+    const QString connectionName = QString( "export-%1" ).arg( reinterpret_cast< quintptr >( QThread::currentThread() ) );
+    qint64 rows = 0;
+    QString error;
+    {
+        QSettings settings( "settings.ini", QSettings::IniFormat );
+        QSqlDatabase db = ConnectionSettings::read( settings, "database" ).addDatabase( connectionName );
+        FetchTuning::apply( db, "export" );
+        if (!db.open())
+            error = db.lastError().text();
+        else
+        {
+            QElapsedTimer timer;
+            timer.start();
+
+            QSqlQuery exportQuery( db );
+            exportQuery.setForwardOnly( true );
+            qDebug() << "Prepare: " << exportQuery.prepare( statement );
+            for (QVariantMap::const_iterator it = bindings.constBegin(); bindings.constEnd() != it; ++it)
+                exportQuery.bindValue( it.key(), it.value() );
+
+            if (!exportQuery.exec())
+                error = exportQuery.lastError().text();
+            else
+            {
+                const QSqlRecord record = exportQuery.record();
+                QStringList headers;
+                QList< QVariant::Type > types;
+                for (int i( 0 ); record.count() != i; ++i)
+                {
+                    headers << record.fieldName( i ).toLower();
+                    types   << record.field( i ).type();
+                }
+
+                QScopedPointer< TableWriter > writer( createWriter( formatOf( fileName ) ) );
+                if (!writer->open( fileName, headers, types ))
+                    error = writer->errorString();
+
+                QVariantList row;
+                while (error.isEmpty() && exportQuery.next())
+                {
+                    row.clear();
+                    for (int i( 0 ); record.count() != i; ++i)
+                        row << exportQuery.value( i );
+                    if (!writer->writeRow( row ))
+                        error = writer->errorString();
+
+                    if (0 == ++rows % ChunkRows)
+                    {
+                        emit progress( rows );
+                        if (m_cancelled.loadAcquire())
+                            error = tr("Export has been cancelled");
+                    }
+                }
+
+                if (error.isEmpty() && !writer->finish())
+                    error = writer->errorString();
+                if (error.isEmpty())
+                    FetchTuning::record( "export", rows, timer.elapsed() );
+            }
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase( connectionName );
+
+    qDebug() << "Exported: " << rows << fileName << error;
+    emit finished( error.isEmpty(), rows, error );
+}
+
+void ResultExporter::runRowsExport(const QString &fileName, const QStringList &headers, const QVector<QVariantList> &rows)
+{
+    QList< QVariant::Type > types;
+    for (int i( 0 ); headers.size() != i; ++i)
+        types << (rows.isEmpty() ? QVariant::String : rows.first().at( i ).type());
+
+    QString error;
+    QScopedPointer< TableWriter > writer( createWriter( formatOf( fileName ) ) );
+    if (!writer->open( fileName, headers, types ))
+        error = writer->errorString();
+
+    qint64 written = 0;
+    for (int i( 0 ); error.isEmpty() && rows.size() != i; ++i)
+    {
+        if (!writer->writeRow( rows.at( i ) ))
+            error = writer->errorString();
+
+        if (0 == ++written % ChunkRows)
+        {
+            emit progress( written );
+            if (m_cancelled.loadAcquire())
+                error = tr("Export has been cancelled");
+        }
+    }
+
+    if (error.isEmpty() && !writer->finish())
+        error = writer->errorString();
+
+    qDebug() << "Exported: " << written << fileName << error;
+    emit finished( error.isEmpty(), written, error );
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+#include <QFuture>
+#include <QAtomicInt>
+
+/**
+ * @brief The ResultExporter class writes query results (or rows that are already in memory) into file
+ * on worker thread. Query is read with forward-only cursor over separate connection and written in
+ * chunks, so memory use doesn't depend on number of rows.
+ *
+ * Files are written either as CSV (UTF-8, RFC 4180 quoting) or in compact columnar format:
+ * "DBCC" magic, version, number of columns, then name and type of every column; then row groups
+ * (up to ChunkRows rows each): number of rows and, for every column, qCompress'ed block with null
+ * flags and values. Row group of 0 rows ends the file.
+ */
+class ResultExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Format
+    {
+        Csv,
+        Columnar
+    };
+
+    /**
+     * @brief ChunkRows number of rows in one row group (and between progress reports)
+     */
+    static const int ChunkRows = 65536;
+
+    explicit ResultExporter(QObject * const parent = NULL);
+    ~ResultExporter();
+
+    /**
+     * @brief formatOf format by file extension (.csv is CSV, anything else is columnar)
+     */
+    static Format formatOf( const QString& fileName );
+
+    /**
+     * @brief startQueryExport starts export of query results. Query is run over its own connection
+     * to database from settings.ini
+     * @param bindings values bound to placeholders of statement
+     * @return false if another export is running
+     */
+    bool startQueryExport( const QString& fileName, const QString& statement, const QVariantMap& bindings = QVariantMap() );
+    /**
+     * @brief startRowsExport starts export of rows that are already in memory
+     * @return false if another export is running
+     */
+    bool startRowsExport( const QString& fileName, const QStringList& headers, const QVector< QVariantList >& rows );
+
+    bool isRunning() const;
+
+public slots:
+    /**
+     * @brief cancel stops running export; partially written file is discarded
+     */
+    void cancel();
+
+signals:
+    void progress( const qint64 rows );
+    void finished( const bool ok, const qint64 rows, const QString& error );
+
+private:
+    void runQueryExport( const QString& fileName, const QString& statement, const QVariantMap& bindings );
+    void runRowsExport( const QString& fileName, const QStringList& headers, const QVector< QVariantList >& rows );
+
+    QFuture< void > m_future;
+    QAtomicInt m_cancelled;
+};
@@ -0,0 +1,60 @@
+#include "saleshistogram.h"
+#include "sqldialect.h"
+#include "resultcache.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+const uint SalesHistogram::MaxDays;
+
+bool SalesHistogram::fetch(const ResultCache &cache, QSqlDatabase db)
+{
+    QSqlQuery histogramQuery( db );
+    histogramQuery.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                histogramQuery.prepare( SqlDialect::forDriver( db.driverName() ).salesHistogramQuery() );
+    histogramQuery.bindValue( ":days", daysBefore( MaxDays ) );
+    histogramQuery.bindValue( ":summaryDays", daysBefore( MaxDays ) );
+
+    QVector< QVariantList > rows;
+    if (!cache.rows( histogramQuery, rows, db.connectionName() ))
+        return false;
+
+    m_cumulative.clear();
+    for (int i( 0 ); rows.size() != i; ++i)
+    {
+        const QVariantList& row = rows.at( i );
+        const uint age = row.at( 1 ).toUInt();
+        if (MaxDays <= age)
+            continue;
+
+        QVector< uint >& buckets = m_cumulative[ row.at( 0 ).toString() ];
+        if (buckets.isEmpty())
+            buckets.fill( 0, MaxDays );
+        buckets[ age ] += row.at( 2 ).toUInt();
+    }
+
+    for (QHash< QString, QVector< uint > >::iterator it = m_cumulative.begin(); m_cumulative.end() != it; ++it)
+    {
+        QVector< uint >& buckets = it.value();
+        for (uint age( 1 ); MaxDays != age; ++age)
+            buckets[ age ] += buckets[ age - 1 ];
+    }
+
+    qDebug() << "Histogram for " << m_cumulative.size() << " ISBN(s)";
+    return true;
+}
+
+void SalesHistogram::clear()
+{
+    m_cumulative.clear();
+}
+
+uint SalesHistogram::sold(const QString &isbn, const uint days) const
+{
+    const QHash< QString, QVector< uint > >::const_iterator it = m_cumulative.constFind( isbn );
+    if (m_cumulative.constEnd() == it || 0 == days)
+        return 0;
+
+    return it.value().at( qMin( days, MaxDays ) - 1 );
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QHash>
+#include <QVector>
+#include <QString>
+#include <QSqlDatabase>
+
+class ResultCache;
+
+/**
+ * @brief The SalesHistogram class caches per-ISBN daily sales for last MaxDays days.
+ * Histogram is fetched with one grouped query; sales for any window up to MaxDays
+ * are then computed locally.
+ */
+class SalesHistogram
+{
+public:
+    /**
+     * @brief MaxDays the widest lookback window that may be asked for
+     */
+    static const uint MaxDays = 90;
+
+    /**
+     * @brief daysBefore how many days before today are counted in window of last days (today included).
+     * Every sales window (histogram, book detail, bundle sell-through) starts that many days ago
+     */
+    static uint daysBefore( const uint days ) { return qMax( 1u, days ) - 1; }
+
+    /**
+     * @brief fetch (re)reads histogram from history_of_purchasing and daily_sales (or from cache,
+     * while it is fresh).
+     * Connection must be opened.
+     * @return true on success
+     */
+    bool fetch( const ResultCache& cache, QSqlDatabase db = QSqlDatabase::database() );
+    void clear();
+
+    /**
+     * @brief sold how many copies of book were sold during last days (today included)
+     */
+    uint sold( const QString& isbn, const uint days ) const;
+
+private:
+    /**
+     * @brief m_cumulative running totals for every ISBN that has been sold:
+     * m_cumulative[ isbn ][ age ] is number of copies sold from age days ago till today (both included),
+     * i.e. during last age + 1 days
+     */
+    QHash< QString, QVector< uint > > m_cumulative;
+};
@@ -0,0 +1,489 @@
+#include "schema.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSqlRecord>
+#include <QHash>
+#include <QSettings>
+#include <QDate>
+#include <QDebug>
+
+namespace
+{
+enum ColumnType
+{
+    Id,
+    Isbn,
+    Name,
+    Text,
+    PasswordHash,
+    Count,
+    Counter,
+    Money,
+    Cents,
+    Fraction,
+    Flag,
+    Timestamp,
+    Date
+};
+
+QString columnType( const SqlDialect::Backend backend, const ColumnType type )
+{
+    switch (backend)
+    {
+    case SqlDialect::Oracle:
+        switch (type)
+        {
+        case Id:           return "NUMBER(10)";
+        case Isbn:         return "VARCHAR2(17)";
+        case Name:         return "VARCHAR2(256)";
+        case Text:         return "VARCHAR2(2000)";
+        case PasswordHash: return "VARCHAR2(128)";
+        case Count:        return "NUMBER(10)";
+        case Counter:      return "NUMBER(19)";
+        case Money:        return "NUMBER(10, 2)";
+        case Cents:        return "NUMBER(12)";
+        case Fraction:     return "NUMBER(7, 6)";
+        case Flag:         return "NUMBER(1) DEFAULT 0";
+        case Timestamp:
+        case Date:         return "DATE";
+        }
+        break;
+    case SqlDialect::PostgreSQL:
+        switch (type)
+        {
+        case Id:           return "integer";
+        case Isbn:         return "varchar(17)";
+        case Name:         return "varchar(256)";
+        case Text:         return "varchar(2000)";
+        case PasswordHash: return "varchar(128)";
+        case Count:        return "integer";
+        case Counter:      return "bigint";
+        case Money:        return "numeric(10, 2)";
+        case Cents:        return "bigint";
+        case Fraction:     return "numeric(7, 6)";
+        case Flag:         return "smallint DEFAULT 0";
+        case Timestamp:    return "timestamp";
+        case Date:         return "date";
+        }
+        break;
+    case SqlDialect::SQLite:
+        switch (type)
+        {
+        case Id:
+        case Count:
+        case Counter:
+        case Cents:        return "INTEGER";
+        case Isbn:
+        case Name:
+        case Text:
+        case PasswordHash: return "TEXT";
+        case Money:
+        case Fraction:     return "REAL";
+        case Flag:         return "INTEGER DEFAULT 0";
+        case Timestamp:
+        case Date:         return "TEXT";
+        }
+        break;
+    }
+
+    return QString();
+}
+
+Schema::Index makeIndex( const QString& name, const QString& table, const QString& columns, const bool unique
+                       , const QString& purpose )
+{
+    Schema::Index index;
+    index.name    = name;
+    index.table   = table;
+    index.columns = columns.split( ", " );
+    index.unique  = unique;
+    index.purpose = purpose;
+
+    return index;
+}
+
+QString dailySalesTable( const SqlDialect::Backend backend )
+{
+    return QString( "CREATE TABLE daily_sales ("
+                        "isbn %1 NOT NULL REFERENCES book (isbn), "
+                        "sale_date %2 NOT NULL, "
+                        "sold %3 NOT NULL, "
+                        "PRIMARY KEY (sale_date, isbn))" )
+           .arg( columnType( backend, Isbn ), columnType( backend, Date ), columnType( backend, Count ) );
+}
+
+/**
+ * @brief historyRollupTable months of partitioned history that have been rolled up, but whose partitions
+ * haven't been dropped yet (Oracle commits DDL implicitly, so partition can't be dropped in the same
+ * transaction that rolls it up)
+ */
+QString historyRollupTable( const SqlDialect::Backend backend )
+{
+    return QString( "CREATE TABLE history_rollup (month %1 PRIMARY KEY)" ).arg( columnType( backend, Date ) );
+}
+
+/**
+ * @brief importStagingTable staging table of supplier import on Oracle (where it is permanent)
+ */
+QString importStagingTable()
+{
+    return "CREATE GLOBAL TEMPORARY TABLE import_staging "
+           "(line NUMBER(10), isbn VARCHAR2(17), price NUMBER(10, 2), quantity NUMBER(10)) "
+           "ON COMMIT DELETE ROWS";
+}
+
+/**
+ * @brief dataVersionStatements table with version of every table that filter results are read from and
+ * triggers that bump it on every change (see ResultCache::freshnessToken)
+ */
+QStringList dataVersionStatements( const SqlDialect& dialect )
+{
+    const QStringList tables = QStringList() << "book" << "history_of_purchasing" << "daily_sales";
+
+    QStringList statements;
+    statements << QString( "CREATE TABLE data_version ("
+                               "table_name %1 PRIMARY KEY, "
+                               "version %2 DEFAULT 0 NOT NULL)" )
+                  .arg( columnType( dialect.backend(), Name ), columnType( dialect.backend(), Counter ) );
+    for (int i( 0 ); tables.size() != i; ++i)
+        statements << QString( "INSERT INTO data_version (table_name) VALUES ('%1')" ).arg( tables.at( i ) );
+    for (int i( 0 ); tables.size() != i; ++i)
+        statements << dialect.dataVersionTriggerStatements( tables.at( i ) );
+
+    return statements;
+}
+
+/**
+ * @brief hasTable whether list of tables (as QSqlDatabase::tables() returns it, possibly qualified by schema)
+ * contains table
+ */
+bool hasTable( const QStringList& tables, const QString& table )
+{
+    for (int i( 0 ); tables.size() != i; ++i)
+        if (0 == tables.at( i ).section( '.', -1 ).compare( table, Qt::CaseInsensitive ))
+            return true;
+
+    return false;
+}
+
+Schema::Upgrade makeUpgrade( const QString& purpose, const QStringList& statements )
+{
+    Schema::Upgrade upgrade;
+    upgrade.purpose    = purpose;
+    upgrade.statements = statements;
+
+    return upgrade;
+}
+}
+
+QList< Schema::Index > Schema::expectedIndexes()
+{
+    return QList< Index >()
+            << makeIndex( "request_isbn_uq", "request", "isbn", true
+                        , "request upsert (conflict target) and lookup by ISBN" )
+            << makeIndex( "book_s_author_isbn_ix", "book_s_author", "isbn, author_id", false
+                        , "authors of book" )
+            << makeIndex( "history_date_isbn_ix", "history_of_purchasing", "purchasing_date, isbn", false
+                        , "sales histogram and sell-through (range scan by date)" )
+            << makeIndex( "daily_sales_isbn_ix", "daily_sales", "isbn, sale_date, sold", false
+                        , "rolled up sales of book" )
+            << makeIndex( "book_quantity_isbn_ix", "book", "quantity, isbn", false
+                        , "stock filter" )
+            << makeIndex( "bundledbook_bundle_ix", "bundledbook", "bundle_id, deleted, isbn, discount", false
+                        , "books of bundle" )
+            << makeIndex( "bundle_deleted_id_ix", "bundle", "deleted, bundle_id, name", false
+                        , "bundle pages (keyset by bundle_id)" );
+}
+
+QStringList Schema::createTableStatements(const SqlDialect &dialect, const bool partitionHistory)
+{
+    const SqlDialect::Backend backend = dialect.backend();
+
+    QStringList statements;
+    statements
+            << QString( "CREATE TABLE publisher ("
+                            "publisher_id %1 PRIMARY KEY, "
+                            "name %2 NOT NULL)" )
+               .arg( columnType( backend, Id ), columnType( backend, Name ) )
+            << QString( "CREATE TABLE author ("
+                            "author_id %1 PRIMARY KEY, "
+                            "name %2 NOT NULL)" )
+               .arg( columnType( backend, Id ), columnType( backend, Name ) )
+            << QString( "CREATE TABLE book ("
+                            "isbn %1 PRIMARY KEY, "
+                            "title %2 NOT NULL, "
+                            "publisher_id %3 REFERENCES publisher (publisher_id), "
+                            "year %4, "
+                            "price %5 NOT NULL, "
+                            "quantity %4 NOT NULL)" )
+               .arg( columnType( backend, Isbn ), columnType( backend, Name ), columnType( backend, Id )
+                   , columnType( backend, Count ), columnType( backend, Money ) )
+            << QString( "CREATE TABLE book_s_author ("
+                            "isbn %1 NOT NULL REFERENCES book (isbn), "
+                            "author_id %2 NOT NULL REFERENCES author (author_id), "
+                            "PRIMARY KEY (isbn, author_id))" )
+               .arg( columnType( backend, Isbn ), columnType( backend, Id ) )
+            << QString( "CREATE TABLE clerk ("
+                            "clerk_id %1 PRIMARY KEY, "
+                            "password_hash %2 NOT NULL)" )
+               .arg( columnType( backend, Id ), columnType( backend, PasswordHash ) )
+            << QString( "CREATE TABLE request ("
+                            "isbn %1 NOT NULL REFERENCES book (isbn), "
+                            "quantity %2 NOT NULL, "
+                            "clerk_id %3 NOT NULL REFERENCES clerk (clerk_id), "
+                            "version %2 DEFAULT 0 NOT NULL)" )
+               .arg( columnType( backend, Isbn ), columnType( backend, Count ), columnType( backend, Id ) )
+            << QString( "CREATE TABLE history_of_purchasing ("
+                            "isbn %1 NOT NULL REFERENCES book (isbn), "
+                            "purchasing_date %2 NOT NULL) %3" )
+               .arg( columnType( backend, Isbn ), columnType( backend, Timestamp )
+                   , partitionHistory ? dialect.historyPartitionClause() : QString() )
+            << dailySalesTable( backend )
+            << historyRollupTable( backend )
+            << QString( "CREATE TABLE bundle ("
+                            "bundle_id %1 PRIMARY KEY, "
+                            "name %2 NOT NULL, "
+                            "deleted %3, "
+                            "commnt %4)" )
+               .arg( columnType( backend, Id ), columnType( backend, Name )
+                   , columnType( backend, Flag ), columnType( backend, Text ) )
+            << QString( "CREATE TABLE bundledbook ("
+                            "isbn %1 NOT NULL REFERENCES book (isbn), "
+                            "bundle_id %2 NOT NULL REFERENCES bundle (bundle_id), "
+                            "discount %3 NOT NULL, "
+                            "deleted %4, "
+                            "net_cents %5, "
+                            "PRIMARY KEY (isbn, bundle_id))" )
+               .arg( columnType( backend, Isbn ), columnType( backend, Id )
+                   , columnType( backend, Fraction ), columnType( backend, Flag ), columnType( backend, Cents ) );
+
+    statements << dataVersionStatements( dialect );
+
+    // SQLite takes next bundle_id from MAX(bundle_id)
+    if (SqlDialect::SQLite != backend)
+        statements << "CREATE SEQUENCE bundle_sequence";
+
+    // PostgreSQL doesn't create partitions itself: current and next month are created here (then by rollup),
+    // anything else goes to default partition
+    if (partitionHistory && SqlDialect::PostgreSQL == backend)
+    {
+        const QDate today = QDate::currentDate();
+        statements << dialect.historyPartitionStatements( today )
+                   << dialect.historyPartitionStatements( today.addMonths( 1 ) )
+                   << "CREATE TABLE history_of_purchasing_default PARTITION OF history_of_purchasing DEFAULT";
+    }
+
+    // other backends create staging table of supplier import in transaction
+    if (SqlDialect::Oracle == backend)
+        statements << importStagingTable();
+
+    return statements;
+}
+
+QString Schema::createIndexStatement(const Index &index)
+{
+    return QString( "CREATE %1INDEX %2 ON %3 (%4)" ).arg( index.unique ? "UNIQUE " : "" )
+                                                    .arg( index.name )
+                                                    .arg( index.table )
+                                                    .arg( index.columns.join( ", " ) );
+}
+
+bool Schema::hasTables(QSqlDatabase db)
+{
+    const QStringList tables = db.tables();
+    for (int i( 0 ); tables.size() != i; ++i)
+        if (0 == tables.at( i ).compare( "book", Qt::CaseInsensitive ))
+            return true;
+
+    return false;
+}
+
+QList< Schema::Upgrade > Schema::findUpgrades(QSqlDatabase db)
+{
+    const SqlDialect& dialect = SqlDialect::forDriver( db.driverName() );
+    const SqlDialect::Backend backend = dialect.backend();
+    const QStringList tables = db.tables();
+
+    QList< Upgrade > upgrades;
+    if (!hasTable( tables, "daily_sales" ))
+        upgrades << makeUpgrade( "rolled up sales (sales histogram, sold of book and bundle)"
+                               , QStringList() << dailySalesTable( backend ) );
+    if (!hasTable( tables, "history_rollup" ))
+        upgrades << makeUpgrade( "rollup of partitioned history"
+                               , QStringList() << historyRollupTable( backend ) );
+    if (hasTable( tables, "request" ) && -1 == db.record( "request" ).indexOf( "version" ))
+        upgrades << makeUpgrade( "version of request (concurrent modification of requests)"
+                               , QStringList() << QString( "ALTER TABLE request ADD version %1 DEFAULT 0 NOT NULL" )
+                                                  .arg( columnType( backend, Count ) ) );
+    if (hasTable( tables, "bundledbook" ) && -1 == db.record( "bundledbook" ).indexOf( "net_cents" ))
+        upgrades << makeUpgrade( "exact net prices of bundled books"
+                               , QStringList()
+                                 << QString( "ALTER TABLE bundledbook ADD net_cents %1" ).arg( columnType( backend, Cents ) )
+                                 << "UPDATE bundledbook SET net_cents = "
+                                        "(SELECT ROUND(book.price * 100 * (1 - bundledbook.discount)) "
+                                         "FROM book WHERE book.isbn = bundledbook.isbn)" );
+    // sequence starts after bundles that exist already
+    const QString sequenceQuery = dialect.bundleSequenceQuery();
+    if (!sequenceQuery.isEmpty() && hasTable( tables, "bundle" ))
+    {
+        QSqlQuery catalogQuery( db );
+        catalogQuery.setForwardOnly( true );
+        const bool execResult = catalogQuery.exec( sequenceQuery );
+        if (!execResult)
+            qDebug() << catalogQuery.lastError();
+        else if (catalogQuery.next() && 0 == catalogQuery.value( 0 ).toInt())
+        {
+            QSqlQuery lastQuery( db );
+            lastQuery.setForwardOnly( true );
+            const qint64 last = (lastQuery.exec( "SELECT MAX(bundle_id) FROM bundle" ) && lastQuery.next())
+                              ? lastQuery.value( 0 ).toLongLong() : 0;
+            upgrades << makeUpgrade( "sequence of bundle ids"
+                                   , QStringList() << QString( "CREATE SEQUENCE bundle_sequence START WITH %1" )
+                                                      .arg( last + 1 ) );
+        }
+    }
+    if (SqlDialect::Oracle == backend && !hasTable( tables, "import_staging" ))
+        upgrades << makeUpgrade( "staging table of supplier import"
+                               , QStringList() << importStagingTable() );
+    if (!hasTable( tables, "data_version" ))
+        upgrades << makeUpgrade( "change marker of cached filter results"
+                               , dataVersionStatements( dialect ) );
+
+    qDebug() << "Upgrades: " << upgrades.size();
+    return upgrades;
+}
+
+QString Schema::upgradeScript(const QList<Upgrade> &upgrades)
+{
+    QStringList script;
+    for (int i( 0 ); upgrades.size() != i; ++i)
+    {
+        script << "-- " + upgrades.at( i ).purpose;
+        for (int j( 0 ); upgrades.at( i ).statements.size() != j; ++j)
+            script << upgrades.at( i ).statements.at( j ) + ";";
+    }
+
+    return script.join( "\n" );
+}
+
+bool Schema::upgrade(const QList<Upgrade> &upgrades, QSqlDatabase db)
+{
+    // every upgrade is applied in its own transaction (Oracle commits DDL implicitly anyway)
+    for (int i( 0 ); upgrades.size() != i; ++i)
+    {
+        const Upgrade& upgrade = upgrades.at( i );
+        qDebug() << "Upgrade: " << upgrade.purpose;
+        qDebug() << "Transaction: " << db.transaction();
+        for (int j( 0 ); upgrade.statements.size() != j; ++j)
+        {
+            QSqlQuery ddlQuery( db );
+            const bool execResult = ddlQuery.exec( upgrade.statements.at( j ) );
+            qDebug() << "Exec: " << execResult << upgrade.statements.at( j );
+            if (!execResult)
+            {
+                qDebug() << ddlQuery.lastError();
+                qDebug() << "Rollback" << db.rollback();
+                return false;
+            }
+        }
+
+        const bool commit = db.commit();
+        qDebug() << "Commit: " << commit;
+        if (!commit)
+            return false;
+    }
+
+    return true;
+}
+
+bool Schema::partitionsHistory()
+{
+    const QSettings settings( "settings.ini", QSettings::IniFormat );
+    return settings.value( "history/partitioned", false ).toBool();
+}
+
+bool Schema::create(QSqlDatabase db)
+{
+    QStringList statements = createTableStatements( SqlDialect::forDriver( db.driverName() ), partitionsHistory() );
+    const QList< Index > indexes = expectedIndexes();
+    for (int i( 0 ); indexes.size() != i; ++i)
+        statements << createIndexStatement( indexes.at( i ) );
+
+    // Oracle commits DDL implicitly, so failed creation may leave some tables behind there
+    qDebug() << "Transaction: " << db.transaction();
+    for (int i( 0 ); statements.size() != i; ++i)
+    {
+        QSqlQuery ddlQuery( db );
+        const bool execResult = ddlQuery.exec( statements.at( i ) );
+        qDebug() << "Exec: " << execResult << statements.at( i );
+        if (!execResult)
+        {
+            qDebug() << ddlQuery.lastError();
+            qDebug() << "Rollback" << db.rollback();
+            return false;
+        }
+    }
+
+    const bool commit = db.commit();
+    qDebug() << "Commit: " << commit;
+    return commit;
+}
+
+bool Schema::findMissingIndexes(QList<Index> &missing, QSqlDatabase db)
+{
+    QSqlQuery catalogQuery( db );
+    catalogQuery.setForwardOnly( true );
+    qDebug() << "Prepare: " <<
+                catalogQuery.prepare( SqlDialect::forDriver( db.driverName() ).indexColumnsQuery() );
+
+    const bool execResult = catalogQuery.exec();
+    qDebug() << "Exec: " << execResult;
+    if (!execResult)
+    {
+        qDebug() << catalogQuery.lastError();
+        return false;
+    }
+
+    // live indexes grouped by table
+    QHash< QString, QList< Index > > live;
+    QString lastName;
+    while (catalogQuery.next())
+    {
+        const QString name = catalogQuery.value( 0 ).toString();
+        const QString table = catalogQuery.value( 1 ).toString();
+        QList< Index >& tableIndexes = live[ table ];
+        if (name != lastName || tableIndexes.isEmpty())
+        {
+            Index index;
+            index.name   = name;
+            index.table  = table;
+            index.unique = 0 != catalogQuery.value( 3 ).toInt();
+            tableIndexes << index;
+            lastName = name;
+        }
+        tableIndexes.last().columns << catalogQuery.value( 2 ).toString();
+    }
+
+    missing.clear();
+    const QList< Index > expected = expectedIndexes();
+    for (int i( 0 ); expected.size() != i; ++i)
+    {
+        const Index& index = expected.at( i );
+        const QList< Index > tableIndexes = live.value( index.table );
+
+        bool found = false;
+        for (int j( 0 ); tableIndexes.size() != j && !found; ++j)
+        {
+            const Index& candidate = tableIndexes.at( j );
+            found = (!index.unique || (candidate.unique && candidate.columns == index.columns))
+                 && candidate.columns.mid( 0, index.columns.size() ) == index.columns;
+        }
+
+        if (!found)
+            missing << index;
+    }
+
+    qDebug() << "Missing indexes: " << missing.size();
+    return true;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QSqlDatabase>
+
+#include "sqldialect.h"
+
+/**
+ * @brief The Schema class describes database objects the application relies on: tables, bundle sequence
+ * and indexes its statements are tuned for. It creates them in empty database and checks live
+ * database for indexes that are missing.
+ */
+class Schema
+{
+public:
+    /**
+     * @brief The Index struct index that some statement of application needs. Leading columns serve
+     * WHERE/JOIN of statement, the rest make it covering (statement is answered from index alone)
+     */
+    struct Index
+    {
+        QString name;
+        QString table;
+        QStringList columns;
+        bool unique;
+        /**
+         * @brief purpose statement(s) the index is meant for
+         */
+        QString purpose;
+    };
+
+    /**
+     * @brief The Upgrade struct change that database created by older version of application lacks
+     * (table or column that statements of application need)
+     */
+    struct Upgrade
+    {
+        QString purpose;
+        QStringList statements;
+    };
+
+    /**
+     * @brief expectedIndexes indexes that statements of application need
+     */
+    static QList< Index > expectedIndexes();
+
+    /**
+     * @brief createTableStatements DDL that creates all tables (bundle sequence and, for Oracle,
+     * staging table of supplier import) for given backend
+     * @param partitionHistory whether history_of_purchasing is partitioned by month (where backend can do it)
+     */
+    static QStringList createTableStatements( const SqlDialect& dialect, const bool partitionHistory = false );
+    /**
+     * @brief partitionsHistory whether history_of_purchasing is (to be) partitioned by month.
+     * Read from settings (history/partitioned)
+     */
+    static bool partitionsHistory();
+    /**
+     * @brief createIndexStatement DDL that creates index
+     */
+    static QString createIndexStatement( const Index& index );
+
+    /**
+     * @brief hasTables whether tables of application exist in database
+     */
+    static bool hasTables( QSqlDatabase db = QSqlDatabase::database() );
+    /**
+     * @brief create creates all tables and indexes in one transaction. Database must be opened
+     * @return true on success
+     */
+    static bool create( QSqlDatabase db = QSqlDatabase::database() );
+    /**
+     * @brief findUpgrades compares live tables (and their columns) with ones that statements of application
+     * need. Database must be opened
+     */
+    static QList< Upgrade > findUpgrades( QSqlDatabase db = QSqlDatabase::database() );
+    /**
+     * @brief upgradeScript DDL of upgrades as script (for administrator of database)
+     */
+    static QString upgradeScript( const QList< Upgrade >& upgrades );
+    /**
+     * @brief upgrade applies upgrades, every one in its own transaction. Database must be opened
+     * @return true on success
+     */
+    static bool upgrade( const QList< Upgrade >& upgrades, QSqlDatabase db = QSqlDatabase::database() );
+    /**
+     * @brief findMissingIndexes compares live indexes with expected ones. Index is present if some
+     * live index of the same table starts with the same columns (and is unique, if it has to be).
+     * Database must be opened
+     * @return false if catalog can't be read
+     */
+    static bool findMissingIndexes( QList< Index >& missing, QSqlDatabase db = QSqlDatabase::database() );
+};
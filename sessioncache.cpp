@@ -0,0 +1,88 @@
+#include "sessioncache.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+namespace
+{
+const quint32 CacheMagic   = 0x42534331; // "BSC1"
+const quint32 CacheVersion = 1;
+}
+
+SessionCache::SessionCache(const QString &key)
+{
+    const QString dir = QStandardPaths::writableLocation( QStandardPaths::CacheLocation );
+    QDir().mkpath( dir );
+
+    const QString hash = QCryptographicHash::hash( key.toUtf8(), QCryptographicHash::Md5 ).toHex();
+    m_fileName = dir + "/session-" + hash + ".cache";
+}
+
+bool SessionCache::load(FilterState &filter, Snapshot &snapshot) const
+{
+    QFile file( m_fileName );
+    if (!file.open( QIODevice::ReadOnly ))
+    {
+        qDebug() << "No session cache: " << m_fileName;
+        return false;
+    }
+
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_5_0 );
+
+    quint32 magic;
+    quint32 version;
+    stream >> magic >> version;
+    if (CacheMagic != magic || CacheVersion != version)
+    {
+        qDebug() << "Session cache has unknown format";
+        return false;
+    }
+
+    stream >> filter.preset
+           >> filter.boughtMoreChecked >> filter.boughtMore
+           >> filter.boughtLessChecked >> filter.boughtLess
+           >> filter.instockMoreChecked >> filter.instockMore
+           >> filter.instockLessChecked >> filter.instockLess
+           >> filter.lookbackDays;
+    stream >> snapshot.savedAt >> snapshot.isbns >> snapshot.sold >> snapshot.quantities;
+
+    if (QDataStream::Ok != stream.status()
+            || snapshot.isbns.size() != snapshot.sold.size()
+            || snapshot.isbns.size() != snapshot.quantities.size())
+    {
+        qDebug() << "Session cache is corrupted";
+        return false;
+    }
+
+    qDebug() << "Session cache: " << snapshot.isbns.size() << " row(s) from " << snapshot.savedAt;
+    return true;
+}
+
+bool SessionCache::save(const FilterState &filter, const Snapshot &snapshot) const
+{
+    QSaveFile file( m_fileName );
+    if (!file.open( QIODevice::WriteOnly ))
+    {
+        qDebug() << "Cannot write session cache: " << m_fileName;
+        return false;
+    }
+
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_5_0 );
+
+    stream << CacheMagic << CacheVersion;
+    stream << filter.preset
+           << filter.boughtMoreChecked << filter.boughtMore
+           << filter.boughtLessChecked << filter.boughtLess
+           << filter.instockMoreChecked << filter.instockMore
+           << filter.instockLessChecked << filter.instockLess
+           << filter.lookbackDays;
+    stream << snapshot.savedAt << snapshot.isbns << snapshot.sold << snapshot.quantities;
+
+    return file.commit();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QDateTime>
+
+/**
+ * @brief The SessionCache class stores state of last session (filter preset and its results)
+ * in local cache file, so it may be shown immediately on next start, before fresh query finishes.
+ */
+class SessionCache
+{
+public:
+    /**
+     * @brief The FilterState struct state of filter controls
+     */
+    struct FilterState
+    {
+        int  preset;
+        bool boughtMoreChecked;
+        int  boughtMore;
+        bool boughtLessChecked;
+        int  boughtLess;
+        bool instockMoreChecked;
+        int  instockMore;
+        bool instockLessChecked;
+        int  instockLess;
+        uint lookbackDays;
+    };
+
+    /**
+     * @brief The Snapshot struct results of filter query as they were shown
+     */
+    struct Snapshot
+    {
+        QDateTime          savedAt;
+        QVector< QString > isbns;
+        QVector< uint >    sold;
+        QVector< uint >    quantities;
+    };
+
+    /**
+     * @param key identifies database that cache belongs to (every database has its own file)
+     */
+    explicit SessionCache( const QString& key );
+
+    bool load( FilterState& filter, Snapshot& snapshot ) const;
+    bool save( const FilterState& filter, const Snapshot& snapshot ) const;
+
+private:
+    QString m_fileName;
+};
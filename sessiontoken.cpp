@@ -0,0 +1,134 @@
+#include "sessiontoken.h"
+#include "passwordhasher.h"
+#include <QMessageAuthenticationCode>
+#include <QRandomGenerator>
+#include <QStandardPaths>
+#include <QDateTime>
+#include <QSettings>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+namespace
+{
+const int SecretLength = 32;
+const int SaltLength   = 16;
+
+QByteArray randomBytes( const int length )
+{
+    QByteArray bytes( length, Qt::Uninitialized );
+    QRandomGenerator::system()->fillRange( reinterpret_cast< quint32* >( bytes.data() ), length / sizeof( quint32 ) );
+    return bytes;
+}
+}
+
+QByteArray SessionToken::secret()
+{
+    const QString dir = QStandardPaths::writableLocation( QStandardPaths::AppDataLocation );
+    QDir().mkpath( dir );
+
+    QFile file( dir + "/session.key" );
+    if (file.open( QIODevice::ReadOnly ))
+    {
+        const QByteArray key = file.readAll();
+        if (SecretLength == key.size())
+            return key;
+    }
+    file.close();
+
+    const QByteArray key = randomBytes( SecretLength );
+    if (file.open( QIODevice::WriteOnly | QIODevice::Truncate ))
+    {
+        file.setPermissions( QFile::ReadOwner | QFile::WriteOwner );
+        file.write( key );
+    }
+    else
+        qDebug() << "Cannot store session key";
+
+    return key;
+}
+
+QByteArray SessionToken::verifier(const QByteArray &salt, const QString &password)
+{
+    return QMessageAuthenticationCode::hash( salt + password.toUtf8(), secret(), QCryptographicHash::Sha256 );
+}
+
+QByteArray SessionToken::signature(const QString &database, const QString &userName
+                                   , const qint64 expires, const QByteArray &salt, const QByteArray &verifier)
+{
+    QMessageAuthenticationCode code( QCryptographicHash::Sha256, secret() );
+    code.addData( database.toUtf8() );
+    code.addData( "\n" );
+    code.addData( userName.toUtf8() );
+    code.addData( "\n" );
+    code.addData( QByteArray::number( expires ) );
+    code.addData( "\n" );
+    code.addData( salt );
+    code.addData( verifier );
+    return code.result();
+}
+
+void SessionToken::issue(const QString &database, const QString &userName, const QString &password)
+{
+    QSettings config( "settings.ini", QSettings::IniFormat );
+    const uint hours = config.value( "security/sessionHours", 8 ).toUInt();
+    if (0 == hours)
+    {
+        revoke();
+        return;
+    }
+
+    const qint64 expires = QDateTime::currentDateTimeUtc().addSecs( 3600 * hours ).toMSecsSinceEpoch();
+    const QByteArray salt = randomBytes( SaltLength );
+    const QByteArray tokenVerifier = verifier( salt, password );
+
+    QSettings settings;
+    settings.beginGroup( "session" );
+    settings.setValue( "database", database );
+    settings.setValue( "user",     userName );
+    settings.setValue( "expires",  expires );
+    settings.setValue( "salt",     salt.toBase64() );
+    settings.setValue( "verifier", tokenVerifier.toBase64() );
+    settings.setValue( "signature", signature( database, userName, expires, salt, tokenVerifier ).toBase64() );
+    settings.endGroup();
+
+    qDebug() << "Session token issued for " << hours << " hour(s)";
+}
+
+bool SessionToken::verify(const QString &database, const QString &userName, const QString &password)
+{
+    QSettings settings;
+    settings.beginGroup( "session" );
+    const QString    tokenDatabase  = settings.value( "database" ).toString();
+    const QString    tokenUser      = settings.value( "user" ).toString();
+    const qint64     expires        = settings.value( "expires", 0 ).toLongLong();
+    const QByteArray salt           = QByteArray::fromBase64( settings.value( "salt" ).toByteArray() );
+    const QByteArray tokenVerifier  = QByteArray::fromBase64( settings.value( "verifier" ).toByteArray() );
+    const QByteArray tokenSignature = QByteArray::fromBase64( settings.value( "signature" ).toByteArray() );
+    settings.endGroup();
+
+    if (tokenSignature.isEmpty() || tokenDatabase != database || tokenUser != userName)
+        return false;
+
+    if (QDateTime::currentDateTimeUtc().toMSecsSinceEpoch() >= expires)
+    {
+        qDebug() << "Session token has expired";
+        revoke();
+        return false;
+    }
+
+    if (!PasswordHasher::constantTimeEquals( signature( database, userName, expires, salt, tokenVerifier ), tokenSignature ))
+    {
+        qDebug() << "Session token signature mismatch";
+        revoke();
+        return false;
+    }
+
+    return PasswordHasher::constantTimeEquals( verifier( salt, password ), tokenVerifier );
+}
+
+void SessionToken::revoke()
+{
+    QSettings settings;
+    settings.remove( "session" );
+}
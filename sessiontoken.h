@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+
+/**
+ * @brief The SessionToken class is signed, time-limited local proof of successful login.
+ * While it is valid, clerk may reconnect (with the same credentials) without asking database
+ * and without paying key stretching cost again.
+ *
+ * Token is stored in user settings and signed with HMAC-SHA256 by secret key that is
+ * generated once and kept in owner-only file in application data directory.
+ */
+class SessionToken
+{
+public:
+    /**
+     * @brief issue stores new token after successful login to database
+     * @param database identifies database that clerk has logged in
+     */
+    static void issue( const QString& database, const QString& userName, const QString& password );
+
+    /**
+     * @brief verify checks that there is valid token for these credentials and database
+     */
+    static bool verify( const QString& database, const QString& userName, const QString& password );
+
+    /**
+     * @brief revoke removes stored token
+     */
+    static void revoke();
+
+private:
+    static QByteArray secret();
+    static QByteArray verifier( const QByteArray& salt, const QString& password );
+    static QByteArray signature( const QString& database, const QString& userName
+                               , const qint64 expires, const QByteArray& salt, const QByteArray& verifier );
+};
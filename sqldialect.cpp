@@ -0,0 +1,487 @@
+#include "sqldialect.h"
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QDate>
+#include <QDebug>
+
+namespace
+{
+class OracleDialect : public SqlDialect
+{
+public:
+    Backend backend() const { return Oracle; }
+    QString name() const { return "Oracle"; }
+
+    QString salesHistogramQuery() const
+    {
+        return "SELECT isbn, trunc(sysdate) - sale_date age, SUM(sold) "
+               "FROM (SELECT isbn, trunc(purchasing_date) sale_date, COUNT(*) sold "
+                     "FROM history_of_purchasing "
+                     "WHERE purchasing_date >= trunc(sysdate) - :days "
+                     "GROUP BY isbn, trunc(purchasing_date) "
+                     "UNION ALL "
+                     "SELECT isbn, sale_date, sold "
+                     "FROM daily_sales "
+                     "WHERE sale_date >= trunc(sysdate) - :summaryDays) "
+               "GROUP BY isbn, sale_date";
+    }
+    QString bookSalesQuery() const
+    {
+        return "SELECT (SELECT COUNT(*) FROM history_of_purchasing "
+                       "WHERE isbn = :isbn AND purchasing_date >= trunc(sysdate) - :days) "
+                    "+ (SELECT NVL(SUM(sold), 0) FROM daily_sales "
+                       "WHERE isbn = :summaryIsbn AND sale_date >= trunc(sysdate) - :summaryDays) "
+               "FROM dual";
+    }
+
+    QString rollupStatement() const
+    {
+        return "MERGE INTO daily_sales d "
+               "USING (SELECT isbn, trunc(purchasing_date) sale_date, COUNT(*) sold "
+                      "FROM history_of_purchasing "
+                      "WHERE purchasing_date >= :from AND purchasing_date < :to "
+                      "GROUP BY isbn, trunc(purchasing_date)) h "
+               "ON (d.sale_date = h.sale_date AND d.isbn = h.isbn) "
+               "WHEN MATCHED THEN UPDATE SET d.sold = d.sold + h.sold "
+               "WHEN NOT MATCHED THEN INSERT (isbn, sale_date, sold) VALUES (h.isbn, h.sale_date, h.sold)";
+    }
+    QString historyPartitionedQuery() const
+    {
+        return "SELECT COUNT(*) FROM user_part_tables WHERE table_name = 'HISTORY_OF_PURCHASING'";
+    }
+    // new months get their partitions on first insert
+    QString historyPartitionClause() const
+    {
+        return "PARTITION BY RANGE (purchasing_date) INTERVAL (NUMTOYMINTERVAL(1, 'MONTH')) "
+               "(PARTITION history_initial VALUES LESS THAN (DATE '2000-01-01'))";
+    }
+    // purchases before 2000 share initial partition, so it is never dropped
+    QString dropHistoryPartitionStatement( const QDate& month ) const
+    {
+        if (QDate( 2000, 1, 1 ) > month)
+            return QString();
+        return QString( "ALTER TABLE history_of_purchasing DROP PARTITION FOR (DATE '%1') UPDATE INDEXES" )
+               .arg( month.toString( "yyyy-MM-01" ) );
+    }
+
+    QString readSnapshotStatement() const { return "SET TRANSACTION READ ONLY"; }
+
+    // statement level trigger: bulk statement bumps version once
+    QStringList dataVersionTriggerStatements( const QString& table ) const
+    {
+        return QStringList()
+                << QString( "CREATE OR REPLACE TRIGGER %1_changed "
+                            "AFTER INSERT OR UPDATE OR DELETE ON %1 "
+                            "BEGIN "
+                                "UPDATE data_version SET version = version + 1 WHERE table_name = '%1'; "
+                            "END;" ).arg( table );
+    }
+
+    QString insertBundleStatement() const
+    {
+        return "INSERT INTO bundle (bundle_id, name, deleted, commnt) VALUES "
+               "(bundle_sequence.NEXTVAL, :name, 0, :commnt)";
+    }
+    bool insertBundleReturnsId() const { return false; }
+    QString lastBundleIdQuery() const { return "SELECT bundle_sequence.CURRVAL FROM dual"; }
+
+    QString bundleSequenceQuery() const
+    {
+        return "SELECT COUNT(*) FROM user_sequences WHERE sequence_name = 'BUNDLE_SEQUENCE'";
+    }
+
+    QString upsertRequestStatement() const
+    {
+        return "MERGE INTO request r "
+               "USING (SELECT :isbn isbn, :quantity quantity, :clerkID clerk_id FROM dual) s "
+               "ON (r.isbn = s.isbn) "
+               "WHEN MATCHED THEN UPDATE SET r.quantity = s.quantity, r.version = r.version + 1 "
+                                 "WHERE r.clerk_id = s.clerk_id "
+               "WHEN NOT MATCHED THEN INSERT (isbn, quantity, clerk_id, version) "
+                                     "VALUES (s.isbn, s.quantity, s.clerk_id, 0)";
+    }
+    bool upsertRequestReturnsRow() const { return false; }
+
+    QString upsertBundledBookStatement() const
+    {
+        return "MERGE INTO bundledbook t "
+               "USING (SELECT :isbn isbn, :bundle_id bundle_id, :net_cents net_cents, :discount discount FROM dual) s "
+               "ON (t.isbn = s.isbn AND t.bundle_id = s.bundle_id) "
+               "WHEN MATCHED THEN UPDATE SET t.net_cents = s.net_cents, t.discount = s.discount, t.deleted = 0 "
+               "WHEN NOT MATCHED THEN INSERT (isbn, bundle_id, net_cents, discount, deleted) "
+                                     "VALUES (s.isbn, s.bundle_id, s.net_cents, s.discount, 0)";
+    }
+
+    QString indexColumnsQuery() const
+    {
+        return "SELECT LOWER(c.index_name), LOWER(c.table_name), LOWER(c.column_name), "
+                      "CASE i.uniqueness WHEN 'UNIQUE' THEN 1 ELSE 0 END "
+               "FROM user_ind_columns c JOIN user_indexes i ON i.index_name = c.index_name "
+               "ORDER BY c.index_name, c.column_position";
+    }
+
+    QString explainStatement( const QString& statement ) const
+    {
+        return "EXPLAIN PLAN SET STATEMENT_ID = 'db_clerk' FOR " + statement;
+    }
+    // bind variables of explained statement are left unbound; optimizer doesn't peek them
+    bool explainTakesBinds() const { return false; }
+    QString planQuery() const
+    {
+        return "SELECT plan_table_output FROM TABLE(DBMS_XPLAN.DISPLAY(NULL, 'db_clerk', 'TYPICAL'))";
+    }
+
+    // import_staging is global temporary table (ON COMMIT DELETE ROWS)
+    QStringList importStagingStatements() const { return QStringList(); }
+    QString applyImportStatement() const
+    {
+        return "MERGE INTO book b "
+               "USING import_staging s ON (b.isbn = s.isbn) "
+               "WHEN MATCHED THEN UPDATE SET b.price = s.price, b.quantity = s.quantity";
+    }
+
+    QString limitClause() const { return "FETCH FIRST :limit ROWS ONLY"; }
+
+    int multiRowInsertLimit() const { return 1; }
+};
+
+class PostgreSQLDialect : public SqlDialect
+{
+public:
+    Backend backend() const { return PostgreSQL; }
+    QString name() const { return "PostgreSQL"; }
+
+    QString salesHistogramQuery() const
+    {
+        return "SELECT isbn, current_date - sale_date age, SUM(sold) "
+               "FROM (SELECT isbn, CAST(purchasing_date AS date) sale_date, COUNT(*) sold "
+                     "FROM history_of_purchasing "
+                     "WHERE purchasing_date >= current_date - CAST(:days AS integer) "
+                     "GROUP BY 1, 2 "
+                     "UNION ALL "
+                     "SELECT isbn, sale_date, sold "
+                     "FROM daily_sales "
+                     "WHERE sale_date >= current_date - CAST(:summaryDays AS integer)) s "
+               "GROUP BY isbn, sale_date";
+    }
+    QString bookSalesQuery() const
+    {
+        return "SELECT (SELECT COUNT(*) FROM history_of_purchasing "
+                       "WHERE isbn = :isbn AND purchasing_date >= current_date - CAST(:days AS integer)) "
+                    "+ (SELECT COALESCE(SUM(sold), 0) FROM daily_sales "
+                       "WHERE isbn = :summaryIsbn "
+                         "AND sale_date >= current_date - CAST(:summaryDays AS integer))";
+    }
+
+    QString rollupStatement() const
+    {
+        return "INSERT INTO daily_sales (isbn, sale_date, sold) "
+               "SELECT isbn, CAST(purchasing_date AS date), COUNT(*) "
+               "FROM history_of_purchasing "
+               "WHERE purchasing_date >= :from AND purchasing_date < :to "
+               "GROUP BY 1, 2 "
+               "ON CONFLICT (sale_date, isbn) DO UPDATE SET sold = daily_sales.sold + excluded.sold";
+    }
+    QString historyPartitionedQuery() const
+    {
+        return "SELECT COUNT(*) FROM pg_partitioned_table p JOIN pg_class c ON c.oid = p.partrelid "
+               "WHERE c.relname = 'history_of_purchasing' AND pg_table_is_visible(c.oid)";
+    }
+    // rows of months without partition land in history_of_purchasing_default (see Schema)
+    QString historyPartitionClause() const { return "PARTITION BY RANGE (purchasing_date)"; }
+    // rows of month that have landed in default partition are moved into new partition, in the same
+    // transaction (otherwise partition can't be attached)
+    QStringList historyPartitionStatements( const QDate& month ) const
+    {
+        const QDate first( month.year(), month.month(), 1 );
+        const QString partition = "history_of_purchasing_p" + first.toString( "yyyyMM" );
+        const QString range = QString( "purchasing_date >= '%1' AND purchasing_date < '%2'" )
+                              .arg( first.toString( Qt::ISODate ), first.addMonths( 1 ).toString( Qt::ISODate ) );
+
+        return QStringList()
+                << QString( "DO $$ BEGIN "
+                            "IF to_regclass('%1') IS NULL THEN "
+                                "CREATE TABLE %1 (LIKE history_of_purchasing INCLUDING DEFAULTS); "
+                                "IF to_regclass('history_of_purchasing_default') IS NOT NULL THEN "
+                                    "WITH moved AS (DELETE FROM history_of_purchasing_default WHERE %2 RETURNING *) "
+                                    "INSERT INTO %1 SELECT * FROM moved; "
+                                "END IF; "
+                                "ALTER TABLE history_of_purchasing ATTACH PARTITION %1 "
+                                    "FOR VALUES FROM ('%3') TO ('%4'); "
+                            "END IF; "
+                            "END $$" )
+                   .arg( partition, range, first.toString( Qt::ISODate ), first.addMonths( 1 ).toString( Qt::ISODate ) );
+    }
+    QString dropHistoryPartitionStatement( const QDate& month ) const
+    {
+        return QString( "DROP TABLE IF EXISTS history_of_purchasing_p%1" ).arg( month.toString( "yyyyMM" ) );
+    }
+
+    QString readSnapshotStatement() const
+    {
+        return "SET TRANSACTION ISOLATION LEVEL REPEATABLE READ READ ONLY";
+    }
+
+    // statement level trigger (of partitioned table too); function is shared by all tables
+    QStringList dataVersionTriggerStatements( const QString& table ) const
+    {
+        return QStringList()
+                << "CREATE OR REPLACE FUNCTION data_version_bump() RETURNS trigger AS $$ "
+                   "BEGIN "
+                       "UPDATE data_version SET version = version + 1 WHERE table_name = TG_ARGV[0]; "
+                       "RETURN NULL; "
+                   "END $$ LANGUAGE plpgsql"
+                << QString( "CREATE TRIGGER %1_changed "
+                            "AFTER INSERT OR UPDATE OR DELETE OR TRUNCATE ON %1 "
+                            "FOR EACH STATEMENT EXECUTE PROCEDURE data_version_bump('%1')" ).arg( table );
+    }
+
+    QString insertBundleStatement() const
+    {
+        return "INSERT INTO bundle (bundle_id, name, deleted, commnt) VALUES "
+               "(nextval('bundle_sequence'), :name, 0, :commnt) "
+               "RETURNING bundle_id";
+    }
+
+    QString bundleSequenceQuery() const
+    {
+        return "SELECT COUNT(*) FROM pg_class "
+               "WHERE relkind = 'S' AND relname = 'bundle_sequence' AND pg_table_is_visible(oid)";
+    }
+    bool insertBundleReturnsId() const { return true; }
+
+    QString upsertRequestStatement() const
+    {
+        return "INSERT INTO request (isbn, quantity, clerk_id, version) VALUES (:isbn, :quantity, :clerkID, 0) "
+               "ON CONFLICT (isbn) DO UPDATE SET quantity = excluded.quantity, version = request.version + 1 "
+               "WHERE request.clerk_id = excluded.clerk_id "
+               "RETURNING quantity, clerk_id, version";
+    }
+    bool upsertRequestReturnsRow() const { return true; }
+
+    QString upsertBundledBookStatement() const
+    {
+        return "INSERT INTO bundledbook (isbn, bundle_id, net_cents, discount, deleted) "
+               "VALUES (:isbn, :bundle_id, :net_cents, :discount, 0) "
+               "ON CONFLICT (isbn, bundle_id) DO UPDATE SET net_cents = excluded.net_cents, "
+                                                          "discount = excluded.discount, deleted = 0";
+    }
+
+    QString indexColumnsQuery() const
+    {
+        return "SELECT i.relname, t.relname, a.attname, CASE WHEN x.indisunique THEN 1 ELSE 0 END "
+               "FROM pg_index x JOIN pg_class i ON i.oid = x.indexrelid "
+                               "JOIN pg_class t ON t.oid = x.indrelid "
+                               "JOIN pg_namespace n ON n.oid = t.relnamespace "
+                               "CROSS JOIN LATERAL unnest(x.indkey) WITH ORDINALITY AS k(attnum, position) "
+                               "JOIN pg_attribute a ON a.attrelid = t.oid AND a.attnum = k.attnum "
+               "WHERE n.nspname = current_schema() "
+               "ORDER BY i.relname, k.position";
+    }
+
+    QString explainStatement( const QString& statement ) const
+    {
+        // ANALYZE executes statement, so only queries may be analyzed
+        const QString trimmed = statement.trimmed();
+        if (trimmed.startsWith( "SELECT", Qt::CaseInsensitive ) || trimmed.startsWith( "WITH", Qt::CaseInsensitive ))
+            return "EXPLAIN (ANALYZE, BUFFERS) " + statement;
+        return "EXPLAIN " + statement;
+    }
+
+    QStringList importStagingStatements() const
+    {
+        return QStringList() << "CREATE TEMPORARY TABLE import_staging "
+                                "(line integer, isbn varchar(17), price numeric(10, 2), quantity integer) "
+                                "ON COMMIT DROP";
+    }
+    QString applyImportStatement() const
+    {
+        return "UPDATE book SET price = s.price, quantity = s.quantity "
+               "FROM import_staging s WHERE book.isbn = s.isbn";
+    }
+
+    QString limitClause() const { return "LIMIT :limit"; }
+
+    int multiRowInsertLimit() const { return 1000; }
+};
+
+/**
+ * @brief The SQLiteDialect class needs SQLite 3.35 or later (RETURNING of inserts and upserts;
+ * upserts themselves need 3.24)
+ */
+class SQLiteDialect : public SqlDialect
+{
+public:
+    Backend backend() const { return SQLite; }
+    QString name() const { return "SQLite"; }
+
+    QString salesHistogramQuery() const
+    {
+        return "SELECT isbn, CAST(julianday('now', 'localtime', 'start of day') "
+                                 "- julianday(sale_date) AS INTEGER) age, SUM(sold) "
+               "FROM (SELECT isbn, date(purchasing_date) sale_date, COUNT(*) sold "
+                     "FROM history_of_purchasing "
+                     "WHERE purchasing_date >= date('now', 'localtime', '-' || :days || ' days') "
+                     "GROUP BY 1, 2 "
+                     "UNION ALL "
+                     "SELECT isbn, sale_date, sold "
+                     "FROM daily_sales "
+                     "WHERE sale_date >= date('now', 'localtime', '-' || :summaryDays || ' days')) "
+               "GROUP BY isbn, sale_date";
+    }
+    QString bookSalesQuery() const
+    {
+        return "SELECT (SELECT COUNT(*) FROM history_of_purchasing "
+                       "WHERE isbn = :isbn "
+                         "AND purchasing_date >= date('now', 'localtime', '-' || :days || ' days')) "
+                    "+ (SELECT IFNULL(SUM(sold), 0) FROM daily_sales "
+                       "WHERE isbn = :summaryIsbn "
+                         "AND sale_date >= date('now', 'localtime', '-' || :summaryDays || ' days'))";
+    }
+
+    QString rollupStatement() const
+    {
+        return "INSERT INTO daily_sales (isbn, sale_date, sold) "
+               "SELECT isbn, date(purchasing_date), COUNT(*) "
+               "FROM history_of_purchasing "
+               "WHERE purchasing_date >= :from AND purchasing_date < :to "
+               "GROUP BY 1, 2 "
+               "ON CONFLICT (sale_date, isbn) DO UPDATE SET sold = daily_sales.sold + excluded.sold";
+    }
+
+    // reads of deferred transaction share one snapshot (taken at first read)
+    QString readSnapshotStatement() const { return QString(); }
+
+    // SQLite has only row level triggers, one per event
+    QStringList dataVersionTriggerStatements( const QString& table ) const
+    {
+        const QString trigger( "CREATE TRIGGER %1_%2 AFTER %3 ON %1 "
+                               "BEGIN "
+                                   "UPDATE data_version SET version = version + 1 WHERE table_name = '%1'; "
+                               "END" );
+        return QStringList() << trigger.arg( table, "inserted", "INSERT" )
+                             << trigger.arg( table, "updated", "UPDATE" )
+                             << trigger.arg( table, "deleted", "DELETE" );
+    }
+
+    // RETURNING needs SQLite 3.35
+    QString insertBundleStatement() const
+    {
+        return "INSERT INTO bundle (bundle_id, name, deleted, commnt) VALUES "
+               "((SELECT IFNULL(MAX(bundle_id), 0) + 1 FROM bundle), :name, 0, :commnt) "
+               "RETURNING bundle_id";
+    }
+    bool insertBundleReturnsId() const { return true; }
+
+    QString upsertRequestStatement() const
+    {
+        return "INSERT INTO request (isbn, quantity, clerk_id, version) VALUES (:isbn, :quantity, :clerkID, 0) "
+               "ON CONFLICT (isbn) DO UPDATE SET quantity = excluded.quantity, version = request.version + 1 "
+               "WHERE request.clerk_id = excluded.clerk_id "
+               "RETURNING quantity, clerk_id, version";
+    }
+    bool upsertRequestReturnsRow() const { return true; }
+
+    QString upsertBundledBookStatement() const
+    {
+        return "INSERT INTO bundledbook (isbn, bundle_id, net_cents, discount, deleted) "
+               "VALUES (:isbn, :bundle_id, :net_cents, :discount, 0) "
+               "ON CONFLICT (isbn, bundle_id) DO UPDATE SET net_cents = excluded.net_cents, "
+                                                          "discount = excluded.discount, deleted = 0";
+    }
+
+    QString indexColumnsQuery() const
+    {
+        return "SELECT LOWER(l.name), LOWER(m.name), LOWER(c.name), l.\"unique\" "
+               "FROM sqlite_master m, pragma_index_list(m.name) l, pragma_index_info(l.name) c "
+               "WHERE m.type = 'table' "
+               "ORDER BY l.name, c.seqno";
+    }
+
+    QString explainStatement( const QString& statement ) const
+    {
+        return "EXPLAIN QUERY PLAN " + statement;
+    }
+    // id, parent, notused, detail
+    int planColumn() const { return 3; }
+
+    QStringList importStagingStatements() const
+    {
+        return QStringList() << "CREATE TEMP TABLE IF NOT EXISTS import_staging "
+                                "(line INTEGER, isbn TEXT, price REAL, quantity INTEGER)"
+                             << "DELETE FROM import_staging";
+    }
+    // UPDATE ... FROM needs SQLite 3.33
+    QString applyImportStatement() const
+    {
+        return "UPDATE book SET price = s.price, quantity = s.quantity "
+               "FROM import_staging s WHERE book.isbn = s.isbn";
+    }
+
+    QString limitClause() const { return "LIMIT :limit"; }
+
+    // 4 variables per row; default SQLITE_MAX_VARIABLE_NUMBER is 999
+    int multiRowInsertLimit() const { return 249; }
+};
+}
+
+const SqlDialect& SqlDialect::forDriver(const QString &driverName)
+{
+    static OracleDialect     oracle;
+    static PostgreSQLDialect postgreSQL;
+    static SQLiteDialect     sqlite;
+
+    if (driverName.startsWith( "QPSQL" ))
+        return postgreSQL;
+    if (driverName.startsWith( "QSQLITE" ))
+        return sqlite;
+    if (!driverName.startsWith( "QOCI" ))
+        qDebug() << "Unknown driver " << driverName << ". Using Oracle dialect";
+
+    return oracle;
+}
+
+const SqlDialect& SqlDialect::current()
+{
+    return forDriver( QSqlDatabase::database( QSqlDatabase::defaultConnection, false ).driverName() );
+}
+
+QString SqlDialect::insertBundledBooksStatement(const int rows) const
+{
+    QStringList values;
+    for (int i( 0 ); rows != i; ++i)
+        values << QString( "(:isbn%1, :bundle_id%1, :net_cents%1, :discount%1, 0)" ).arg( i );
+
+    return "INSERT INTO bundledbook (isbn, bundle_id, net_cents, discount, deleted) VALUES " + values.join( ", " );
+}
+
+QString SqlDialect::upsertBundledBooksStatement(const int rows) const
+{
+    QStringList values;
+    for (int i( 0 ); rows != i; ++i)
+        values << QString( "(:isbn%1, :bundle_id%1, :net_cents%1, :discount%1, 0)" ).arg( i );
+
+    return "INSERT INTO bundledbook (isbn, bundle_id, net_cents, discount, deleted) VALUES " + values.join( ", " )
+         + " ON CONFLICT (isbn, bundle_id) DO UPDATE SET net_cents = excluded.net_cents, "
+                                                       "discount = excluded.discount, deleted = 0";
+}
+
+QString SqlDialect::removeBundledBooksStatement(const int rows) const
+{
+    QStringList isbns;
+    for (int i( 0 ); rows != i; ++i)
+        isbns << QString( ":isbn%1" ).arg( i );
+
+    return "UPDATE bundledbook SET deleted = 1 WHERE bundle_id = :bundle_id AND isbn IN (" + isbns.join( ", " ) + ")";
+}
+
+QString SqlDialect::upsertRequestsStatement(const int rows) const
+{
+    QStringList values;
+    for (int i( 0 ); rows != i; ++i)
+        values << QString( "(:isbn%1, :quantity%1, :clerkID%1, 0)" ).arg( i );
+
+    return "INSERT INTO request (isbn, quantity, clerk_id, version) VALUES " + values.join( ", " )
+         + " ON CONFLICT (isbn) DO UPDATE SET quantity = excluded.quantity, version = request.version + 1 "
+           "WHERE request.clerk_id = excluded.clerk_id";
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+class QDate;
+
+/**
+ * @brief The SqlDialect class provides statement variants for every supported backend.
+ * Dialect is selected at runtime from name of Qt SQL driver (QOCI, QPSQL, QSQLITE),
+ * so one binary may work against any of them using their fastest features.
+ */
+class SqlDialect
+{
+public:
+    enum Backend
+    {
+        Oracle,
+        PostgreSQL,
+        SQLite
+    };
+
+    virtual ~SqlDialect() {}
+
+    /**
+     * @brief forDriver dialect for given Qt SQL driver name. Unknown drivers fall back to Oracle
+     */
+    static const SqlDialect& forDriver( const QString& driverName );
+    /**
+     * @brief current dialect of default database connection
+     */
+    static const SqlDialect& current();
+
+    virtual Backend backend() const = 0;
+    virtual QString name() const = 0;
+
+    /**
+     * @brief salesHistogramQuery selects isbn, age of sale in days (0 is today) and number of sold books
+     * from :days days ago till today (both included, so :days + 1 days), grouped by isbn and day. Sales are read from rolled up daily_sales and from
+     * rows of history_of_purchasing that are not rolled up yet; both are filtered by plain date ranges,
+     * so only recent partitions are scanned. Binds :days and :summaryDays (the same value; placeholders
+     * are never repeated, since some drivers bind them by position)
+     */
+    virtual QString salesHistogramQuery() const = 0;
+    /**
+     * @brief bookSalesQuery selects number of copies of book sold from :days days ago till today
+     * (same window as salesHistogramQuery). Binds :isbn, :days, :summaryIsbn and :summaryDays
+     */
+    virtual QString bookSalesQuery() const = 0;
+
+    /**
+     * @brief rollupStatement adds rows of history_of_purchasing from [:from, :to) (dates) into daily_sales,
+     * one row per book and day. Days that already have been rolled up are added to
+     */
+    virtual QString rollupStatement() const = 0;
+    /**
+     * @brief historyPartitionedQuery selects number of partitioned tables named history_of_purchasing
+     * (0 or 1). Empty if backend can't partition tables
+     */
+    virtual QString historyPartitionedQuery() const { return QString(); }
+    /**
+     * @brief historyPartitionClause clause that partitions history_of_purchasing by month
+     * (appended to CREATE TABLE). Empty if backend can't partition tables
+     */
+    virtual QString historyPartitionClause() const { return QString(); }
+    /**
+     * @brief historyPartitionStatements DDL that creates partition of history_of_purchasing for month
+     * of given date, if it doesn't exist, and moves rows of that month out of default partition.
+     * Empty if backend creates partitions itself
+     */
+    virtual QStringList historyPartitionStatements( const QDate& /*month*/ ) const { return QStringList(); }
+    /**
+     * @brief dropHistoryPartitionStatement DDL that drops (rolled up) partition of history_of_purchasing
+     * for month of given date. Empty if backend can't partition tables (or month has no partition of its own)
+     */
+    virtual QString dropHistoryPartitionStatement( const QDate& /*month*/ ) const { return QString(); }
+
+    /**
+     * @brief readSnapshotStatement turns just started transaction into read-only one that sees single
+     * consistent snapshot of database. Empty if plain transaction already does that
+     */
+    virtual QString readSnapshotStatement() const = 0;
+
+    /**
+     * @brief dataVersionTriggerStatements DDL of triggers that bump version of table in data_version
+     * whenever statement changes rows of table (see ResultCache::freshnessToken)
+     */
+    virtual QStringList dataVersionTriggerStatements( const QString& table ) const = 0;
+
+    /**
+     * @brief bundleSequenceQuery selects number of sequences named bundle_sequence (0 or 1).
+     * Empty if backend takes next bundle_id without sequence
+     */
+    virtual QString bundleSequenceQuery() const { return QString(); }
+    /**
+     * @brief insertBundleStatement inserts bundle with new id; binds :name and :commnt
+     */
+    virtual QString insertBundleStatement() const = 0;
+    /**
+     * @brief insertBundleReturnsId whether insertBundleStatement returns new bundle_id itself (RETURNING)
+     */
+    virtual bool insertBundleReturnsId() const = 0;
+    /**
+     * @brief lastBundleIdQuery selects id of bundle that has just been inserted in this session
+     * (used only when insertBundleReturnsId() is false)
+     */
+    virtual QString lastBundleIdQuery() const { return QString(); }
+
+    /**
+     * @brief upsertRequestStatement creates request for book or changes quantity of existing request,
+     * if it was filled by the same clerk. Every change bumps version of request (new request starts at 0).
+     * Binds :isbn, :quantity and :clerkID
+     */
+    virtual QString upsertRequestStatement() const = 0;
+    /**
+     * @brief upsertRequestReturnsRow whether upsertRequestStatement returns quantity, clerk_id and version
+     * of resulting row. Nothing is returned when request belongs to another clerk
+     */
+    virtual bool upsertRequestReturnsRow() const = 0;
+
+    /**
+     * @brief upsertBundledBookStatement adds book to bundle or revives soft-deleted one.
+     * Binds :isbn, :bundle_id, :net_cents and :discount
+     */
+    virtual QString upsertBundledBookStatement() const = 0;
+
+    /**
+     * @brief indexColumnsQuery selects index name, table name, column name and uniqueness (1 or 0) for every
+     * column of every index of current schema, ordered by index and position of column. Names are lower case
+     */
+    virtual QString indexColumnsQuery() const = 0;
+
+    /**
+     * @brief explainStatement statement that captures plan of given statement. Placeholders of statement
+     * are kept, so it may be bound with the same values when explainTakesBinds() is true
+     */
+    virtual QString explainStatement( const QString& statement ) const = 0;
+    virtual bool explainTakesBinds() const { return true; }
+    /**
+     * @brief planQuery selects plan captured by explainStatement (empty if explainStatement returns plan itself)
+     */
+    virtual QString planQuery() const { return QString(); }
+    /**
+     * @brief planColumn column of plan text in result of explainStatement (or planQuery)
+     */
+    virtual int planColumn() const { return 0; }
+
+    /**
+     * @brief importStagingStatements prepare empty staging table import_staging (line, isbn, price, quantity)
+     * that lives until the end of transaction. Empty if staging table is permanent (created with schema)
+     */
+    virtual QStringList importStagingStatements() const = 0;
+    /**
+     * @brief applyImportStatement updates price and quantity of books from import_staging with one statement
+     */
+    virtual QString applyImportStatement() const = 0;
+
+    /**
+     * @brief limitClause clause that limits number of rows to :limit (put at the end of query,
+     * after ORDER BY)
+     */
+    virtual QString limitClause() const = 0;
+
+    /**
+     * @brief multiRowInsertLimit how many rows may be inserted with one multi-row VALUES statement.
+     * 1 means backend has native array binds and execBatch() should be used instead
+     */
+    virtual int multiRowInsertLimit() const = 0;
+    /**
+     * @brief insertBundledBooksStatement inserts rows into bundledbook.
+     * Binds :isbnN, :bundle_idN, :net_centsN and :discountN for every N in [0, rows)
+     */
+    QString insertBundledBooksStatement( const int rows ) const;
+    /**
+     * @brief upsertBundledBooksStatement multi-row form of upsertBundledBookStatement (ON CONFLICT),
+     * for backends without array binds. Binds :isbnN, :bundle_idN, :net_centsN and :discountN
+     * for every N in [0, rows)
+     */
+    QString upsertBundledBooksStatement( const int rows ) const;
+    /**
+     * @brief removeBundledBooksStatement marks books of bundle as deleted.
+     * Binds :bundle_id and :isbnN for every N in [0, rows)
+     */
+    QString removeBundledBooksStatement( const int rows ) const;
+    /**
+     * @brief upsertRequestsStatement multi-row form of upsertRequestStatement (ON CONFLICT), for backends
+     * without array binds. Binds :isbnN, :quantityN and :clerkIDN for every N in [0, rows)
+     */
+    QString upsertRequestsStatement( const int rows ) const;
+};
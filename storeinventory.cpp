@@ -0,0 +1,187 @@
+#include "storeinventory.h"
+#include "queryprofiler.h"
+#include "fetchtuning.h"
+#include <QSettings>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QThread>
+#include <QtConcurrentMap>
+
+namespace
+{
+/**
+ * @brief fetchStock reads stock of one store. Runs on worker thread, so connection is created,
+ * used and removed there (its name is unique per thread: abandoned fetch may still run next to new one)
+ */
+StoreInventory::Stock fetchStock( const StoreInventory::Store& store )
+{
+    StoreInventory::Stock stock;
+    stock.ok = false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const QString connectionName = QString( "store-%1-%2" )
+                                   .arg( store.name )
+                                   .arg( reinterpret_cast< quintptr >( QThread::currentThread() ) );
+    // every store has its own server (and its own latency), so it is tuned on its own
+    const QString statement = "store stock: " + store.name;
+    {
+        QSqlDatabase db = store.connection.addDatabase( connectionName );
+        FetchTuning::apply( db, statement );
+        if (db.open())
+        {
+            // connecting isn't fetching
+            QElapsedTimer fetchTimer;
+            fetchTimer.start();
+
+            QSqlQuery stockQuery( db );
+            stockQuery.setForwardOnly( true );
+            const bool execResult = stockQuery.prepare( "SELECT isbn, quantity "
+                                                        "FROM book "
+                                                        "WHERE quantity > 0" )
+                                 && QueryProfiler::exec( stockQuery, connectionName );
+            if (execResult)
+            {
+                while (stockQuery.next())
+                    stock.quantities.insert( stockQuery.value( 0 ).toString(), stockQuery.value( 1 ).toUInt() );
+                stock.ok = true;
+                FetchTuning::record( statement, stock.quantities.size(), fetchTimer.elapsed() );
+            }
+            else
+                qDebug() << store.name << stockQuery.lastError();
+            db.close();
+        }
+        else
+            qDebug() << store.name << db.lastError();
+    }
+    QSqlDatabase::removeDatabase( connectionName );
+
+    qDebug() << "Store " << store.name << ": " << stock.ok << stock.quantities.size()
+             << "book(s) in" << timer.elapsed() << "ms";
+    return stock;
+}
+}
+
+QList< StoreInventory::Store > StoreInventory::readStores()
+{
+    QSettings settings( "settings.ini", QSettings::IniFormat );
+    const QStringList groups = settings.value( "stores/groups" ).toString().split( ",", Qt::SkipEmptyParts );
+
+    QList< Store > stores;
+    for (int i( 0 ); groups.size() != i; ++i)
+    {
+        const QString group = groups.at( i ).trimmed();
+
+        Store store;
+        store.name       = settings.value( group + "/label", group ).toString();
+        store.connection = ConnectionSettings::read( settings, group );
+        stores << store;
+    }
+
+    return stores;
+}
+
+StoreInventory::StoreInventory(QObject * const parent)
+    : QObject( parent )
+    , m_watcher( new QFutureWatcher< Stock >( this ) )
+{
+    connect( m_watcher, SIGNAL(finished()), this, SLOT(collectResults()) );
+}
+
+void StoreInventory::setStores(const QList<Store> &stores)
+{
+    clear();
+    m_stores = stores;
+}
+
+QStringList StoreInventory::storeNames() const
+{
+    QStringList names;
+    for (int i( 0 ); m_stores.size() != i; ++i)
+        names << m_stores.at( i ).name;
+
+    return names;
+}
+
+bool StoreInventory::startFetch()
+{
+    if (m_stores.isEmpty() || m_pending.isRunning())
+        return false;
+
+    const QSettings settings( "settings.ini", QSettings::IniFormat );
+    const qint64 maxAge = settings.value( "stores/maxAgeSeconds", 300 ).toLongLong() * 1000;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    m_stock.resize( m_stores.size() );
+    m_fetchedAt.resize( m_stores.size() );
+    m_pendingStores.clear();
+    QList< Store > stale;
+    for (int i( 0 ); m_stores.size() != i; ++i)
+        if (0 == m_fetchedAt.at( i ) || maxAge <= now - m_fetchedAt.at( i ))
+        {
+            m_pendingStores << i;
+            stale << m_stores.at( i );
+        }
+    qDebug() << "Stale stores: " << stale.size() << "of" << m_stores.size();
+
+    if (stale.isEmpty())
+        return false;
+
+    m_pending = QtConcurrent::mapped( stale, fetchStock );
+    m_watcher->setFuture( m_pending );
+    return true;
+}
+
+void StoreInventory::collectResults()
+{
+    // results of fetch that has been abandoned by clear()
+    if (m_watcher->future() != m_pending)
+        return;
+
+    const QList< Stock > results = m_pending.results();
+    m_pending = QFuture< Stock >();
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    int answered = 0;
+    for (int i( 0 ); results.size() != i && m_pendingStores.size() != i; ++i)
+        if (results.at( i ).ok)
+        {
+            // store that hasn't answered keeps its previous stock (and is asked again by next fetch)
+            const int store = m_pendingStores.at( i );
+            m_stock[ store ]     = results.at( i ).quantities;
+            m_fetchedAt[ store ] = now;
+            ++answered;
+        }
+    m_pendingStores.clear();
+
+    qDebug() << "Stores answered: " << answered;
+    emit fetched( answered );
+}
+
+void StoreInventory::clear()
+{
+    m_pending = QFuture< Stock >();
+    m_pendingStores.clear();
+    m_stock.clear();
+    m_fetchedAt.clear();
+}
+
+QVector< QVector< uint > > StoreInventory::quantities(const QVector<QString> &isbns) const
+{
+    QVector< QVector< uint > > result( m_stock.size() );
+    for (int store( 0 ); m_stock.size() != store; ++store)
+    {
+        const QHash< QString, uint >& stock = m_stock.at( store );
+        QVector< uint >& column = result[ store ];
+        column.reserve( isbns.size() );
+        for (int i( 0 ); isbns.size() != i; ++i)
+            column << stock.value( isbns.at( i ), 0 );
+    }
+
+    return result;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QFutureWatcher>
+
+#include "connectionsettings.h"
+
+/**
+ * @brief The StoreInventory class reads stock of other stores of chain. Every store has its own database
+ * (configured with its own group of settings.ini); all of them are queried concurrently on worker threads,
+ * every worker uses its own connection. Stock of store is kept for "stores/maxAgeSeconds" (300 by default),
+ * so refreshes in between don't query stores again.
+ */
+class StoreInventory : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Store
+    {
+        QString name;
+        ConnectionSettings connection;
+    };
+
+    /**
+     * @brief The Stock struct what one store has in stock
+     */
+    struct Stock
+    {
+        bool ok;
+        QHash< QString, uint > quantities;
+    };
+
+    /**
+     * @brief readStores reads stores whose groups are listed in "stores/groups" of settings.ini
+     * (comma separated). Name of store is "label" of its group (or name of group itself)
+     */
+    static QList< Store > readStores();
+
+    explicit StoreInventory( QObject * const parent = NULL );
+
+    /**
+     * @brief setStores replaces stores (and forgets stock of previous ones)
+     */
+    void setStores( const QList< Store >& stores );
+
+    QStringList storeNames() const;
+    bool isEmpty() const { return m_stores.isEmpty(); }
+
+    /**
+     * @brief startFetch starts reading stock of stores whose stock is missing or too old in background;
+     * returns immediately. fetched() is emitted when all of them have answered (or failed)
+     * @return false if there is nothing to read
+     */
+    bool startFetch();
+    /**
+     * @brief clear forgets stock. Fetch that is still running isn't waited for, its results are dropped
+     */
+    void clear();
+
+    /**
+     * @brief quantities stock of given books in every store: result[ store ][ row ]
+     */
+    QVector< QVector< uint > > quantities( const QVector< QString >& isbns ) const;
+
+signals:
+    /**
+     * @brief fetched emitted when fetch started by startFetch has finished
+     * @param answered number of stores that have answered
+     */
+    void fetched( int answered );
+
+private slots:
+    void collectResults();
+
+private:
+    QList< Store > m_stores;
+    QVector< QHash< QString, uint > > m_stock;
+    /**
+     * @brief m_fetchedAt when stock of store has been read (msecs since epoch, 0 if never)
+     */
+    QVector< qint64 > m_fetchedAt;
+    /**
+     * @brief m_pendingStores stores that are read by m_pending (indexes into m_stores)
+     */
+    QVector< int > m_pendingStores;
+    QFuture< Stock > m_pending;
+    QFutureWatcher< Stock > *m_watcher;
+};
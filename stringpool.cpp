@@ -0,0 +1,62 @@
+#include "stringpool.h"
+#include <QSet>
+#include <QMutex>
+#include <QSettings>
+#include <QDebug>
+
+namespace
+{
+struct Pool
+{
+    QMutex mutex;
+    QSet< QString > values;
+    int limit;
+
+    Pool()
+    {
+        const QSettings settings( "settings.ini", QSettings::IniFormat );
+        limit = qMax( 1, settings.value( "memory/internLimit", 4096 ).toInt() );
+    }
+};
+
+Pool& pool()
+{
+    static Pool instance;
+    return instance;
+}
+}
+
+QString StringPool::intern(const QString &value)
+{
+    if (value.isEmpty())
+        return QString();
+
+    Pool& p = pool();
+    QMutexLocker locker( &p.mutex );
+
+    const QSet< QString >::const_iterator it = p.values.constFind( value );
+    if (p.values.constEnd() != it)
+        return *it;
+
+    if (p.limit <= p.values.size())
+    {
+        qDebug() << "String pool is full, emptying it";
+        p.values.clear();
+    }
+    p.values.insert( value );
+    return value;
+}
+
+int StringPool::size()
+{
+    Pool& p = pool();
+    QMutexLocker locker( &p.mutex );
+    return p.values.size();
+}
+
+void StringPool::clear()
+{
+    Pool& p = pool();
+    QMutexLocker locker( &p.mutex );
+    p.values.clear();
+}
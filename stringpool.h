@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QString>
+
+/**
+ * @brief The StringPool class interns values that repeat across many rows (publisher and author names),
+ * so equal values share one buffer instead of every row holding its own copy. Pool is capped
+ * ("memory/internLimit" of settings.ini); when it is full it is emptied and starts over.
+ * May be used from any thread.
+ */
+class StringPool
+{
+public:
+    /**
+     * @brief intern shared copy of value
+     */
+    static QString intern( const QString& value );
+
+    static int size();
+    static void clear();
+};
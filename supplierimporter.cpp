@@ -0,0 +1,370 @@
+#include "supplierimporter.h"
+#include "connectionsettings.h"
+#include "sqldialect.h"
+#include "isbn.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSettings>
+#include <QFile>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QStringList>
+#include <QVariantList>
+#include <QSet>
+#include <QHash>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <QDebug>
+
+const int SupplierImporter::ChunkRows;
+
+namespace
+{
+/**
+ * @brief splitCsvLine splits line of CSV into fields (quoted fields may contain commas and quotes,
+ * but not line breaks)
+ */
+QStringList splitCsvLine( const QString& line )
+{
+    QStringList fields;
+    QString field;
+    bool quoted = false;
+    for (int i( 0 ); line.size() != i; ++i)
+    {
+        const QChar c = line.at( i );
+        if (quoted)
+        {
+            if (QChar( '"' ) != c)
+                field += c;
+            else if (line.size() != i + 1 && QChar( '"' ) == line.at( i + 1 ))
+            {
+                field += c;
+                ++i;
+            }
+            else
+                quoted = false;
+        }
+        else if (QChar( '"' ) == c)
+            quoted = true;
+        else if (QChar( ',' ) == c)
+        {
+            fields << field.trimmed();
+            field.clear();
+        }
+        else
+            field += c;
+    }
+    fields << field.trimmed();
+
+    return fields;
+}
+
+/**
+ * @brief The StagedRows struct chunk of valid rows, column by column
+ */
+struct StagedRows
+{
+    QVariantList lines;
+    QVariantList isbns;
+    QVariantList prices;
+    QVariantList quantities;
+
+    int size() const { return lines.size(); }
+    void clear()
+    {
+        lines.clear();
+        isbns.clear();
+        prices.clear();
+        quantities.clear();
+    }
+};
+
+/**
+ * @brief stageRows inserts chunk into import_staging: with array binds, if backend has them,
+ * or with multi-row inserts otherwise
+ */
+bool stageRows( QSqlDatabase& db, const StagedRows& rows, QString& error )
+{
+    const SqlDialect& dialect = SqlDialect::forDriver( db.driverName() );
+    // limit of dialect is given for rows of three values, staged rows have four
+    const int chunkSize = qMax( 1, dialect.multiRowInsertLimit() * 3 / 4 );
+
+    if (1 == dialect.multiRowInsertLimit())
+    {
+        QSqlQuery stageQuery( db );
+        stageQuery.prepare( "INSERT INTO import_staging (line, isbn, price, quantity) "
+                            "VALUES (:line, :isbn, :price, :quantity)" );
+        stageQuery.bindValue( ":line", rows.lines );
+        stageQuery.bindValue( ":isbn", rows.isbns );
+        stageQuery.bindValue( ":price", rows.prices );
+        stageQuery.bindValue( ":quantity", rows.quantities );
+        if (!stageQuery.execBatch())
+        {
+            error = stageQuery.lastError().text();
+            return false;
+        }
+        return true;
+    }
+
+    for (int offset( 0 ); rows.size() > offset; offset += chunkSize)
+    {
+        const int count = qMin( chunkSize, rows.size() - offset );
+
+        QStringList values;
+        for (int i( 0 ); count != i; ++i)
+            values << QString( "(:line%1, :isbn%1, :price%1, :quantity%1)" ).arg( i );
+
+        QSqlQuery stageQuery( db );
+        stageQuery.prepare( "INSERT INTO import_staging (line, isbn, price, quantity) VALUES " + values.join( ", " ) );
+        for (int i( 0 ); count != i; ++i)
+        {
+            stageQuery.bindValue( QString( ":line%1" ).arg( i ), rows.lines.at( offset + i ) );
+            stageQuery.bindValue( QString( ":isbn%1" ).arg( i ), rows.isbns.at( offset + i ) );
+            stageQuery.bindValue( QString( ":price%1" ).arg( i ), rows.prices.at( offset + i ) );
+            stageQuery.bindValue( QString( ":quantity%1" ).arg( i ), rows.quantities.at( offset + i ) );
+        }
+        if (!stageQuery.exec())
+        {
+            error = stageQuery.lastError().text();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief readCatalog reads ISBNs of all books by their numeric keys, so ISBN of feed (with or without
+ * dashes, ISBN-10 or ISBN-13) is staged exactly as book has it
+ */
+bool readCatalog( QSqlDatabase& db, QHash< quint64, QString >& catalog, QString& error )
+{
+    QSqlQuery catalogQuery( db );
+    catalogQuery.setForwardOnly( true );
+    if (!catalogQuery.exec( "SELECT isbn FROM book" ))
+    {
+        error = catalogQuery.lastError().text();
+        return false;
+    }
+
+    while (catalogQuery.next())
+    {
+        const QString isbn = catalogQuery.value( 0 ).toString();
+        catalog.insert( Isbn::numericKey( isbn ), isbn );
+    }
+    qDebug() << "Catalog: " << catalog.size();
+
+    return true;
+}
+
+/**
+ * @brief The RejectReport class writes rejected rows of feed
+ */
+class RejectReport
+{
+public:
+    explicit RejectReport( const QString& fileName )
+        : m_file( fileName )
+        , m_count( 0 )
+    {
+        if (m_file.open( QIODevice::WriteOnly | QIODevice::Text ))
+        {
+            m_stream.setDevice( &m_file );
+            m_stream.setCodec( "UTF-8" );
+            m_stream << "line,isbn,reason\n";
+        }
+    }
+
+    void reject( const qint64 line, const QString& isbn, const QString& reason )
+    {
+        ++m_count;
+        if (m_stream.device())
+            m_stream << line << ",\"" << QString( isbn ).replace( "\"", "\"\"" ) << "\"," << reason << '\n';
+    }
+
+    qint64 count() const { return m_count; }
+
+    bool commit()
+    {
+        if (!m_stream.device())
+            return false;
+        m_stream.flush();
+        return m_file.commit();
+    }
+
+private:
+    QSaveFile m_file;
+    QTextStream m_stream;
+    qint64 m_count;
+};
+}
+
+SupplierImporter::SupplierImporter(QObject * const parent)
+    : QObject( parent )
+    , m_cancelled( 0 )
+{
+}
+
+SupplierImporter::~SupplierImporter()
+{
+    cancel();
+    m_future.waitForFinished();
+}
+
+QString SupplierImporter::rejectsFileName(const QString &feedFileName)
+{
+    return feedFileName + ".rejects.csv";
+}
+
+bool SupplierImporter::start(const QString &feedFileName)
+{
+    if (isRunning())
+        return false;
+
+    m_cancelled.fetchAndStoreOrdered( 0 );
+    m_future = QtConcurrent::run( this, &SupplierImporter::run, feedFileName );
+    return true;
+}
+
+bool SupplierImporter::isRunning() const
+{
+    return m_future.isRunning();
+}
+
+void SupplierImporter::cancel()
+{
+    m_cancelled.fetchAndStoreOrdered( 1 );
+}
+
+void SupplierImporter::run(const QString &feedFileName)
+{
+    QFile feed( feedFileName );
+    if (!feed.open( QIODevice::ReadOnly | QIODevice::Text ))
+    {
+        emit finished( false, 0, 0, feed.errorString() );
+        return;
+    }
+
+    QTextStream input( &feed );
+    input.setCodec( "UTF-8" );
+
+    RejectReport rejects( rejectsFileName( feedFileName ) );
+
+    const QString connectionName = QString( "import-%1" ).arg( reinterpret_cast< quintptr >( QThread::currentThread() ) );
+    qint64 updated = 0;
+    QString error;
+    {
+        QSettings settings( "settings.ini", QSettings::IniFormat );
+        QSqlDatabase db = ConnectionSettings::read( settings, "database" ).addDatabase( connectionName );
+        if (!db.open())
+            error = db.lastError().text();
+        else
+        {
+            const SqlDialect& dialect = SqlDialect::forDriver( db.driverName() );
+            qDebug() << "Transaction: " << db.transaction();
+
+            const QStringList stagingStatements = dialect.importStagingStatements();
+            for (int i( 0 ); stagingStatements.size() != i && error.isEmpty(); ++i)
+            {
+                QSqlQuery stagingQuery( db );
+                if (!stagingQuery.exec( stagingStatements.at( i ) ))
+                    error = stagingQuery.lastError().text();
+            }
+
+            QHash< quint64, QString > catalog;
+            if (error.isEmpty())
+                readCatalog( db, catalog, error );
+
+            // numeric keys of staged ISBNs; the first row of every book wins
+            QSet< quint64 > staged;
+            StagedRows chunk;
+            qint64 lineNumber = 0;
+            while (error.isEmpty() && !input.atEnd())
+            {
+                const QString line = input.readLine();
+                ++lineNumber;
+                if (line.trimmed().isEmpty())
+                    continue;
+
+                const QStringList fields = splitCsvLine( line );
+                const QString isbn = fields.value( 0 );
+                bool priceOk = false;
+                bool quantityOk = false;
+                const double price = fields.value( 1 ).toDouble( &priceOk );
+                const uint quantity = fields.value( 2 ).toUInt( &quantityOk );
+
+                if (1 == lineNumber && !Isbn::isValid( isbn ) && isbn.contains( "isbn", Qt::CaseInsensitive ))
+                    continue; // header
+                if (3 > fields.size())
+                    rejects.reject( lineNumber, isbn, "too few fields" );
+                else if (!Isbn::isValid( isbn ))
+                    rejects.reject( lineNumber, isbn, "invalid ISBN" );
+                else if (!priceOk || 0.0 > price)
+                    rejects.reject( lineNumber, isbn, "invalid price" );
+                else if (!quantityOk)
+                    rejects.reject( lineNumber, isbn, "invalid quantity" );
+                else if (staged.contains( Isbn::numericKey( isbn ) ))
+                    rejects.reject( lineNumber, isbn, "duplicate ISBN" );
+                else if (!catalog.contains( Isbn::numericKey( isbn ) ))
+                    rejects.reject( lineNumber, isbn, "unknown ISBN" );
+                else
+                {
+                    staged.insert( Isbn::numericKey( isbn ) );
+                    chunk.lines      << lineNumber;
+                    chunk.isbns      << catalog.value( Isbn::numericKey( isbn ) );
+                    chunk.prices     << price;
+                    chunk.quantities << quantity;
+                }
+
+                if (ChunkRows == chunk.size())
+                {
+                    if (stageRows( db, chunk, error ))
+                        chunk.clear();
+                    emit progress( lineNumber );
+                    if (m_cancelled.loadAcquire())
+                        error = tr("Import has been cancelled");
+                }
+            }
+            if (error.isEmpty() && 0 != chunk.size())
+                stageRows( db, chunk, error );
+            emit progress( lineNumber );
+
+            // books that have been deleted while feed was read
+            if (error.isEmpty())
+            {
+                QSqlQuery unknownQuery( db );
+                unknownQuery.setForwardOnly( true );
+                if (unknownQuery.exec( "SELECT s.line, s.isbn FROM import_staging s "
+                                       "WHERE NOT EXISTS (SELECT 1 FROM book b WHERE b.isbn = s.isbn) "
+                                       "ORDER BY s.line" ))
+                    while (unknownQuery.next())
+                        rejects.reject( unknownQuery.value( 0 ).toLongLong(), unknownQuery.value( 1 ).toString()
+                                        , "unknown ISBN" );
+                else
+                    error = unknownQuery.lastError().text();
+            }
+
+            if (error.isEmpty())
+            {
+                QSqlQuery applyQuery( db );
+                if (applyQuery.exec( dialect.applyImportStatement() ))
+                    updated = applyQuery.numRowsAffected();
+                else
+                    error = applyQuery.lastError().text();
+            }
+
+            if (error.isEmpty() && !db.commit())
+                error = db.lastError().text();
+            if (!error.isEmpty())
+                qDebug() << "Rollback" << db.rollback();
+
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase( connectionName );
+
+    qDebug() << "Report: " << rejects.commit();
+    qDebug() << "Imported: " << feedFileName << updated << rejects.count() << error;
+    emit finished( error.isEmpty(), updated, rejects.count(), error );
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QFuture>
+#include <QAtomicInt>
+
+/**
+ * @brief The SupplierImporter class applies supplier feed (CSV with ISBN, price and quantity) to books
+ * on worker thread, over its own connection. Feed is parsed in chunks; ISBNs of feed are matched with books
+ * by numeric key (dashes and ISBN-10 don't matter) and valid rows are inserted into staging table with ISBN
+ * exactly as book has it, in batches, then applied with one set-based statement, all in one transaction.
+ * Rejected rows (malformed, bad ISBN check digit, duplicate or unknown ISBN) are written into
+ * "<feed>.rejects.csv".
+ */
+class SupplierImporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief ChunkRows number of rows staged with one batch
+     */
+    static const int ChunkRows = 1000;
+
+    explicit SupplierImporter(QObject * const parent = NULL);
+    ~SupplierImporter();
+
+    /**
+     * @brief rejectsFileName name of reject report for feed
+     */
+    static QString rejectsFileName( const QString& feedFileName );
+
+    /**
+     * @brief start starts import of feed
+     * @return false if another import is running
+     */
+    bool start( const QString& feedFileName );
+    bool isRunning() const;
+
+public slots:
+    /**
+     * @brief cancel stops running import; nothing is applied
+     */
+    void cancel();
+
+signals:
+    /**
+     * @brief progress number of read lines
+     */
+    void progress( const qint64 lines );
+    /**
+     * @brief finished
+     * @param updated number of updated books
+     * @param rejected number of rejected rows
+     */
+    void finished( const bool ok, const qint64 updated, const qint64 rejected, const QString& error );
+
+private:
+    void run( const QString& feedFileName );
+
+    QFuture< void > m_future;
+    QAtomicInt m_cancelled;
+};
@@ -0,0 +1,96 @@
+#include "workflow.h"
+#include <QSqlError>
+#include <QObject>
+#include <QDebug>
+
+CancellationToken::CancellationToken()
+    : m_cancelled( new QAtomicInt( 0 ) )
+{
+}
+
+void CancellationToken::cancel()
+{
+    m_cancelled->fetchAndStoreOrdered( 1 );
+}
+
+bool CancellationToken::isCancelled() const
+{
+    return 0 != m_cancelled->loadAcquire();
+}
+
+Workflow::Outcome::Outcome()
+    : ok( true )
+    , cancelled( false )
+{
+}
+
+Workflow::Workflow(QSqlDatabase db, const CancellationToken &token)
+    : m_db( db )
+    , m_token( token )
+    , m_inTransaction( false )
+{
+    m_currentStep = "begin";
+    if (!m_db.isOpen())
+    {
+        fail( m_db.lastError().text() );
+        return;
+    }
+
+    m_inTransaction = m_db.transaction();
+    qDebug() << "Transaction: " << m_inTransaction;
+    if (!m_inTransaction)
+        fail( m_db.lastError().text() );
+}
+
+Workflow::~Workflow()
+{
+    if (m_inTransaction)
+        qDebug() << "Rollback" << m_db.rollback() << m_outcome.failedStep;
+}
+
+bool Workflow::step(const QString &name)
+{
+    if (!m_outcome.ok)
+        return false;
+
+    m_currentStep = name;
+    if (m_token.isCancelled())
+    {
+        m_outcome.cancelled = true;
+        fail( QObject::tr("Cancelled") );
+        return false;
+    }
+
+    qDebug() << "Step: " << name;
+    return true;
+}
+
+bool Workflow::check(const bool result)
+{
+    if (!result && m_outcome.ok)
+        fail( m_db.lastError().isValid() ? m_db.lastError().text() : QObject::tr("%1 has failed").arg( m_currentStep ) );
+    return result;
+}
+
+void Workflow::fail(const QString &error)
+{
+    qDebug() << "Step failed: " << m_currentStep << error;
+    m_outcome.ok         = false;
+    m_outcome.failedStep = m_currentStep;
+    m_outcome.error      = error;
+}
+
+Workflow::Outcome Workflow::commit()
+{
+    if (step( "commit" ) && m_inTransaction)
+    {
+        const bool commit = m_db.commit();
+        qDebug() << "Commit: " << commit;
+        if (commit)
+            m_inTransaction = false;
+        else
+            fail( m_db.lastError().text() );
+    }
+
+    return m_outcome;
+}
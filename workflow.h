@@ -0,0 +1,97 @@
+#pragma once
+
+#include <QString>
+#include <QSqlDatabase>
+#include <QSharedPointer>
+#include <QAtomicInt>
+
+/**
+ * @brief The CancellationToken class is shared flag that tells running workflows to stop.
+ * Copies share the same flag, so token may be handed to worker threads by value.
+ */
+class CancellationToken
+{
+public:
+    CancellationToken();
+
+    void cancel();
+    bool isCancelled() const;
+
+private:
+    QSharedPointer< QAtomicInt > m_cancelled;
+};
+
+/**
+ * @brief The Workflow class runs multi-step database work as plain sequence of steps within one
+ * transaction. Every step is announced with step() (it returns false once workflow has failed or been
+ * cancelled, so remaining steps are skipped) and its result is reported with check(). Transaction is
+ * committed by commit() if every step has succeeded; otherwise it is rolled back when workflow is destroyed.
+ *
+ * @code
+ * Workflow workflow( db, token );
+ * if (workflow.step( "update bundle" ))
+ *     workflow.check( updateBundleHeader( db, ... ) );
+ * if (workflow.step( "remove books" ))
+ *     workflow.check( removeBooks( db, ... ) );
+ * return workflow.commit();
+ * @endcode
+ */
+class Workflow
+{
+public:
+    /**
+     * @brief The Outcome struct how workflow has ended
+     */
+    struct Outcome
+    {
+        bool ok;
+        bool cancelled;
+        /**
+         * @brief failedStep name of step that has failed (or was about to run when workflow was cancelled)
+         */
+        QString failedStep;
+        QString error;
+
+        Outcome();
+    };
+
+    /**
+     * @brief Workflow starts transaction over opened connection
+     */
+    Workflow( QSqlDatabase db, const CancellationToken& token );
+    ~Workflow();
+
+    /**
+     * @brief step announces next step
+     * @return true if step should run
+     */
+    bool step( const QString& name );
+    /**
+     * @brief check reports result of current step. Error of connection is taken as reason of failure
+     * @return result
+     */
+    bool check( const bool result );
+    /**
+     * @brief fail fails current step with given reason
+     */
+    void fail( const QString& error );
+
+    /**
+     * @brief commit commits transaction if every step has succeeded
+     * @return outcome of workflow
+     */
+    Outcome commit();
+
+    bool isOk() const { return m_outcome.ok; }
+    const Outcome& outcome() const { return m_outcome; }
+
+private:
+    Workflow( const Workflow& );
+    Workflow& operator=( const Workflow& );
+
+    QSqlDatabase m_db;
+    CancellationToken m_token;
+    bool m_inTransaction;
+    QString m_currentStep;
+    Outcome m_outcome;
+};